@@ -0,0 +1,133 @@
+#include "Scenarios.hpp"
+#include "Utf8.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <string>
+
+namespace {
+// Small LCG, enough to make output look random while staying reproducible
+class Random {
+    uint64_t state_;
+public:
+    explicit Random(uint64_t seed) : state_(seed) {}
+    uint32_t next() {
+        state_ = state_ * 6364136223846793005ULL + 1442695040888963407ULL;
+        return static_cast<uint32_t>(state_ >> 33);
+    }
+    uint32_t below(uint32_t n) {
+        return next() % n;
+    }
+};
+
+void append_codepoint(std::string& out, uint32_t codepoint) {
+    char encoded[4];
+    out.append(encoded, encode_utf8(codepoint, encoded));
+}
+
+// Full lines of printable ASCII
+void dense_ascii(std::string& out, size_t size, int cols, int, Random& random) {
+    while (out.size() < size) {
+        for (auto i = 0; i < cols; ++i) {
+            out += static_cast<char>('!' + random.below(94));
+        }
+        out += "\r\n";
+    }
+}
+
+// Every cell gets its own colours and attributes
+void sgr_churn(std::string& out, size_t size, int cols, int, Random& random) {
+    while (out.size() < size) {
+        for (auto i = 0; i < cols; ++i) {
+            out += "\033[";
+            out += std::to_string(30 + random.below(8));
+            out += ';';
+            out += std::to_string(40 + random.below(8));
+            if (random.below(4) == 0) {
+                out += ";1";
+            }
+            out += 'm';
+            out += static_cast<char>('a' + random.below(26));
+        }
+        out += "\033[0m\r\n";
+    }
+}
+
+// CJK, Cyrillic and emoji mixed with ASCII
+void unicode(std::string& out, size_t size, int cols, int, Random& random) {
+    while (out.size() < size) {
+        for (auto i = 0; i < cols / 2; ++i) {
+            switch (random.below(4)) {
+                case 0: append_codepoint(out, 0x4E00 + random.below(0x5000)); break; // CJK ideographs
+                case 1: append_codepoint(out, 0x0410 + random.below(0x40)); break;   // Cyrillic
+                case 2: append_codepoint(out, 0x1F600 + random.below(0x50)); break;  // Emoji
+                default: out += static_cast<char>('a' + random.below(26)); break;
+            }
+        }
+        out += "\r\n";
+    }
+}
+
+// A pager scrolling forward, like less: the ":" prompt on the bottom row is erased, the next line is written over it
+// and LF scrolls the screen up by one, then the prompt comes back. Every line scrolls; the parser has no DECSTBM,
+// so scroll margins aren't covered
+void bottom_line_scroll(std::string& out, size_t size, int cols, int, Random& random) {
+    while (out.size() < size) {
+        out += "\r\033[K";
+        for (auto i = 0; i < cols - 1; ++i) {
+            out += static_cast<char>('a' + random.below(26));
+        }
+        out += "\r\n:";
+    }
+}
+
+// Full screen TUI repaint: every cell is addressed with CUP, like htop or a text editor
+void tui_repaint(std::string& out, size_t size, int cols, int rows, Random& random) {
+    while (out.size() < size) {
+        for (auto row = 1; row <= rows; ++row) {
+            for (auto col = 1; col <= cols; col += 8) {
+                out += "\033[" + std::to_string(row) + ";" + std::to_string(col) + "H";
+                out += "\033[3" + std::to_string(random.below(8)) + "m";
+                for (auto i = 0; i < 8 && col + i <= cols; ++i) {
+                    out += static_cast<char>('A' + random.below(26));
+                }
+            }
+        }
+        out += "\033[0m";
+    }
+}
+
+// Lines much longer than the screen is wide, everything goes through wrapping
+void long_lines(std::string& out, size_t size, int cols, int, Random& random) {
+    while (out.size() < size) {
+        auto length = cols * static_cast<int>(50 + random.below(100));
+        for (auto i = 0; i < length; ++i) {
+            out += static_cast<char>('a' + random.below(26));
+        }
+        out += "\r\n";
+    }
+}
+}
+
+std::vector<std::string_view> scenario_names() {
+    return {"dense_ascii", "sgr_churn", "unicode", "bottom_line_scroll", "tui_repaint", "long_lines"};
+}
+
+Scenario make_scenario(std::string_view name, size_t size, int cols, int rows) {
+    Scenario scenario{std::string{name}, {}};
+    scenario.bytes.reserve(size + 4096);
+    Random random{42};
+    if (name == "dense_ascii") {
+        dense_ascii(scenario.bytes, size, cols, rows, random);
+    } else if (name == "sgr_churn") {
+        sgr_churn(scenario.bytes, size, cols, rows, random);
+    } else if (name == "unicode") {
+        unicode(scenario.bytes, size, cols, rows, random);
+    } else if (name == "bottom_line_scroll") {
+        bottom_line_scroll(scenario.bytes, size, cols, rows, random);
+    } else if (name == "tui_repaint") {
+        tui_repaint(scenario.bytes, size, cols, rows, random);
+    } else if (name == "long_lines") {
+        long_lines(scenario.bytes, size, cols, rows, random);
+    }
+    return scenario;
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Generated terminal output used by the benchmarks, modeled on vtebench.
+// Generation is deterministic, the same size always gives the same bytes
+struct Scenario {
+    std::string name;
+    std::string bytes;
+};
+
+std::vector<std::string_view> scenario_names();
+// Generates about size bytes of the named scenario for a cols x rows terminal, empty bytes if the name is unknown
+Scenario make_scenario(std::string_view name, size_t size, int cols, int rows);
@@ -0,0 +1,160 @@
+#include <benchmark/benchmark.h>
+#include <vector>
+#include "Buffer.hpp"
+
+// Microbenchmarks of TermBuffer operations.
+// Arguments are {cols, rows} of the grid, plus the amount of scrollback lines where it matters.
+// The 1M lines cases need a couple of GB of memory (a Cell is 16 bytes), filter them out with --benchmark_filter if needed
+
+namespace {
+TermBuffer make_buffer(int cols, int rows, int scrollback_lines = 0) {
+    auto buffer = TermBuffer::from_grid(cols, rows);
+    buffer.set_scrollback_limit(scrollback_lines);
+    return buffer;
+}
+
+// Lines of different lengths, some of them wrap
+void fill_lines(TermBuffer& buffer, int lines, int cols) {
+    std::vector<Cell> cells;
+    for (auto i = 0; i < lines; ++i) {
+        int length = (i * 37) % (cols + cols / 2) + 1;
+        cells.clear();
+        for (auto j = 0; j < length; ++j) {
+            cells.push_back(Cell{static_cast<uint32_t>('a' + (i + j) % 26)});
+        }
+        cells.push_back(Cell{'\n'});
+        buffer.add_cells(std::move(cells));
+        cells = {};
+    }
+}
+
+void resize_grid(TermBuffer& buffer, int cols, int rows) {
+    // With 1x1 cells resize() works in cells: the last column and the last row are reserved by it
+    buffer.resize({cols, rows + 1}, {1, 1});
+}
+
+void grid_sizes(benchmark::internal::Benchmark* bench) {
+    bench->Args({80, 24})->Args({200, 60});
+}
+
+void grid_and_scrollback_sizes(benchmark::internal::Benchmark* bench) {
+    for (auto lines : {1'000, 100'000}) {
+        bench->Args({80, 24, lines})->Args({200, 60, lines});
+    }
+    bench->Args({80, 24, 1'000'000});
+}
+}
+
+static void BM_AddCellsShortRuns(benchmark::State& state) {
+    auto buffer = make_buffer(state.range(0), state.range(1), 1000);
+    for (auto _ : state) {
+        buffer.add_cells(std::vector<Cell>(8, Cell{'x'}));
+    }
+    state.SetItemsProcessed(state.iterations() * 8);
+}
+BENCHMARK(BM_AddCellsShortRuns)->Apply(grid_sizes);
+
+static void BM_AddCellsLongRuns(benchmark::State& state) {
+    auto buffer = make_buffer(state.range(0), state.range(1), 1000);
+    const std::vector<Cell> run(4096, Cell{'x'});
+    for (auto _ : state) {
+        buffer.add_cells(std::vector<Cell>(run));
+    }
+    state.SetItemsProcessed(state.iterations() * run.size());
+}
+BENCHMARK(BM_AddCellsLongRuns)->Apply(grid_sizes);
+
+static void BM_InsertChars(benchmark::State& state) {
+    int cols = state.range(0);
+    auto buffer = make_buffer(cols, state.range(1));
+    fill_lines(buffer, 1, cols);
+    buffer.set_cursor_position(1, cols / 4);
+    for (auto _ : state) {
+        buffer.insert_chars(cols / 4);
+    }
+}
+BENCHMARK(BM_InsertChars)->Apply(grid_sizes);
+
+static void BM_DeleteChars(benchmark::State& state) {
+    int cols = state.range(0);
+    auto buffer = make_buffer(cols, state.range(1));
+    fill_lines(buffer, 1, cols);
+    buffer.set_cursor_position(1, cols / 4);
+    for (auto _ : state) {
+        buffer.delete_chars(cols / 4);
+    }
+}
+BENCHMARK(BM_DeleteChars)->Apply(grid_sizes);
+
+static void BM_EraseInLine(benchmark::State& state) {
+    int cols = state.range(0);
+    auto buffer = make_buffer(cols, state.range(1));
+    buffer.set_cursor_position(1, cols / 2);
+    int mode = 0;
+    for (auto _ : state) {
+        buffer.erase_in_line(mode);
+        mode = (mode + 1) % 3;
+    }
+}
+BENCHMARK(BM_EraseInLine)->Apply(grid_sizes);
+
+static void BM_SetRemoveSelection(benchmark::State& state) {
+    int cols = state.range(0);
+    int lines = state.range(2);
+    auto buffer = make_buffer(cols, state.range(1), lines);
+    fill_lines(buffer, lines, cols);
+    for (auto _ : state) {
+        buffer.set_selection(0, 0, cols - 1, lines - 1, 0); // Everything, cells are 1x1 pixels
+        buffer.remove_selection();
+    }
+    state.SetItemsProcessed(state.iterations() * lines);
+}
+BENCHMARK(BM_SetRemoveSelection)->Apply(grid_and_scrollback_sizes)->Unit(benchmark::kMillisecond);
+
+static void BM_GetSelectedText(benchmark::State& state) {
+    int cols = state.range(0);
+    int lines = state.range(2);
+    auto buffer = make_buffer(cols, state.range(1), lines);
+    fill_lines(buffer, lines, cols);
+    buffer.set_selection(0, 0, cols - 1, lines - 1, 0);
+    size_t bytes = 0;
+    for (auto _ : state) {
+        auto text = buffer.get_selected_text();
+        bytes += text.size();
+        benchmark::DoNotOptimize(text.data());
+    }
+    state.SetBytesProcessed(bytes);
+}
+BENCHMARK(BM_GetSelectedText)->Apply(grid_and_scrollback_sizes)->Unit(benchmark::kMillisecond);
+
+static void BM_GrowCols(benchmark::State& state) {
+    int cols = state.range(0);
+    int rows = state.range(1);
+    int lines = state.range(2);
+    auto buffer = make_buffer(cols, rows, lines);
+    fill_lines(buffer, lines, cols);
+    for (auto _ : state) {
+        state.PauseTiming();
+        resize_grid(buffer, cols / 2, rows);
+        state.ResumeTiming();
+        resize_grid(buffer, cols, rows);
+    }
+    state.SetItemsProcessed(state.iterations() * lines);
+}
+BENCHMARK(BM_GrowCols)->Apply(grid_and_scrollback_sizes)->Unit(benchmark::kMillisecond);
+
+static void BM_ShrinkCols(benchmark::State& state) {
+    int cols = state.range(0);
+    int rows = state.range(1);
+    int lines = state.range(2);
+    auto buffer = make_buffer(cols, rows, lines);
+    fill_lines(buffer, lines, cols);
+    for (auto _ : state) {
+        state.PauseTiming();
+        resize_grid(buffer, cols, rows);
+        state.ResumeTiming();
+        resize_grid(buffer, cols / 2, rows);
+    }
+    state.SetItemsProcessed(state.iterations() * lines);
+}
+BENCHMARK(BM_ShrinkCols)->Apply(grid_and_scrollback_sizes)->Unit(benchmark::kMillisecond);
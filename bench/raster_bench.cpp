@@ -0,0 +1,92 @@
+#include <benchmark/benchmark.h>
+#include <unordered_map>
+#include <vector>
+#include "SoftwareRasterizer.hpp"
+
+// Software rasterizer: a full screen of text drawn into the framebuffer, with and without AVX2.
+// Glyph masks are synthetic (no fonts needed), sized like a 16pt monospace font.
+// Arguments are {cols, rows, simd}
+
+namespace {
+constexpr int cell_w = 10;
+constexpr int cell_h = 19;
+
+struct SyntheticGlyphs {
+    std::unordered_map<uint32_t, GlyphMask> masks;
+
+    const GlyphMask* operator()(uint32_t codepoint) {
+        auto& mask = masks[codepoint];
+        if (mask.alpha.empty()) {
+            mask = GlyphMask{cell_w, cell_h, std::vector<uint8_t>(cell_w * cell_h)};
+            for (int i = 0; i < cell_w * cell_h; ++i) {
+                auto value = (i * 31 + codepoint * 17) % 512; // About half of the box is empty, like real glyphs
+                mask.alpha[i] = value < 256 ? 0 : static_cast<uint8_t>(value - 256);
+            }
+        }
+        return &mask;
+    }
+};
+
+std::vector<std::vector<Cell>> make_screen(int cols, int rows) {
+    std::vector<std::vector<Cell>> screen(rows);
+    for (int y = 0; y < rows; ++y) {
+        for (int x = 0; x < cols; ++x) {
+            Cell cell{static_cast<uint32_t>('!' + (x * 7 + y) % 90)};
+            cell.fg_color = Color{static_cast<uint8_t>(x * 5), 200, static_cast<uint8_t>(y * 9), 255};
+            if ((x / 8 + y) % 5 == 0) {
+                cell.bg_color = Color{40, 40, 90, 255};
+            }
+            screen[y].push_back(cell);
+        }
+    }
+    return screen;
+}
+
+void screen_sizes(benchmark::internal::Benchmark* bench) {
+    for (auto simd : {0, 1}) {
+        bench->Args({80, 24, simd})->Args({200, 60, simd});
+    }
+}
+}
+
+static void BM_RasterizeScreen(benchmark::State& state) {
+    int cols = state.range(0);
+    int rows = state.range(1);
+    if (state.range(2) && !SoftwareRasterizer::has_avx2()) {
+        state.SkipWithError("No AVX2 on this CPU");
+        return;
+    }
+    SyntheticGlyphs glyphs;
+    SoftwareRasterizer raster{cell_w, cell_h, std::ref(glyphs)};
+    raster.set_use_simd(state.range(2));
+    raster.resize(cols * cell_w, rows * cell_h);
+    auto screen = make_screen(cols, rows);
+    for (auto _ : state) {
+        for (int y = 0; y < rows; ++y) {
+            raster.draw_row(y, screen[y]);
+        }
+        benchmark::DoNotOptimize(raster.pixels());
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * cols * rows);
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(raster.pitch()) * raster.height());
+}
+BENCHMARK(BM_RasterizeScreen)->Apply(screen_sizes);
+
+static void BM_ScrollOneRow(benchmark::State& state) {
+    int cols = state.range(0);
+    int rows = state.range(1);
+    SyntheticGlyphs glyphs;
+    SoftwareRasterizer raster{cell_w, cell_h, std::ref(glyphs)};
+    raster.set_use_simd(state.range(2));
+    raster.resize(cols * cell_w, rows * cell_h);
+    auto screen = make_screen(cols, rows);
+    int next = 0;
+    for (auto _ : state) { // What a frame costs while output scrolls: move everything up, draw the new bottom row
+        raster.move_rows(1, 0, rows - 1);
+        raster.draw_row(rows - 1, screen[next++ % rows]);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations() * cols);
+}
+BENCHMARK(BM_ScrollOneRow)->Args({80, 24, 1})->Args({200, 60, 1});
@@ -0,0 +1,209 @@
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <poll.h>
+#include <pty.h>
+#include <sstream>
+#include <string>
+#include <sys/wait.h>
+#include <termios.h>
+#include <unistd.h>
+#include <vector>
+#include "Headless.hpp"
+#include "Scenarios.hpp"
+#include "SessionRecording.hpp"
+
+// kemul_throughput: end-to-end throughput of the pty -> parser -> grid pipeline, modeled on vtebench.
+// A child process writes a generated scenario into a pty, kemul's core reads it on the other side
+// and "renders" at most 60 times a second. Results are printed as JSON.
+// Recorded sessions (proj --record) can be run as well, they are replayed as fast as possible.
+// Usage: kemul_throughput [--size MB] [--cols N] [--rows N] [--scenario NAME]... [--corpus FILE.krec]... [--out FILE]
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+struct Result {
+    std::string name;
+    size_t bytes{0};
+    double seconds{0};
+    size_t frames{0};
+    long peak_rss_kb{0};
+    uint64_t checksum{0}; // Of the rendered frames, printed so render() can't be optimized away
+};
+
+void reset_peak_rss() {
+    std::ofstream clear_refs{"/proc/self/clear_refs"};
+    clear_refs << "5"; // Resets VmHWM, Linux only
+}
+
+long peak_rss_kb() {
+    std::ifstream status{"/proc/self/status"};
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.starts_with("VmHWM:")) {
+            return std::atol(line.c_str() + 6);
+        }
+    }
+    return 0;
+}
+
+Result run_through_pty(const Scenario& scenario, int cols, int rows) {
+    HeadlessTerminal terminal{cols, rows};
+    Result result{scenario.name};
+
+    termios raw;
+    cfmakeraw(&raw); // No \n -> \r\n, what the child writes is what we read
+    winsize ws{static_cast<unsigned short>(rows), static_cast<unsigned short>(cols), 0, 0};
+    int master_fd;
+    reset_peak_rss();
+    auto start = Clock::now();
+
+    pid_t child = forkpty(&master_fd, nullptr, &raw, &ws);
+    if (child < 0) {
+        std::cerr << "forkpty failed: " << std::strerror(errno) << std::endl;
+        return result;
+    } else if (child == 0) {
+        const char* data = scenario.bytes.data();
+        size_t left = scenario.bytes.size();
+        while (left > 0) {
+            auto written = write(STDOUT_FILENO, data, left);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                _exit(1);
+            }
+            data += written;
+            left -= written;
+        }
+        tcdrain(STDOUT_FILENO);
+        _exit(0);
+    }
+
+    constexpr auto frame_interval = std::chrono::microseconds{16667};
+    auto last_frame = start;
+    bool dirty = false;
+    std::vector<char> buf(64 * 1024);
+    pollfd fds{master_fd, POLLIN, 0};
+    while (true) {
+        if (poll(&fds, 1, 100) < 0 && errno != EINTR) {
+            break;
+        }
+        auto rd_size = read(master_fd, buf.data(), buf.size());
+        if (rd_size <= 0) {
+            if (rd_size < 0 && (errno == EAGAIN || errno == EINTR)) continue;
+            break; // EIO once the child is gone and everything is read
+        }
+        result.bytes += rd_size;
+        terminal.feed(std::string_view{buf.data(), static_cast<size_t>(rd_size)});
+        dirty = true;
+
+        auto now = Clock::now();
+        if (now - last_frame >= frame_interval) {
+            result.checksum ^= terminal.render();
+            ++result.frames;
+            last_frame = now;
+            dirty = false;
+        }
+    }
+    if (dirty) {
+        result.checksum ^= terminal.render();
+        ++result.frames;
+    }
+    result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    result.peak_rss_kb = peak_rss_kb();
+
+    close(master_fd);
+    waitpid(child, nullptr, 0);
+    return result;
+}
+
+std::string to_json(const std::vector<Result>& results, int cols, int rows) {
+    std::ostringstream out;
+    out << "{\n  \"cols\": " << cols << ",\n  \"rows\": " << rows << ",\n  \"results\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const auto& result = results[i];
+        double mb_per_s = result.seconds > 0 ? result.bytes / (1024.0 * 1024.0) / result.seconds : 0;
+        out << (i == 0 ? "\n" : ",\n")
+            << "    {\"name\": \"" << result.name << "\""
+            << ", \"bytes\": " << result.bytes
+            << ", \"seconds\": " << result.seconds
+            << ", \"mb_per_s\": " << mb_per_s
+            << ", \"frames\": " << result.frames
+            << ", \"peak_rss_kb\": " << result.peak_rss_kb
+            << ", \"checksum\": " << result.checksum << "}";
+    }
+    out << "\n  ]\n}\n";
+    return out.str();
+}
+}
+
+int main(int argc, char** argv) {
+    size_t size_mb = 16;
+    int cols = 80;
+    int rows = 24;
+    std::vector<std::string> names;
+    std::vector<std::string> corpus;
+    const char* out_path = nullptr;
+
+    for (auto i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--size") == 0 && i + 1 < argc) {
+            size_mb = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--cols") == 0 && i + 1 < argc) {
+            cols = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--rows") == 0 && i + 1 < argc) {
+            rows = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--scenario") == 0 && i + 1 < argc) {
+            names.emplace_back(argv[++i]);
+        } else if (std::strcmp(argv[i], "--corpus") == 0 && i + 1 < argc) {
+            corpus.emplace_back(argv[++i]);
+        } else if (std::strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            out_path = argv[++i];
+        } else {
+            std::cerr << "Unknown option " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+    if (names.empty() && corpus.empty()) {
+        for (auto name : scenario_names()) {
+            names.emplace_back(name);
+        }
+    }
+
+    std::vector<Result> results;
+    for (const auto& name : names) {
+        auto scenario = make_scenario(name, size_mb * 1024 * 1024, cols, rows);
+        if (scenario.bytes.empty()) {
+            std::cerr << "Unknown scenario " << name << std::endl;
+            return 1;
+        }
+        std::cerr << "Running " << name << "..." << std::endl;
+        results.push_back(run_through_pty(scenario, cols, rows));
+    }
+    for (const auto& path : corpus) {
+        Scenario scenario{std::filesystem::path{path}.stem().string(), {}};
+        try {
+            SessionReader reader{path};
+            RecordedChunk chunk;
+            while (reader.next(chunk)) {
+                scenario.bytes += chunk.bytes;
+            }
+        } catch (const std::exception& ex) {
+            std::cerr << ex.what() << std::endl;
+            return 1;
+        }
+        std::cerr << "Running " << scenario.name << "..." << std::endl;
+        results.push_back(run_through_pty(scenario, cols, rows));
+    }
+
+    auto json = to_json(results, cols, rows);
+    if (out_path) {
+        std::ofstream{out_path} << json;
+    } else {
+        std::cout << json;
+    }
+    return 0;
+}
@@ -1,12 +1,23 @@
 #include "ANSIParser.hpp"
-#include "Application.hpp"
-#include <utf8cpp/utf8.h>
-#include <vector>
+#include "Trace.hpp"
+#include "Utf8.hpp"
+#include <algorithm>
+#include <charconv>
 #include <string>
-#include <sstream>
+#include <string_view>
 #include <cctype>
 
-AnsiParser::AnsiParser(Application& app) : application(app) {
+namespace {
+constexpr size_t max_osc_length = 64 * 1024; // Unterminated OSC longer than that is dropped instead of waiting forever
+constexpr size_t max_csi_length = 4096; // Same for CSI, nothing real comes close
+constexpr size_t max_apc_length = 64 * 1024 * 1024; // A 4K RGBA image in base64 and some, bigger graphics commands are dropped
+
+bool is_csi_final(char c) {
+    return c >= 0x40 && c <= 0x7E;
+}
+}
+
+AnsiParser::AnsiParser() {
     // Initialize default cell attributes
     current_cell.fg_color = {200, 200, 200, 255}; // White
     current_cell.bg_color = {0, 0, 0, 255};       // Black
@@ -14,102 +25,325 @@ AnsiParser::AnsiParser(Application& app) : application(app) {
 }
 
 
-void AnsiParser::parse(const std::string& text) {
-    std::string::const_iterator it = text.cbegin();
-    while (it != text.end()) {
-        if (state == GeneralState::TEXT) {
-            try {
-                uint32_t codepoint = utf8::next(it, text.end());
-                if (codepoint == 0x1B) { // ESC character
-                    state = GeneralState::ESCAPE;
-                } else if (codepoint == 0x0D) { // Carriage Return ('\r', codepoint 13)
-                    application.on_reset_cursor(true, false);
-                } else if (codepoint == 0x09) {
-                    Cell tabul = current_cell;
-                    tabul.codepoint = ' ';
-                    std::vector<Cell> tabs{tabul, tabul, tabul, tabul};
-                    application.on_add_cells(std::move(tabs)); // Inserting four spaces
-                } else if (codepoint == 0x08) { // Appears after you send DEL codepoint to the shell so it deletes it.
-                    // application.on_erase_event();
-                    application.on_move_cursor(0, -1);
-                } else if (codepoint == 0x07) { // TODO: Play bell sound
-
-                } else {
-                    // Create a cell with current attribs and add it to the buffer
-                    Cell cell = current_cell;
-                    cell.codepoint = codepoint;
-                    application.on_add_cells({cell});
+size_t AnsiParser::plan_fast_forward(std::string_view text, size_t keep_lines) const {
+    size_t newlines = 0;
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] == '\n') {
+            ++newlines;
+        } else if (text[i] == 0x1B && i + 1 < text.size()) {
+            if (text[i + 1] == ']') { // OSC doesn't touch the grid, newlines in it aren't lines
+                auto end = text.find_first_of("\a\x1b", i + 2);
+                if (end == std::string_view::npos || (text[end] == 0x1B && (end + 1 >= text.size() || text[end + 1] != '\\'))) {
+                    return 0; // Cut, or cut short by another escape
                 }
-            } catch (utf8::invalid_utf8&) {
-                ++it;
+                i = text[end] == '\a' ? end : end + 1;
+                continue;
             }
-        } else if (state == GeneralState::ESCAPE) {
-            if (it != text.end()) {
-                char c = *it++;
-                if (c == '[') {
-                    state = GeneralState::CSI;
-                    std::string csi_sequence;
-                    // Collect CSI sequence until a letter is found
-                    while (it != text.end() && !std::isalpha(*it) && *it != '@') {
-                        csi_sequence += *it++;
-                    }
-                    if (it != text.end()) {
-                        char command = *it++;
-                        handle_CSI(command, parse_params(csi_sequence));
-                    }
-                    state = GeneralState::TEXT;
-                } else if (c == ']') { // Handle OSC sequences
-                    std::string osc_sequence;
-                    while (it != text.end() && *it != '\a' && *it != 0x1B) { // OSC ends with BEL (\a) or ESC
-                        osc_sequence += *it++;
-                    }
-
-                    application.on_change_window_title(osc_sequence);
-                    if (it != text.end()) {
-                        if (*it == '\a') {
-                            ++it; // Consume /a
-                        } else if (*it == 0x1B && it + 1 != text.end() && *(it + 1) == '\\') {
-                            it += 2; /* Consume ESC and \ */
-                        }
-                    }
-                    state = GeneralState::TEXT;
-                } else {
-                    state = GeneralState::TEXT; // Unknown escape, treat next as text
-                }
+            if (text[i + 1] != '[') { // Unknown escapes might be RI, DECRC and such
+                return 0;
             }
+            auto final_pos = i + 2;
+            while (final_pos < text.size() && !is_csi_final(text[final_pos])) {
+                ++final_pos;
+            }
+            if (final_pos < text.size() && std::string_view{"mK@PCDhl"}.find(text[final_pos]) == std::string_view::npos) {
+                return 0; // Moves the cursor between lines, lines can't be skipped blindly
+            }
+            i = final_pos;
         }
     }
+    return newlines > keep_lines ? newlines - keep_lines : 0;
+}
+
+void AnsiParser::flush_skipped_lines(CommandBuffer& out) {
+    if (skipped_lines_ > 0) {
+        out.push(CommandType::DISCARD_LINES, static_cast<int>(skipped_lines_));
+    }
+    skipped_lines_ = 0;
 }
 
-std::vector<int> AnsiParser::parse_params(const std::string& csi_sequence) {
-    std::vector<int> params;
-    std::istringstream iss(csi_sequence);
-    std::string param;
-    while (std::getline(iss, param, ';')) {
-        if (param.empty()) {
-            params.push_back(0);
-        } else if (param[0] == '?') {
-            // Handle private mode parameters
-            try {
-                params.push_back(std::stoi(param.substr(1))); // Store number after '?'
-                params.push_back(-1); // Indicator for private mode
-            } catch (const std::invalid_argument&) {
-                // Skip for now
+void AnsiParser::fast_forward(size_t lines) {
+    skip_lines_ = dcs_ == Dcs::none ? lines : 0; // Newlines in DCS data aren't lines
+}
+
+size_t AnsiParser::parse(std::string_view text, CommandBuffer& out, size_t keep_lines) {
+    TRACE_SCOPE("AnsiParser::parse");
+    if (keep_lines != 0 && dcs_ == Dcs::none) { // Newlines in DCS data aren't lines
+        skip_lines_ = plan_fast_forward(text, keep_lines);
+    }
+
+    size_t pos = 0;
+    frame_ended_ = false;
+    while (pos < text.size()) {
+        auto c = static_cast<unsigned char>(text[pos]);
+        if (dcs_ != Dcs::none) {
+            auto length = parse_dcs_data(text, pos, out);
+            if (length == 0 && dcs_ != Dcs::none) {
+                break; // ST is cut
+            }
+            pos += length;
+        } else if (c == 0x1B) { // ESC character
+            auto length = parse_escape(text, pos, out);
+            if (length == 0) {
+                break; // Rest of the sequence comes with the next read
+            }
+            pos += length;
+            if (frame_ended_) {
+                break;
+            }
+        } else if (skip_lines_ > 0) {
+            // Fast-forward: text of these lines is never seen, only escapes are processed to keep SGR state right
+            pos = text.find_first_of("\n\x1b", pos);
+            if (pos == std::string_view::npos) {
+                pos = text.size();
+            } else if (text[pos] == '\n') {
+                ++pos;
+                ++skipped_lines_;
+                if (--skip_lines_ == 0) {
+                    flush_skipped_lines(out);
+                }
+            }
+        } else if (c >= 0x20 && c < 0x7F) { // Printable ASCII goes in runs
+            auto end = pos + 1;
+            while (end < text.size() && text[end] >= 0x20 && text[end] < 0x7F) {
+                ++end;
             }
+            out.print(text.substr(pos, end - pos));
+            pos = end;
+        } else if (c < 0x20) {
+            handle_control(static_cast<char>(c), out);
+            ++pos;
+        } else if (c == 0x7F) { // DEL is not printable
+            ++pos;
         } else {
-            try {
-                params.push_back(std::stoi(param));
-            } catch (const std::invalid_argument&) {
-                params.push_back(0); // Fallback for invalid numbers
+            uint32_t codepoint;
+            auto length = decode_utf8(text, pos, codepoint);
+            if (length == 0) {
+                break;
+            } else if (length < 0) {
+                ++pos; // Skip invalid byte
+            } else {
+                out.print(codepoint);
+                pos += length;
             }
         }
     }
+    flush_skipped_lines(out); // What this text skipped, more may be skipped in the next slice
+    if (keep_lines != 0) {
+        skip_lines_ = 0; // Planned for this text only
+    }
+    return pos;
+}
+
+void AnsiParser::handle_control(char c, CommandBuffer& out) {
+    if (c == '\n') {
+        out.push(CommandType::LINEFEED);
+    } else if (c == '\r') { // Carriage Return ('\r', codepoint 13)
+        out.push(CommandType::CARRIAGE_RETURN);
+    } else if (c == '\t') {
+        out.print("    "); // Inserting four spaces
+    } else if (c == '\b') { // Appears after you send DEL codepoint to the shell so it deletes it.
+        out.push(CommandType::MOVE_CURSOR, 0, -1);
+    } else if (c == '\a') { // TODO: Play bell sound
+
+    }
+}
+
+size_t AnsiParser::parse_escape(std::string_view text, size_t pos, CommandBuffer& out) {
+    if (pos + 1 >= text.size()) {
+        return 0;
+    }
+    char c = text[pos + 1];
+    if (c == '[') {
+        // Collect CSI sequence until the final byte is found
+        auto final_pos = pos + 2;
+        while (final_pos < text.size() && !is_csi_final(text[final_pos])) {
+            ++final_pos;
+        }
+        if (final_pos >= text.size()) {
+            return final_pos - pos > max_csi_length ? final_pos - pos : 0; // Garbage, don't wait for more of it forever
+        }
+        handle_CSI(text[final_pos], parse_params(text.substr(pos + 2, final_pos - pos - 2)), out);
+        return final_pos - pos + 1;
+    } else if (c == ']') { // Handle OSC sequences
+        auto end = pos + 2;
+        while (end < text.size() && text[end] != '\a' && text[end] != 0x1B) { // OSC ends with BEL (\a) or ESC
+            ++end;
+        }
+        size_t terminator_length;
+        if (end < text.size() && text[end] == '\a') {
+            terminator_length = 1;
+        } else if (end + 1 < text.size()) {
+            terminator_length = text[end + 1] == '\\' ? 2 : 0; /* ESC \, a lone ESC starts the next sequence */
+        } else {
+            return end - pos > max_osc_length ? text.size() - pos : 0;
+        }
+
+        auto osc_sequence = text.substr(pos + 2, end - pos - 2);
+        if (osc_sequence.starts_with("0;") || osc_sequence.starts_with("2;")) { // Window title
+            out.title = std::string{osc_sequence.substr(2)};
+        }
+        return end - pos + terminator_length;
+    } else if (c == 'P') {
+        return parse_dcs_start(text, pos, out);
+    } else if (c == '_') { // APC, only kitty graphics commands are known
+        if (pos + 2 >= text.size()) {
+            return 0;
+        }
+        dcs_ = text[pos + 2] == 'G' ? Dcs::graphics : Dcs::ignored;
+        apc_.clear();
+        return dcs_ == Dcs::graphics ? 3 : 2;
+    }
+    return 2; // Unknown escape, skip it
+}
+
+size_t AnsiParser::parse_dcs_start(std::string_view text, size_t pos, CommandBuffer& out) {
+    constexpr size_t max_introducer_length = 64;
+    auto final_pos = pos + 2;
+    bool intermediate = false;
+    while (final_pos < text.size() && !is_csi_final(text[final_pos]) && final_pos - pos < max_introducer_length) {
+        intermediate = intermediate || (text[final_pos] >= 0x20 && text[final_pos] <= 0x2F);
+        ++final_pos;
+    }
+    if (final_pos >= text.size()) {
+        return 0;
+    }
+    if (text[final_pos] != 'q' || intermediate) {
+        dcs_ = Dcs::ignored; // DECRQSS, tmux passthrough and the like, swallowed up to the ST
+        return final_pos - pos + 1;
+    }
+
+    auto params = parse_params(text.substr(pos + 2, final_pos - pos - 2));
+    dcs_ = Dcs::sixel;
+    image_id_ = next_image_id_++;
+    sixel_bands_ = 0;
+    sixel_height_ = 0;
+    out.push(CommandType::SIXEL_BEGIN, static_cast<int>(image_id_), params.size() >= 2 && params[1] == 1);
+
+    // Raster attributes "Pan;Pad;Ph;Pv usually come first, they give the height before anything is decoded
+    if (final_pos + 1 < text.size() && text[final_pos + 1] == '"') {
+        auto end = final_pos + 2;
+        while (end < text.size() && (std::isdigit(static_cast<unsigned char>(text[end])) || text[end] == ';')) {
+            ++end;
+        }
+        if (end < text.size()) {
+            auto raster = parse_params(text.substr(final_pos + 2, end - final_pos - 2));
+            sixel_height_ = raster.size() >= 4 ? raster[3] : 0;
+        }
+    }
+    return final_pos - pos + 1;
+}
+
+size_t AnsiParser::parse_dcs_data(std::string_view text, size_t pos, CommandBuffer& out) {
+    auto end = text.find('\x1b', pos);
+    auto data = text.substr(pos, end == std::string_view::npos ? std::string_view::npos : end - pos);
+    if (dcs_ == Dcs::sixel && !data.empty()) {
+        out.push_graphics(CommandType::SIXEL_DATA, data);
+        sixel_bands_ += static_cast<int>(std::count(data.begin(), data.end(), '-'));
+    } else if (dcs_ == Dcs::graphics) {
+        if (apc_.size() + data.size() > max_apc_length) {
+            dcs_ = Dcs::ignored;
+            apc_ = std::string{};
+        } else {
+            apc_.append(data);
+        }
+    }
+    if (end == std::string_view::npos) {
+        return data.size();
+    }
+    if (end + 1 >= text.size()) {
+        return data.size(); // ESC of the ST is cut, comes again with the next chunk
+    }
+    // ST ends it, so does any other escape (the string was cut off)
+    if (dcs_ == Dcs::sixel) {
+        out.push(CommandType::SIXEL_END, static_cast<int>(image_id_), sixel_height_ > 0 ? sixel_height_ : (sixel_bands_ + 1) * 6);
+    } else if (dcs_ == Dcs::graphics) {
+        parse_graphics(apc_, out);
+        if (apc_.capacity() > max_osc_length) {
+            apc_ = std::string{}; // Unchunked image, don't hold on to its memory
+        }
+    }
+    dcs_ = Dcs::none;
+    return data.size() + (text[end + 1] == '\\' ? 2 : 0);
+}
+
+void AnsiParser::parse_graphics(std::string_view apc, CommandBuffer& out) {
+    GraphicsCommand command;
+    auto separator = apc.find(';');
+    if (separator != std::string_view::npos) {
+        command.payload = apc.substr(separator + 1);
+    }
+    auto keys = apc.substr(0, separator);
+    while (!keys.empty()) {
+        auto comma = keys.find(',');
+        auto pair = keys.substr(0, comma);
+        keys = comma == std::string_view::npos ? std::string_view{} : keys.substr(comma + 1);
+        if (pair.size() < 3 || pair[1] != '=') {
+            continue;
+        }
+        auto value = pair.substr(2);
+        uint64_t number = 0;
+        std::from_chars(value.data(), value.data() + value.size(), number); // Stays 0 for letters
+        switch (pair[0]) {
+            case 'a': command.action = value[0]; break;
+            case 't': command.medium = value[0]; break;
+            case 'f': command.format = static_cast<int>(number); break;
+            case 'o': command.compression = value[0]; break;
+            case 'i': command.id = static_cast<uint32_t>(number); break;
+            case 'I': command.number = static_cast<uint32_t>(number); break;
+            case 'p': command.placement_id = static_cast<uint32_t>(number); break;
+            case 's': command.width = static_cast<int>(std::min<uint64_t>(number, INT32_MAX)); break;
+            case 'v': command.height = static_cast<int>(std::min<uint64_t>(number, INT32_MAX)); break;
+            case 'S': command.size = number; break;
+            case 'O': command.offset = number; break;
+            case 'c': command.cols = static_cast<int>(std::min<uint64_t>(number, 1000)); break;
+            case 'r': command.rows = static_cast<int>(std::min<uint64_t>(number, 1000)); break;
+            case 'q': command.quiet = static_cast<int>(number); break;
+            case 'm': command.more = number == 1; break;
+            case 'C': command.keep_cursor = number == 1; break;
+            case 'd': command.what = value[0]; break;
+            default: break; // Source rectangle, offsets and z-index aren't supported
+        }
+    }
+    if (command.action == 't' || command.action == 'T' || command.action == 'q') {
+        command.image = next_image_id_++; // Shared with sixels, the pane keeps both by these ids
+    }
+    out.push(CommandType::GRAPHICS, static_cast<int>(out.graphics_commands.size()));
+    out.graphics_commands.push_back(std::move(command));
+}
+
+CsiParams AnsiParser::parse_params(std::string_view csi_sequence) {
+    CsiParams params;
+    if (csi_sequence.starts_with('?')) {
+        // Handle private mode parameters
+        params.is_private = true;
+        csi_sequence.remove_prefix(1);
+    }
+    if (csi_sequence.empty()) {
+        return params;
+    }
+
+    int value = 0;
+    for (char c : csi_sequence) {
+        if (c == ';') {
+            params.push_back(value);
+            value = 0;
+        } else if (std::isdigit(static_cast<unsigned char>(c))) {
+            value = std::min(value * 10 + (c - '0'), 99999); // Don't overflow on garbage
+        }
+    }
+    params.push_back(value);
     return params;
 }
 
 
-void AnsiParser::handle_CSI(char command, std::vector<int> params) {
-    static const SDL_Color color_map[8] = {
+void AnsiParser::handle_CSI(char command, const CsiParams& params, CommandBuffer& out) {
+    bool is_mode = params.is_private && (command == 'h' || command == 'l');
+    if (skip_lines_ > 0 && command != 'm' && !is_mode) { // Line is going to be discarded, only SGR and modes matter
+        return;
+    }
+
+    static const Color color_map[8] = {
         {0, 0, 0, 255},       // Black
         {255, 0, 0, 255},     // Red
         {0, 255, 0, 255},     // Green
@@ -121,8 +355,9 @@ void AnsiParser::handle_CSI(char command, std::vector<int> params) {
     }; // TODO: add more colors
 
     if (command == 'm') { // Select Graphic Rendition (SGR)
-        if (params.empty()) params.push_back(0);
-        for (int param : params) {
+        CsiParams sgr = params;
+        if (sgr.empty()) sgr.push_back(0);
+        for (int param : sgr) {
             if (param == 0) { // Reset
                 current_cell.fg_color = {200, 200, 200, 255};
                 current_cell.bg_color = {0, 0, 0, 255};
@@ -149,39 +384,44 @@ void AnsiParser::handle_CSI(char command, std::vector<int> params) {
                 current_cell.set_strikethrough(false);
             } else if (30 <= param && param <= 37) {
                 current_cell.fg_color = color_map[param - 30];
-            } else if (40 <= param && param <= 48) {
+            } else if (40 <= param && param <= 47) {
                 current_cell.bg_color = color_map[param - 40];
             }
         }
+        out.set_pen(current_cell);
     } else if (command == 'H') { // Cursor position
         int row = params.size() >= 1 ? params[0] : 1;
         int col = params.size() >= 2 ? params[1] : 1;
-        application.on_set_cursor(row, col);
+        out.push(CommandType::SET_CURSOR, row, col);
     } else if (command == 'J' && params.size() >= 1) {
-        application.on_clear_requested(params[0] == 3); // Clear screen
+        out.push(CommandType::CLEAR, params[0] == 3); // Clear screen
     } else if (command == 'A') { // Cursor up
         int n = params.size() >= 1 ? params[0] : 1;
-        application.on_move_cursor(-n, 0);
+        out.push(CommandType::MOVE_CURSOR, -n, 0);
     } else if (command == 'B') { // Cursor down
         int n = params.size() >= 1 ? params[0] : 1;
-        application.on_move_cursor(n, 0);
+        out.push(CommandType::MOVE_CURSOR, n, 0);
     } else if (command == 'C') { // Cursor forward
-        // std::cout << "forward\n";
         int n = params.size() >= 1 ? params[0] : 1;
-        application.on_move_cursor(0, n);
+        out.push(CommandType::MOVE_CURSOR, 0, n);
     } else if (command == 'D') { // Cursor backward
         int n = params.size() >= 1 ? params[0] : 1;
-        application.on_move_cursor(0, -n);
+        out.push(CommandType::MOVE_CURSOR, 0, -n);
     } else if (command == 'K') {
         int mode = params.empty() ? 0 : params[0];
-        application.on_erase_in_line(mode);
+        out.push(CommandType::ERASE_IN_LINE, mode);
     } else if (command == '@') { // ANSI to insert characters and shift existing right
         int n = params.empty() ? 0 : params[0];
-        // std::cout << "inserted" << std::endl;
-        application.on_insert_chars(n);
+        out.push(CommandType::INSERT_CHARS, n);
     } else if (command == 'P') {
         int n = params.empty() ? 0 : params[0];
-        application.on_delete_chars(n);
+        out.push(CommandType::DELETE_CHARS, n);
+    } else if (is_mode) {
+        for (int mode : params) {
+            out.push(CommandType::PRIVATE_MODE, mode, command == 'h');
+            if (mode == MODE_SYNCHRONIZED_OUTPUT && command == 'l') {
+                frame_ended_ = true;
+            }
+        }
     }
-    // std::cout << command << std::endl;
 }
@@ -1,25 +1,80 @@
-#include "Application.hpp"
-#include "Buffer.hpp"
-#include <utf8cpp/utf8.h>
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include "Cell.hpp"
+#include "TermCommand.hpp"
+
+// CSI parameters "1;31" -> 1, 31. Fixed size so parsing a sequence never allocates
+struct CsiParams {
+    std::array<int, 16> values{};
+    int count{0};
+    bool is_private{false}; // '?' prefix
+
+    void push_back(int value) {
+        if (count < static_cast<int>(values.size())) values[count++] = value;
+    }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    int operator[](size_t i) const { return values[i]; }
+    const int* begin() const { return values.data(); }
+    const int* end() const { return values.data() + count; }
+};
 
 class AnsiParser {
     private:
-        Application& application;
         Cell current_cell;
 
-        // state machine
-        enum class GeneralState { TEXT, ESCAPE, CSI };
-        GeneralState state = GeneralState::TEXT;
+        // fast-forward
+        size_t skip_lines_{0}; // Lines of the current chunk that would scroll out of the scrollback anyway
+        size_t skipped_lines_{0};
+
+        bool frame_ended_{false}; // Set when the last parse() stopped right after the end of a synchronized update
+
+        // DCS strings can be megabytes (sixel images), so their data is passed on as it comes instead of waiting for the ST.
+        // APC strings (kitty graphics) go the same way, but are collected since the keys and the payload are needed together
+        enum class Dcs : uint8_t { none, sixel, graphics, ignored };
+        Dcs dcs_{Dcs::none};
+        uint32_t image_id_{0}; // Of the sixel being received
+        uint32_t next_image_id_{1};
+        int sixel_bands_{0}; // Graphics new lines so far, each is six pixel rows
+        int sixel_height_{0}; // From the raster attributes, 0 if there were none
+        std::string apc_; // Graphics command so far
 
     public:
-        AnsiParser(Application& app);
+        AnsiParser();
 
-        void parse(const std::string& text);
+        // Translates text into commands appended to out and returns the amount of bytes consumed.
+        // An escape sequence or UTF-8 character cut by the end of text is left unconsumed, pass it again with the next chunk.
+        // keep_lines != 0 enables fast-forward: only the last keep_lines lines of text get written into the grid
+        // Parsing also stops right after the end of a synchronized update (CSI ? 2026 l), so the finished frame
+        // can be shown before the next one starts. stopped_at_frame_end() tells this apart from a cut sequence
+        size_t parse(std::string_view text, CommandBuffer& out, size_t keep_lines = 0);
+        bool stopped_at_frame_end() const {
+            return frame_ended_;
+        }
+
+        // Fast-forward over text that is parsed in slices: plan over all of it, then parse the slices with keep_lines = 0.
+        // The lines to skip carry over from one parse() to the next until they're used up or fast_forward() is called again
+        // Amount of leading lines of text that can be skipped, 0 if text moves the cursor vertically
+        size_t plan_fast_forward(std::string_view text, size_t keep_lines) const;
+        void fast_forward(size_t lines);
 
     private:
+        void flush_skipped_lines(CommandBuffer& out);
+
+        // Handles the sequence starting with ESC at text[pos], returns its length or 0 if it isn't complete yet
+        size_t parse_escape(std::string_view text, size_t pos, CommandBuffer& out);
+        void handle_control(char c, CommandBuffer& out);
+        size_t parse_dcs_start(std::string_view text, size_t pos, CommandBuffer& out); // After "ESC P", same as parse_escape
+        size_t parse_dcs_data(std::string_view text, size_t pos, CommandBuffer& out); // Up to and including the ST, 0 if it needs more text
+        void parse_graphics(std::string_view apc, CommandBuffer& out); // "keys;payload" after "ESC _ G"
+
         // Parse CSI parameters "1;31" -> 1, 31
-        std::vector<int> parse_params(const std::string& csi_sequence);
+        CsiParams parse_params(std::string_view csi_sequence);
 
         // Handle CSI commands
-        void handle_CSI(char command, std::vector<int> params); // No need for vec& params
+        void handle_CSI(char command, const CsiParams& params, CommandBuffer& out);
     };
@@ -3,12 +3,18 @@
 #include "EventHandler.hpp"
 #include "Window.hpp"
 #include <SDL_clipboard.h>
+#include <algorithm>
+#include <chrono>
 #include <cstdlib>
 #include <cstring>
+#include <cerrno>
 #include <fcntl.h>
 #include <filesystem>
+#include <fstream>
+#include <future>
+#include <iostream>
 #include <memory>
-#include <pty.h>
+#include <optional>
 #include <stdexcept>
 #include <SDL2/SDL_error.h>
 #include <SDL2/SDL_events.h>
@@ -23,30 +29,81 @@
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_ttf.h>
 #include <string>
-#include <sys/ioctl.h>
-#include <termios.h>
 #include <unistd.h>
 #include "ANSIParser.hpp"
+#include "Trace.hpp"
 
+namespace {
+// SDL stamps events with SDL_GetTicks(), this is when the key was pressed rather than when the loop got to it
+LatencyTracker::Clock::time_point event_time(Uint32 timestamp) {
+    auto now = LatencyTracker::Clock::now();
+    Uint32 ticks = SDL_GetTicks();
+    return ticks >= timestamp ? now - std::chrono::milliseconds{ticks - timestamp} : now;
+}
+}
 
-Application::Application(const std::string &font_path) {
-    init_sdl();
-    init_ttf();
-    auto appdata_dir = std::filesystem::path(std::getenv("HOME")) / ".local/share/kemul";
-    auto config_path = appdata_dir / "config.cock";
-    auto config_ = Config{config_path};
+Application::Application(const LaunchOptions& options) : options_(options) {
+    if (!options_.trace_path.empty()) {
+        Tracer::enable();
+    }
+    // The shell goes first, it reads its rc files while SDL, the window and the font are set up. Replaying has no shell
+    int shell_fd = options_.replay_path.empty() ? Pane::spawn_shell() : -1;
+    try {
+        init_sdl();
+        init_ttf();
+        shared_ = std::make_shared<SharedResources>();
+    } catch (...) {
+        if (shell_fd >= 0) {
+            close(shell_fd);
+        }
+        throw;
+    }
+    sdl_ready_ms_ = ms_since_launch();
+    init(shell_fd);
+}
 
-    window_ = std::make_unique<Window>(config_.font_path, config_.font_ptsize, config_.default_window_width, config_.default_window_height); // Setting up window before so we can get font size
-    auto font_size = window_->get_font_size();
+Application::Application(std::shared_ptr<SharedResources> shared, const LaunchOptions& options) : options_(options), shared_(std::move(shared)) {
+    init(options_.replay_path.empty() ? Pane::spawn_shell() : -1);
+}
+
+double Application::ms_since_launch() const {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - options_.launched).count();
+}
+
+void Application::init(int shell_fd) {
+    const auto& config_ = shared_->config();
+    // Opening the font and rendering the glyphs of a prompt happens on another thread while the window and renderer are created
+    auto font = std::async(std::launch::async, [shared = shared_, software = config_.software_renderer] {
+        auto face = shared->default_font();
+        face->prerender(' ', '~', software);
+        return face;
+    });
+    try {
+        window_ = std::make_unique<Window>(std::move(font), config_.default_window_width, config_.default_window_height, config_.row_cache_mb * 1024 * 1024, config_.software_renderer);
+    } catch (...) {
+        if (shell_fd >= 0) {
+            close(shell_fd);
+        }
+        throw;
+    }
+    window_->set_scrollback_limit(config_.scrollback_lines);
+    window_->set_image_cache_limit(config_.image_cache_mb * 1024 * 1024);
+    window_->set_latency_tracker(&latency_);
+    scheduler_.set_max_fps(config_.max_fps);
+    scheduler_.set_refresh_rate(window_->get_refresh_rate());
 
     // Setting up terminal stuff
-    setup_pty(false, config_.default_window_width / font_size.first - 1);
-    set_blocking_mode(false);
+    auto& pane = window_->open_pane(shell_fd);
+    window_->preload_glyphs(' ', '~'); // The prompt is drawn from the atlas right away
+    window_ready_ms_ = ms_since_launch();
+    if (!options_.record_path.empty()) {
+        auto [cols, rows] = pane.buffer().get_screen_size();
+        recorder_ = std::make_unique<SessionRecorder>(options_.record_path, cols, rows);
+        recorded_pane_ = &pane;
+    }
 
     // Init other stuff
-    // buffer_ = std::make_unique<TermBuffer>(config_.default_window_width, config_.default_window_height, font_size.first, font_size.second);
     event_handler_ = std::make_unique<EventHandler>(*this);
-    parser_ = std::make_unique<AnsiParser>(*this);
 
 
     event_handler_->subscribe<SDL_TextInputEvent>(SDL_TEXTINPUT, [this](const SDL_TextInputEvent& e) {
@@ -63,24 +120,27 @@ Application::Application(const std::string &font_path) {
     event_handler_->subscribe<SDL_MouseMotionEvent>(SDL_MOUSEMOTION,[this](const SDL_MouseMotionEvent& e) {
         window_->on_selection(e.x, e.y);
     });
-    event_handler_->subscribe<SDL_Event>(SDL_MOUSEBUTTONDOWN,[this](const SDL_Event& e) {
+    event_handler_->subscribe<SDL_MouseButtonEvent>(SDL_MOUSEBUTTONDOWN,[this](const SDL_MouseButtonEvent& e) {
+        window_->focus_pane_at(e.x, e.y); // Clicking a pane focuses it
         window_->on_remove_selection();
     });
     event_handler_->subscribe<SDL_MouseButtonEvent>(SDL_MOUSEBUTTONUP,[this](const SDL_MouseButtonEvent& e) {
         window_->reset_selection();
     });
+    event_handler_->subscribe<SDL_Event>(SDL_RENDER_TARGETS_RESET, [this](const SDL_Event& e) {
+        window_->on_render_targets_reset();
+    });
     event_handler_->subscribe<SDL_WindowEvent>(SDL_WINDOWEVENT,[this](const SDL_WindowEvent& e) {
         window_event(e);
     });
 }
 Application::~Application() {
-    close(master_fd_);
-    close(slave_fd_);
+    write_trace();
 }
 
 
 void Application::init_sdl() {
-    if (SDL_Init(SDL_INIT_EVERYTHING) < 0) {
+    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS) < 0) { // Audio, joysticks and haptics cost startup time and aren't used
         throw std::runtime_error(SDL_GetError());
     }
 }
@@ -91,87 +151,292 @@ void Application::init_ttf() {
     }
 }
 
-void Application::setup_pty(bool echo, int cols) {
-    char slave_name[128];
-    struct winsize ws;
-    ws.ws_col = cols;
-    ws.ws_row = 10;
-    int slave_id = forkpty(&master_fd_, slave_name, NULL, &ws);
+uint32_t Application::window_id() const {
+    return window_->get_window_id();
+}
 
-    if (slave_id < 0) {
-        throw std::runtime_error("Could not fork properly");
-    } else if (slave_id == 0) {
-        execl("/bin/bash", "-", NULL);
-        throw std::runtime_error("Execl didn't work");
-    }
+void Application::handle_event(SDL_Event& event) {
+    event_handler_->handle_event(event);
+}
+
+int Application::wait_ms() const {
+    return scheduler_.wait_ms(window_->needs_render(), has_output_backlog(), latency_, FrameScheduler::Clock::now());
+}
 
-    slave_fd_ = open(slave_name, O_RDONLY);
-    if (slave_fd_ < 0) {
-        throw std::runtime_error("Failed to open slave pty");
+void Application::collect_pty_fds(std::vector<pollfd>& fds) const {
+    for (size_t i = 0; i < window_->pane_count(); ++i) {
+        const auto& pane = window_->get_pane(i);
+        if (pane.pty_fd() >= 0 && !pane.hung_up()) { // A hung up pty would report POLLHUP forever
+            fds.push_back(pollfd{pane.pty_fd(), pane.pty_events(), 0});
+        }
+        if (pane.images_fd() >= 0) {
+            fds.push_back(pollfd{pane.images_fd(), POLLIN, 0});
+        }
     }
+}
 
-    termios term_attribs;
-    if (tcgetattr(slave_fd_, &term_attribs) != 0) {
-        throw std::runtime_error("Failed to get terminal attributes");
+void Application::on_pty_ready(int fd, short revents) {
+    for (size_t i = 0; i < window_->pane_count(); ++i) {
+        auto& pane = window_->get_pane(i);
+        if (pane.images_fd() == fd) {
+            pane.on_images_ready(); // Decoded sixels, drained by the next parse
+            return;
+        }
+        if (pane.pty_fd() != fd) {
+            continue;
+        }
+        if (revents & POLLIN) {
+            window_->stats().add_pty_bytes(pane.read_pty(&pane == recorded_pane_ ? recorder_.get() : nullptr));
+            if (&pane == &window_->focused_pane()) { // Keys go there, output of other panes isn't their echo
+                latency_.on_output(LatencyTracker::Clock::now());
+            }
+            if (!first_output_ms_) {
+                first_output_ms_ = ms_since_launch();
+            }
+        }
+        if ((revents & POLLOUT) && !pane.flush_writes()) {
+            std::cerr << "Could not write to pty: " << std::strerror(errno) << std::endl;
+        }
+        if (revents & (POLLHUP | POLLERR)) {
+            pane.hang_up(); // Shell is gone, its last output may still be in the pty or the ring
+        }
+        return;
     }
-    term_attribs.c_lflag |= IUTF8;
+}
 
-    if (tcsetattr(slave_fd_, TCSANOW, &term_attribs) != 0) {
-        throw std::runtime_error("Failed to set terminal attributes");
+void Application::close_pane(Pane& pane) {
+    if (&pane == recorded_pane_) {
+        recorded_pane_ = nullptr;
+    }
+    window_->close_pane(pane);
+    if (window_->pane_count() == 0) {
+        is_running_ = false;
     }
+}
 
-    fds_[0].fd = master_fd_;
-    fds_[0].events |= POLLIN;
+void Application::close_hung_up_panes() {
+    for (size_t i = 0; i < window_->pane_count();) {
+        auto& pane = window_->get_pane(i);
+        if (pane.hung_up() && !pane.has_output()) {
+            pane.read_pty(&pane == recorded_pane_ ? recorder_.get() : nullptr); // What didn't fit into the ring before
+        }
+        if (pane.hung_up() && !pane.has_output()) {
+            close_pane(pane);
+        } else {
+            ++i;
+        }
+    }
 }
 
-void Application::set_blocking_mode(bool enabled) {
-    int flags = fcntl(master_fd_, F_GETFL);
-    if (!enabled) {
-        flags |= O_NONBLOCK;
-    } else {
-        flags &= ~O_NONBLOCK;
+bool Application::has_output_backlog() const {
+    for (size_t i = 0; i < window_->pane_count(); ++i) {
+        const auto& pane = window_->get_pane(i);
+        if (pane.has_backlog() || (pane.hung_up() && pane.has_output())) { // Nothing wakes poll() for a hung up pane
+            return true;
+        }
+    }
+    return false;
+}
+
+void Application::update() {
+    process_pending_output(scheduler_.parse_budget());
+    close_hung_up_panes();
+    if (scheduler_.should_present(window_->needs_render(), latency_, FrameScheduler::Clock::now()) && window_->draw()) {
+        auto now = FrameScheduler::Clock::now();
+        scheduler_.on_present(now);
+        latency_.on_present(now);
+        if (options_.bench_startup && first_output_ms_) { // The prompt is on screen
+            report_startup();
+            is_running_ = false;
+        }
     }
-    fcntl(master_fd_, F_SETFL, flags);
 }
 
+void Application::report_startup() {
+    std::cout << "{\"sdl_init_ms\": " << sdl_ready_ms_
+              << ", \"window_ms\": " << window_ready_ms_
+              << ", \"first_output_ms\": " << *first_output_ms_
+              << ", \"first_frame_ms\": " << ms_since_launch() << "}" << std::endl;
+}
 
 void Application::run() {
     // Maybe some additional setup step
+    if (!options_.replay_path.empty()) {
+        replay_loop();
+        return;
+    }
     loop();
 }
 void Application::loop() {
-    std::string dirty_buffer;
     while (is_running_) {
+        TRACE_SCOPE("Application::loop");
         SDL_Event event;
         while (SDL_PollEvent(&event) != 0) {
-            event_handler_->handle_event(event);
+            handle_event(event);
         }
 
-        int poll_status = poll(fds_, 1, 0);
-        if (poll_status < 0) {
+        fds_.clear();
+        collect_pty_fds(fds_);
+        int poll_status = poll(fds_.data(), fds_.size(), wait_ms());
+        if (poll_status < 0 && errno != EINTR) {
             throw std::runtime_error("Some kinda poll error");
         }
-        if (fds_[0].revents & POLLIN) {
-            char buf[1024];
-            ssize_t rd_size;
-
-            std::string output{};
-            output.reserve(1024);
-            while ((rd_size = read(master_fd_, buf, sizeof(buf))) > 0) {
-                output.append(buf, rd_size);
+        for (size_t i = 0; poll_status > 0 && i < fds_.size(); ++i) {
+            if (fds_[i].revents) {
+                on_pty_ready(fds_[i].fd, fds_[i].revents);
             }
-            parser_->parse(output);
-            window_->set_should_render(true);
         }
+        update();
+    }
+}
+
+void Application::write_to_pty(std::string_view data) {
+    if (window_->pane_count() == 0) {
+        return;
+    }
+    latency_.on_input(input_at_.value_or(LatencyTracker::Clock::now()));
+    window_->focused_pane().write(data);
+}
+
+void Application::dump_latency_stats() {
+    latency_.write_json(std::cout);
+    std::cout << std::endl;
+}
+
+void Application::process_pending_output(PerfStats::Clock::duration budget) {
+    auto parse_start = PerfStats::Clock::now();
+    size_t busy = 0;
+    for (size_t i = 0; i < window_->pane_count(); ++i) {
+        busy += window_->get_pane(i).has_output() ? 1 : 0;
+    }
+    if (busy == 0) {
+        return; // Idle panes cost nothing
+    }
+    if (budget != PerfStats::Clock::duration::max()) {
+        budget /= busy;
+    }
+    for (size_t i = 0; i < window_->pane_count(); ++i) {
+        if (auto& pane = window_->get_pane(i); pane.has_output()) {
+            pane.process_output(budget);
+        }
+    }
+    window_->set_should_render(true);
+    window_->stats().add_parse_time(PerfStats::Clock::now() - parse_start);
+}
+
+void Application::replay_loop() {
+    using Clock = std::chrono::steady_clock;
+    constexpr auto frame_interval = std::chrono::microseconds{16667};
+    auto to_ms = [](Clock::duration duration) { return std::chrono::duration<double, std::milli>(duration).count(); };
+
+    SessionReader reader{options_.replay_path};
+    RecordedChunk chunk;
+    size_t chunks = 0;
+    size_t bytes = 0;
+    size_t dropped_frames = 0;
+    double parse_ms = 0;
+    std::vector<double> frame_times_ms;
+
+    auto start = Clock::now();
+    auto last_present = start;
+    std::optional<Clock::time_point> dirty_since; // When the screen got content that isn't presented yet
+    auto present = [&] {
+        auto before = Clock::now();
+        window_->set_should_render(true);
         window_->draw();
+        auto after = Clock::now();
+        frame_times_ms.push_back(to_ms(after - before));
+        if (options_.replay_realtime && dirty_since) { // Every refresh slot that passed with new content on hold is a dropped frame
+            auto slots = (after - *dirty_since) / frame_interval;
+            dropped_frames += slots > 1 ? slots - 1 : 0;
+        }
+        last_present = after;
+        dirty_since.reset();
+    };
+
+    if (reader.cols() > 0 && reader.rows() > 0) {
+        window_->resize_to_grid(reader.cols(), reader.rows()); // Output was laid out for that grid
+    }
+    while (is_running_ && reader.next(chunk)) {
+        SDL_Event event;
+        while (SDL_PollEvent(&event) != 0) {
+            event_handler_->handle_event(event);
+        }
+        if (options_.replay_realtime) {
+            auto due = start + std::chrono::nanoseconds{chunk.timestamp_ns};
+            while (Clock::now() < due) {
+                if (dirty_since && Clock::now() - last_present >= frame_interval) {
+                    present();
+                }
+                SDL_Delay(1);
+            }
+        }
+
+        if (chunk.is_resize) {
+            window_->resize_to_grid(chunk.cols, chunk.rows);
+            continue;
+        }
+        auto before = Clock::now();
+        auto& pane = window_->focused_pane();
+        int stuck = 0;
+        for (std::string_view bytes = chunk.bytes; !bytes.empty();) { // A chunk can be bigger than the ring
+            auto appended = pane.append_output(bytes);
+            stuck = appended ? 0 : stuck + 1;
+            if (stuck == 2) { // Parsing didn't free any room, it never will
+                throw std::runtime_error("Replay stalled, the parser stopped consuming output");
+            }
+            bytes.remove_prefix(appended);
+            process_pending_output();
+        }
+        parse_ms += to_ms(Clock::now() - before);
+        bytes += chunk.bytes.size();
+        ++chunks;
+        if (!dirty_since) {
+            dirty_since = Clock::now();
+        }
+
+        if (Clock::now() - last_present >= frame_interval) {
+            present();
+        }
+    }
+    if (dirty_since) {
+        present();
     }
+
+    auto total_ms = to_ms(Clock::now() - start);
+    std::sort(frame_times_ms.begin(), frame_times_ms.end());
+    auto percentile = [&frame_times_ms](double p) {
+        return frame_times_ms.empty() ? 0.0 : frame_times_ms[static_cast<size_t>(p * (frame_times_ms.size() - 1))];
+    };
+    double frame_sum = 0;
+    for (auto time : frame_times_ms) {
+        frame_sum += time;
+    }
+    std::cout << "{\"chunks\": " << chunks
+              << ", \"bytes\": " << bytes
+              << ", \"total_ms\": " << total_ms
+              << ", \"parse_ms\": " << parse_ms
+              << ", \"frames\": " << frame_times_ms.size()
+              << ", \"frame_ms_avg\": " << (frame_times_ms.empty() ? 0.0 : frame_sum / frame_times_ms.size())
+              << ", \"frame_ms_p50\": " << percentile(0.5)
+              << ", \"frame_ms_p99\": " << percentile(0.99)
+              << ", \"frame_ms_max\": " << percentile(1.0)
+              << ", \"dropped_frames\": " << dropped_frames << "}" << std::endl;
 }
 
 void Application::on_textinput_event(const SDL_TextInputEvent& event) {
     const auto* text = event.text;
-    write(master_fd_, text, SDL_strlen(text));
+    input_at_ = event_time(event.timestamp);
+    write_to_pty({text, SDL_strlen(text)});
+    input_at_.reset();
 }
 void Application::on_keys_pressed(const SDL_KeyboardEvent& event) {
+    input_at_ = event_time(event.timestamp);
+    handle_keys(event);
+    input_at_.reset();
+}
+
+void Application::handle_keys(const SDL_KeyboardEvent& event) {
     Uint16 mods = event.keysym.mod;
     SDL_Keycode keys = event.keysym.sym;
 
@@ -180,9 +445,25 @@ void Application::on_keys_pressed(const SDL_KeyboardEvent& event) {
     } else if (keys == SDLK_v && (mods & KMOD_CTRL) && (mods & KMOD_LSHIFT)) {
         char* clipboard_text = SDL_GetClipboardText();
         paste_text(clipboard_text);
-        delete clipboard_text;
+        SDL_free(clipboard_text);
     } else if (keys == SDLK_c && (mods & KMOD_CTRL) && (mods & KMOD_LSHIFT)) {
         copy_selected_text();
+    } else if (keys == SDLK_s && (mods & KMOD_CTRL) && (mods & KMOD_LSHIFT)) {
+        save_selected_text();
+    } else if (keys == SDLK_e && (mods & KMOD_CTRL) && (mods & KMOD_LSHIFT)) {
+        split_pane(PaneLayout::Split::SideBySide);
+    } else if (keys == SDLK_o && (mods & KMOD_CTRL) && (mods & KMOD_LSHIFT)) {
+        split_pane(PaneLayout::Split::Stacked);
+    } else if (keys == SDLK_w && (mods & KMOD_CTRL) && (mods & KMOD_LSHIFT)) {
+        close_focused_pane();
+    } else if (keys == SDLK_TAB && (mods & KMOD_CTRL)) {
+        window_->focus_next_pane();
+    } else if (keys == SDLK_F9) {
+        dump_latency_stats();
+    } else if (keys == SDLK_F10) {
+        write_trace();
+    } else if (keys == SDLK_F12) {
+        window_->toggle_hud();
     } else if (keys == SDLK_l && (mods & KMOD_CTRL)) {
         clear_text();
     } else if (keys == SDLK_BACKSPACE) {
@@ -211,35 +492,35 @@ void Application::on_quit_event([[maybe_unused]] const SDL_Event& event) {
 }
 
 void Application::send_newline() {
-    write(master_fd_, "\n", 1);
+    write_to_pty({"\n", 1});
 }
 
 void Application::send_sigsusp() {
     const char sigsusp = 0x1A;
-    write(master_fd_, &sigsusp, 1);
+    write_to_pty({&sigsusp, 1});
 }
 
 void Application::send_sigint() {
     const char sigint = 0x03;
-    write(master_fd_, &sigint, 1); // SIGINT send
+    write_to_pty({&sigint, 1}); // SIGINT send
 }
 
 void Application::on_arrowkey_pressed(SDL_Keycode sym) {
     switch (sym) {
         case SDLK_UP: {
-            write(master_fd_, "\033[A", 3);
+            write_to_pty({"\033[A", 3});
             break;
         }
         case SDLK_DOWN: {
-            write(master_fd_, "\033[B", 3);
+            write_to_pty({"\033[B", 3});
             break;
         }
         case SDLK_RIGHT: {
-            write(master_fd_, "\033[C", 3);
+            write_to_pty({"\033[C", 3});
             break;
         }
         case SDLK_LEFT: {
-            write(master_fd_, "\033[D", 3);
+            write_to_pty({"\033[D", 3});
             break;
         }
     }
@@ -248,100 +529,99 @@ void Application::on_arrowkey_pressed(SDL_Keycode sym) {
 
 void Application::erase_character() {
     const char backspace = 0x7F;
-    write(master_fd_, &backspace, 1);
+    write_to_pty({&backspace, 1});
 }
 void Application::on_backspace() {
     const char backspace = 0x08;
-    write(master_fd_, &backspace, 1);
+    write_to_pty({&backspace, 1});
 }
 
 void Application::send_eof() {
     const char eof = 0x04;
-    write(master_fd_, &eof, 1);
+    write_to_pty({&eof, 1});
 }
 
 void Application::clear_text() { // Clearing screen
     const char clear = 0x0C;
-    write(master_fd_, &clear, 1);
+    write_to_pty({&clear, 1});
 }
 
 void Application::reverse_find() {
     const char rev_find = 0x12;
-    write(master_fd_, &rev_find, 1);
+    write_to_pty({&rev_find, 1});
 }
 
 void Application::cursor_to_back() {
     const char cursor_to_the_back = 0x01;
-    write(master_fd_, &cursor_to_the_back, 1);
+    write_to_pty({&cursor_to_the_back, 1});
 }
 
 void Application::cursor_to_end() {
     const char cursor_to_the_end = 0x05;
-    write(master_fd_, &cursor_to_the_end, 1);
-}
-
-void Application::on_erase_event() {
-    window_->erase_at_end();
+    write_to_pty({&cursor_to_the_end, 1});
 }
 
-
-void Application::on_set_cursor(int row, int col) {
-    window_->set_cursor(row, col);
-}
-
-void Application::on_move_cursor(int row, int col) {
-    window_->move_cursor(row, col);
+void Application::paste_text(const char* text) {
+    if (window_->pane_count() > 0) {
+        window_->focused_pane().paste({text, SDL_strlen(text)});
+    }
 }
 
-
-void Application::on_add_cells(std::vector<Cell>&& cells) {
-    window_->add_cells(std::move(cells));
+void Application::split_pane(PaneLayout::Split direction) {
+    if (!options_.replay_path.empty()) {
+        return; // The recording has one screen
+    }
+    try {
+        window_->open_pane(Pane::spawn_shell(), direction);
+    } catch (const std::exception& ex) {
+        std::cerr << "Could not open a pane: " << ex.what() << std::endl;
+    }
 }
 
-void Application::paste_text(const char* text) {
-    write(master_fd_, text, SDL_strlen(text));
-}
-void Application::on_reset_cursor(bool x_dir, bool y_dir) {
-    window_->reset_cursor(x_dir, y_dir);
+void Application::close_focused_pane() {
+    if (window_->pane_count() > 0) {
+        close_pane(window_->focused_pane()); // Its shell gets SIGHUP
+    }
 }
 
 void Application::window_event(const SDL_WindowEvent& event) {
     if (event.event == SDL_WINDOWEVENT_RESIZED) {
         on_window_resized();
+    } else if (event.event == SDL_WINDOWEVENT_MOVED || event.event == SDL_WINDOWEVENT_DISPLAY_CHANGED) {
+        scheduler_.set_refresh_rate(window_->get_refresh_rate()); // Might be on another monitor now
+    } else if (event.event == SDL_WINDOWEVENT_FOCUS_GAINED || event.event == SDL_WINDOWEVENT_FOCUS_LOST) {
+        scheduler_.set_input_focus(event.event == SDL_WINDOWEVENT_FOCUS_GAINED);
+    } else if (event.event == SDL_WINDOWEVENT_CLOSE) {
+        is_running_ = false; // Only this window, the server keeps the others
     }
 }
 
-
-void Application::on_clear_requested(bool remove) {
-    window_->clear_buf(remove);
-}
-
-void Application::on_change_window_title(const std::string& win_title) {
-    window_->set_window_title(win_title);
-}
-void Application::on_erase_in_line(int mode) {
-    window_->erase_in_line(mode);
+void Application::copy_selected_text() {
+    auto text = window_->get_selected_text();
+    SDL_SetClipboardText(text.c_str());
 }
 
-void Application::on_insert_chars(int n) {
-    window_->insert_chars(n);
-}
-void Application::on_delete_chars(int n) {
-    window_->delete_chars(n);
+void Application::save_selected_text() {
+    auto path = std::filesystem::path(std::getenv("HOME")) / ".local/share/kemul/selection.txt";
+    std::ofstream file{path, std::ios::binary | std::ios::trunc};
+    if (!file.is_open()) {
+        std::cerr << "Could not open " << path << " for writing" << std::endl;
+        return;
+    }
+    window_->write_selected_text([&file](std::string_view chunk) {
+        file.write(chunk.data(), chunk.size());
+    });
 }
 
-void Application::copy_selected_text() {
-    auto text = window_->get_selected_text();
-    SDL_SetClipboardText(text.c_str());
+void Application::write_trace() {
+    if (options_.trace_path.empty()) {
+        return;
+    }
+    if (!Tracer::write(options_.trace_path)) {
+        std::cerr << "Could not write trace to " << options_.trace_path << std::endl;
+    }
 }
 
 void Application::on_window_resized() {
-    window_->resize();
-    auto win_size = window_->get_window_size();
-    auto font_size = window_->get_font_size();
-
-    winsize wins;
-    wins.ws_col = win_size.first / font_size.first;
-    wins.ws_row = 20;
-    ioctl(master_fd_, TIOCSWINSZ, &wins);
+    window_->resize(); // Panes tell their shells the new size
 }
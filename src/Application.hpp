@@ -3,45 +3,85 @@
 #include <SDL_events.h>
 #include <SDL_keyboard.h>
 #include <SDL_stdinc.h>
+#include <chrono>
 #include <memory>
+#include <optional>
 #include <string>
 #include <sys/poll.h>
 #include <vector>
 #include "Window.hpp"
 #include "Buffer.hpp"
 #include "Config.hpp"
+#include "TermCommand.hpp"
+#include "SessionRecording.hpp"
+#include "LatencyTracker.hpp"
+#include "FrameScheduler.hpp"
+#include "PerfStats.hpp"
+#include "Pane.hpp"
+#include "PaneLayout.hpp"
+#include "SharedResources.hpp"
 
+struct LaunchOptions {
+    std::string record_path; // Tee raw pty output into a recording
+    std::string replay_path; // Play a recording instead of running a shell
+    bool replay_realtime{false}; // Keep the recorded timing instead of going as fast as possible
+    std::string trace_path; // Chrome trace JSON, written at exit and on F10
+    bool bench_startup{false}; // Print how long startup took once the first prompt is on screen, then quit
+    std::chrono::steady_clock::time_point launched{std::chrono::steady_clock::now()}; // Startup times count from here
+};
 
-class AnsiParser;
 class EventHandler;
 class Application {
 private:
-    // Pty stuff
-    int master_fd_;
-    int slave_fd_;
-    pollfd fds_[1];
+    // Pty stuff, one per pane
+    std::vector<pollfd> fds_;
 
     // Settings stuff
     // bool echo_enabled_{false};
     // bool blocking_enabled_{false};
 
     bool is_running_{true};
+    LaunchOptions options_;
+    std::shared_ptr<SharedResources> shared_; // Config and fonts, shared with the other windows in server mode
 
     // Members
     std::unique_ptr<Window> window_;
     // std::unique_ptr<TermBuffer> buffer_;
     std::unique_ptr<EventHandler> event_handler_;
-    std::unique_ptr<AnsiParser> parser_;
+
+    std::unique_ptr<SessionRecorder> recorder_;
+    const Pane* recorded_pane_{nullptr}; // The first one, output of several shells mixed wouldn't replay
+
+    // Render scheduling
+    LatencyTracker latency_;
+    std::optional<LatencyTracker::Clock::time_point> input_at_; // When the key being handled was pressed
+    FrameScheduler scheduler_;
+
+    // Startup, in ms since options_.launched
+    double sdl_ready_ms_{0};
+    double window_ready_ms_{0}; // With the font loaded and the first pane set up
+    std::optional<double> first_output_ms_; // First bytes from any shell
 
 public:
-    explicit Application(const std::string &font_path);
+    explicit Application(const LaunchOptions& options = {}); // Standalone, sets up SDL itself
+    explicit Application(std::shared_ptr<SharedResources> shared, const LaunchOptions& options = {}); // One of the windows of a Server
     ~Application();
 
-    void run();
+    void run(); // Standalone loop, until the window is closed
+
+    // Steps of the loop, for a Server driving many of these
+    bool is_running() const { return is_running_; }
+    void collect_pty_fds(std::vector<pollfd>& fds) const; // Appends the pty of every pane with what to wait for on it
+    uint32_t window_id() const;
+    void handle_event(SDL_Event& event);
+    void on_pty_ready(int fd, short revents); // Reads/writes the pty of a pane, revents as from poll
+    void update(); // Parses what was read and presents a frame if it's time
+    int wait_ms() const; // How long the loop may sleep
 
     // Keypress events and others (like window resize)
     void on_textinput_event(const SDL_TextInputEvent& event);
     void on_keys_pressed(const SDL_KeyboardEvent& event);
+    void handle_keys(const SDL_KeyboardEvent& event);
     void on_quit_event(const SDL_Event& event);
 
     void window_event(const SDL_WindowEvent& event);
@@ -59,26 +99,27 @@ public:
     void cursor_to_back(); // CUrsor to the back
     void cursor_to_end(); // Cursor to the end
     void on_window_resized();
+    void split_pane(PaneLayout::Split direction);
+    void close_focused_pane();
 
 
     void copy_selected_text();
-
-    // Parser events
-    void on_erase_event();
-    void on_add_cells(std::vector<Cell>&& cells);
-    void on_set_cursor(int row, int col);
-    void on_move_cursor(int row, int col);
-    void on_reset_cursor(bool x_dir, bool y_dir);
-    void on_erase_in_line(int mode);
-    void on_clear_requested(bool remove);
-    void on_change_window_title(const std::string& win_title);
-    void on_insert_chars(int n);
-    void on_delete_chars(int n);
+    void save_selected_text(); // Streams selection into a file, meant for huge selections
+    void write_trace();
+    void dump_latency_stats(); // Keypress-to-photon numbers as JSON on stdout
 
 private:
+    void init(int shell_fd); // Window, the first pane on shell_fd and event subscriptions
     void init_sdl();
     void init_ttf();
-    void setup_pty(bool echo, int cols);
     void loop();
-    void set_blocking_mode(bool enabled);
+    double ms_since_launch() const;
+    void report_startup(); // --bench-startup JSON on stdout
+    void replay_loop(); // Feeds options_.replay_path through parser and renderer and reports timings
+    // Parses what the panes got until done or over budget, busy panes share it so more of them don't make frames later
+    void process_pending_output(PerfStats::Clock::duration budget = PerfStats::Clock::duration::max());
+    bool has_output_backlog() const;
+    void write_to_pty(std::string_view data); // Everything typed goes to the focused pane, it's timestamped for latency stats
+    void close_pane(Pane& pane); // Closes the window with the last one
+    void close_hung_up_panes(); // Once everything their shells wrote is parsed
 };
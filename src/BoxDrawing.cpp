@@ -0,0 +1,275 @@
+#include "BoxDrawing.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+namespace {
+enum Weight : uint8_t { none = 0, light = 1, heavy = 2, twin = 3 }; // twin = double line
+
+// Arms of U+2500..U+257F as left, right, up, down. '0' for the ones drawn some other way (dashes, arcs, diagonals)
+constexpr const char* arms[0x80] = {
+    "1100", "2200", "0011", "0022", "0000", "0000", "0000", "0000", "0000", "0000", "0000", "0000", "0101", "0201", "0102", "0202", // 2500
+    "1001", "2001", "1002", "2002", "0110", "0210", "0120", "0220", "1010", "2010", "1020", "2020", "0111", "0211", "0121", "0112", // 2510
+    "0122", "0221", "0212", "0222", "1011", "2011", "1021", "1012", "1022", "2021", "2012", "2022", "1101", "2101", "1201", "2201", // 2520
+    "1102", "2102", "1202", "2202", "1110", "2110", "1210", "2210", "1120", "2120", "1220", "2220", "1111", "2111", "1211", "2211", // 2530
+    "1121", "1112", "1122", "2121", "1221", "2112", "1212", "2221", "2212", "2122", "1222", "2222", "0000", "0000", "0000", "0000", // 2540
+    "3300", "0033", "0301", "0103", "0303", "3001", "1003", "3003", "0310", "0130", "0330", "3010", "1030", "3030", "0311", "0133", // 2550
+    "0333", "3011", "1033", "3033", "3301", "1103", "3303", "3310", "1130", "3330", "3311", "1133", "3333", "0000", "0000", "0000", // 2560
+    "0000", "0000", "0000", "0000", "1000", "0010", "0100", "0001", "2000", "0020", "0200", "0002", "1200", "0012", "2100", "0021", // 2570
+};
+
+class Canvas {
+public:
+    Canvas(int width, int height) : mask_{width, height, std::vector<uint8_t>(static_cast<size_t>(width) * height, 0)} {}
+
+    int width() const { return mask_.width; }
+    int height() const { return mask_.height; }
+
+    void rect(int x0, int y0, int x1, int y1, uint8_t alpha = 255) { // Exclusive ends, clipped
+        x0 = std::max(x0, 0);
+        y0 = std::max(y0, 0);
+        x1 = std::min(x1, mask_.width);
+        y1 = std::min(y1, mask_.height);
+        for (int y = y0; y < y1; ++y) {
+            for (int x = x0; x < x1; ++x) {
+                auto& pixel = mask_.alpha[static_cast<size_t>(y) * mask_.width + x];
+                pixel = std::max(pixel, alpha);
+            }
+        }
+    }
+
+    void blend(int x, int y, double coverage) {
+        if (x < 0 || y < 0 || x >= mask_.width || y >= mask_.height || coverage <= 0) {
+            return;
+        }
+        auto& pixel = mask_.alpha[static_cast<size_t>(y) * mask_.width + x];
+        pixel = std::max(pixel, static_cast<uint8_t>(std::lround(std::min(coverage, 1.0) * 255)));
+    }
+
+    GlyphMask take() { return std::move(mask_); }
+
+private:
+    GlyphMask mask_;
+};
+
+// Line thickness from the cell size, so it scales with the font
+int light_thickness(int width) {
+    return std::max(1, (width + 4) / 10);
+}
+
+// Band of a line of thickness t centred on the cell's middle, [start, start + t)
+int band_start(int size, int t) {
+    return size / 2 - t / 2;
+}
+
+int thickness(Weight weight, int t) {
+    return weight == heavy ? 2 * t : t;
+}
+
+// One straight arm: from the edge (the left one, or the right one if !from_start) to the middle of the cell, where it meets
+// the lines across it. before and after are those lines (up and down for a horizontal arm)
+void draw_arm(Canvas& canvas, Weight arm, bool horizontal, bool from_start, Weight before, Weight after) {
+    if (arm == none) {
+        return;
+    }
+    // Along is the direction of the arm, across the other one
+    const int along = horizontal ? canvas.width() : canvas.height();
+    const int across = horizontal ? canvas.height() : canvas.width();
+    const int t = light_thickness(canvas.width());
+    auto rect = [&](int along0, int along1, int across0, int width) {
+        if (horizontal) {
+            canvas.rect(along0, across0, along1, across0 + width);
+        } else {
+            canvas.rect(across0, along0, across0 + width, along1);
+        }
+    };
+    auto line = [&](int across0, int width, int reach_start, int reach_end) { // reach_* is how far it goes from either edge
+        if (from_start) {
+            rect(0, reach_end, across0, width);
+        } else {
+            rect(reach_start, along, across0, width);
+        }
+    };
+
+    const int centre = band_start(along, t); // Of a light line across
+    if (before == twin || after == twin) {
+        // Lines across are double: an inner line stops at the nearer of them, an outer one closes the corner
+        auto reach = [&](bool inner) {
+            return std::pair{inner ? centre + t : centre - t, inner ? centre : centre + 2 * t};
+        };
+        if (arm == twin) {
+            int mid = band_start(across, t);
+            auto [start0, end0] = reach(before == twin);
+            line(mid - t, t, start0, end0);
+            auto [start1, end1] = reach(after == twin);
+            line(mid + t, t, start1, end1);
+        } else {
+            int width = thickness(arm, t);
+            auto [start, end] = reach(before == twin && after == twin);
+            line(band_start(across, width), width, start, end);
+        }
+        return;
+    }
+
+    // Single or heavy lines across are covered, without any the arm ends in the middle
+    int across_t = std::max(before != none ? thickness(before, t) : 0, after != none ? thickness(after, t) : 0);
+    int start = across_t ? band_start(along, across_t) : along / 2;
+    int end = across_t ? start + across_t : along / 2;
+    if (arm == twin) {
+        int mid = band_start(across, t);
+        line(mid - t, t, start, end);
+        line(mid + t, t, start, end);
+    } else {
+        int width = thickness(arm, t);
+        line(band_start(across, width), width, start, end);
+    }
+}
+
+void draw_arms(Canvas& canvas, const char* spec) {
+    Weight left = Weight(spec[0] - '0'), right = Weight(spec[1] - '0'), up = Weight(spec[2] - '0'), down = Weight(spec[3] - '0');
+    draw_arm(canvas, left, true, true, up, down);
+    draw_arm(canvas, right, true, false, up, down);
+    draw_arm(canvas, up, false, true, left, right);
+    draw_arm(canvas, down, false, false, left, right);
+}
+
+void draw_dashes(Canvas& canvas, int dashes, Weight weight, bool is_vertical) {
+    const int w = canvas.width(), h = canvas.height();
+    const int t = thickness(weight, light_thickness(w));
+    int length = is_vertical ? h : w;
+    for (int i = 0; i < dashes; ++i) {
+        int start = i * length / dashes;
+        int end = (i + 1) * length / dashes;
+        int gap = std::max(1, (end - start) / 3); // Gap at the end of each dash, so dashes of neighbour cells are spaced evenly too
+        if (is_vertical) {
+            canvas.rect(band_start(w, t), start, band_start(w, t) + t, end - gap);
+        } else {
+            canvas.rect(start, band_start(h, t), end - gap, band_start(h, t) + t);
+        }
+    }
+}
+
+// Rounded corner: a quarter circle between the two arms, straight lines from it to the edges. dx, dy point to the arms
+void draw_arc(Canvas& canvas, int dx, int dy) {
+    const int w = canvas.width(), h = canvas.height();
+    const int t = light_thickness(w);
+    const double line_x = band_start(w, t) + t / 2.0; // Centre of the line, the same as of straight ones
+    const double line_y = band_start(h, t) + t / 2.0;
+    const double radius = std::min(w, h) / 2.0;
+    const double centre_x = line_x + dx * radius, centre_y = line_y + dy * radius;
+
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            double px = x + 0.5, py = y + 0.5;
+            if ((px - centre_x) * dx > 0 || (py - centre_y) * dy > 0) {
+                continue; // Not the quadrant of the arc
+            }
+            double distance = std::abs(std::hypot(px - centre_x, py - centre_y) - radius);
+            canvas.blend(x, y, t / 2.0 + 0.5 - distance);
+        }
+    }
+    int arc_end_x = static_cast<int>(std::lround(centre_x)), arc_end_y = static_cast<int>(std::lround(centre_y));
+    if (dx > 0) {
+        canvas.rect(arc_end_x, band_start(h, t), w, band_start(h, t) + t);
+    } else {
+        canvas.rect(0, band_start(h, t), arc_end_x, band_start(h, t) + t);
+    }
+    if (dy > 0) {
+        canvas.rect(band_start(w, t), arc_end_y, band_start(w, t) + t, h);
+    } else {
+        canvas.rect(band_start(w, t), 0, band_start(w, t) + t, arc_end_y);
+    }
+}
+
+// Corner to corner, antialiased. rising = from the bottom left to the top right
+void draw_diagonal(Canvas& canvas, bool rising) {
+    const int w = canvas.width(), h = canvas.height();
+    const double t = light_thickness(w);
+    const double length = std::hypot(w, h);
+    for (int y = 0; y < h; ++y) {
+        for (int x = 0; x < w; ++x) {
+            double px = x + 0.5, py = y + 0.5;
+            double distance = rising ? std::abs(h * px + w * py - w * h) / length : std::abs(h * px - w * py) / length;
+            canvas.blend(x, y, t / 2.0 + 0.5 - distance);
+        }
+    }
+}
+
+void draw_block(Canvas& canvas, uint32_t codepoint) {
+    const int w = canvas.width(), h = canvas.height();
+    auto eighth_y = [h](int n) { return (h * n + 4) / 8; };
+    auto eighth_x = [w](int n) { return (w * n + 4) / 8; };
+    if (codepoint == 0x2580) { // Upper half
+        canvas.rect(0, 0, w, eighth_y(4));
+    } else if (codepoint <= 0x2588) { // Lower eighths up to the full block
+        canvas.rect(0, h - eighth_y(codepoint - 0x2580), w, h);
+    } else if (codepoint <= 0x258F) { // Left seven eighths down to one
+        canvas.rect(0, 0, eighth_x(0x2590 - codepoint), h);
+    } else if (codepoint == 0x2590) { // Right half
+        canvas.rect(w - eighth_x(4), 0, w, h);
+    } else if (codepoint <= 0x2593) { // Shades, as plain alpha rather than dither patterns
+        canvas.rect(0, 0, w, h, static_cast<uint8_t>(64 * (codepoint - 0x2590)));
+    } else if (codepoint == 0x2594) { // Upper eighth
+        canvas.rect(0, 0, w, eighth_y(1));
+    } else if (codepoint == 0x2595) { // Right eighth
+        canvas.rect(w - eighth_x(1), 0, w, h);
+    } else { // Quadrants
+        constexpr uint8_t upper_left = 1, upper_right = 2, lower_left = 4, lower_right = 8;
+        constexpr uint8_t quadrants[10] = {
+            lower_left, lower_right, upper_left, upper_left | lower_left | lower_right, upper_left | lower_right,
+            upper_left | upper_right | lower_left, upper_left | upper_right | lower_right, upper_right, upper_right | lower_left,
+            upper_right | lower_left | lower_right,
+        };
+        auto bits = quadrants[codepoint - 0x2596];
+        int mid_x = eighth_x(4), mid_y = eighth_y(4);
+        if (bits & upper_left) canvas.rect(0, 0, mid_x, mid_y);
+        if (bits & upper_right) canvas.rect(mid_x, 0, w, mid_y);
+        if (bits & lower_left) canvas.rect(0, mid_y, mid_x, h);
+        if (bits & lower_right) canvas.rect(mid_x, mid_y, w, h);
+    }
+}
+}
+
+std::optional<GlyphMask> box_glyph(uint32_t codepoint, int width, int height) {
+    if (!is_box_drawing(codepoint) || width <= 0 || height <= 0) {
+        return std::nullopt;
+    }
+    Canvas canvas{width, height};
+    if (codepoint >= 0x2580) {
+        draw_block(canvas, codepoint);
+        return canvas.take();
+    }
+    switch (codepoint) {
+    case 0x2504: case 0x2505: // Triple dash
+        draw_dashes(canvas, 3, codepoint == 0x2505 ? heavy : light, false);
+        break;
+    case 0x2506: case 0x2507:
+        draw_dashes(canvas, 3, codepoint == 0x2507 ? heavy : light, true);
+        break;
+    case 0x2508: case 0x2509: // Quadruple dash
+        draw_dashes(canvas, 4, codepoint == 0x2509 ? heavy : light, false);
+        break;
+    case 0x250A: case 0x250B:
+        draw_dashes(canvas, 4, codepoint == 0x250B ? heavy : light, true);
+        break;
+    case 0x254C: case 0x254D: // Double dash
+        draw_dashes(canvas, 2, codepoint == 0x254D ? heavy : light, false);
+        break;
+    case 0x254E: case 0x254F:
+        draw_dashes(canvas, 2, codepoint == 0x254F ? heavy : light, true);
+        break;
+    case 0x256D: draw_arc(canvas, 1, 1); break; // Down and right
+    case 0x256E: draw_arc(canvas, -1, 1); break;
+    case 0x256F: draw_arc(canvas, -1, -1); break;
+    case 0x2570: draw_arc(canvas, 1, -1); break;
+    case 0x2571: draw_diagonal(canvas, true); break;
+    case 0x2572: draw_diagonal(canvas, false); break;
+    case 0x2573:
+        draw_diagonal(canvas, true);
+        draw_diagonal(canvas, false);
+        break;
+    default:
+        draw_arms(canvas, arms[codepoint - 0x2500]);
+    }
+    return canvas.take();
+}
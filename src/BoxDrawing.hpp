@@ -0,0 +1,14 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include "SoftwareRasterizer.hpp"
+
+// Box drawing and block elements (U+2500..U+259F) drawn from rects and lines instead of the font.
+// Glyphs fill the whole cell and lines sit at the same pixels in every cell, so borders and bars join without seams
+
+inline bool is_box_drawing(uint32_t codepoint) {
+    return codepoint >= 0x2500 && codepoint <= 0x259F;
+}
+
+// Coverage for a cell of width x height, nullopt if codepoint isn't one of them
+std::optional<GlyphMask> box_glyph(uint32_t codepoint, int width, int height);
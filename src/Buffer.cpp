@@ -1,16 +1,17 @@
 #include "Buffer.hpp"
+#include "Trace.hpp"
 #include <algorithm>
 #include <iterator>
 #include <print>
-#include <utf8cpp/utf8/cpp17.h>
+#include <optional>
 #include <utility>
 #include <vector>
-#include <utf8cpp/utf8.h>
 
 
 TermBuffer::TermBuffer(int width, int height, int cell_width, int cell_height) : cell_size_({cell_width, cell_height}) {
     width_cells_ = width / cell_width - 1;
     height_cells_ = height / cell_height;
+    screen_rows_ = height_cells_;
     buffer_.resize(height_cells_, std::vector<Cell>(width_cells_));
 }
 
@@ -22,8 +23,111 @@ void TermBuffer::clear_all() {
     reset();
 }
 
+void TermBuffer::clear_screen(bool remove) {
+    if (remove) {
+        clear_all();
+        scroll_request_ = 0;
+    } else {
+        set_cursor_position(max_pos_y_ + 1, cursor_x_);
+        scroll_request_ = max_pos_y_;
+    }
+}
+
+std::optional<int> TermBuffer::take_scroll_request() {
+    return std::exchange(scroll_request_, std::nullopt);
+}
+
+void TermBuffer::set_private_mode(int mode, bool enabled) {
+    if (mode == MODE_SYNCHRONIZED_OUTPUT) {
+        synchronized_output_ = enabled;
+    } else if (mode == MODE_BRACKETED_PASTE) {
+        bracketed_paste_ = enabled;
+    }
+}
+
+void TermBuffer::apply(const CommandBuffer& commands) {
+    TRACE_SCOPE("TermBuffer::apply");
+    for (const auto& command : commands.commands) {
+        switch (command.type) {
+            case CommandType::PRINT: {
+                print(commands.text.data() + command.a, command.b);
+                break;
+            }
+            case CommandType::SGR: {
+                pen_ = commands.pens[command.a];
+                break;
+            }
+            case CommandType::LINEFEED: {
+                cursor_down();
+                reset_cursor(true, false);
+                break;
+            }
+            case CommandType::CARRIAGE_RETURN: {
+                reset_cursor(true, false);
+                break;
+            }
+            case CommandType::SET_CURSOR: {
+                set_cursor_position(command.a, command.b);
+                break;
+            }
+            case CommandType::MOVE_CURSOR: {
+                move_cursor_pos_relative(command.a, command.b);
+                break;
+            }
+            case CommandType::ERASE_IN_LINE: {
+                erase_in_line(command.a);
+                break;
+            }
+            case CommandType::CLEAR: {
+                clear_screen(command.a != 0);
+                break;
+            }
+            case CommandType::INSERT_CHARS: {
+                insert_chars(command.a);
+                break;
+            }
+            case CommandType::DELETE_CHARS: {
+                delete_chars(command.a);
+                break;
+            }
+            case CommandType::DISCARD_LINES: {
+                discard_lines(command.a);
+                break;
+            }
+            case CommandType::PRIVATE_MODE: {
+                set_private_mode(command.a, command.b != 0);
+                break;
+            }
+            case CommandType::SIXEL_BEGIN: {
+                image_anchor_ = {evicted_lines_ + cursor_y_, cursor_x_};
+                break;
+            }
+            case CommandType::SIXEL_DATA: { // For the decoder, not the grid
+                break;
+            }
+            case CommandType::SIXEL_END: {
+                place_image(command.a, command.b);
+                break;
+            }
+            case CommandType::GRAPHICS: { // Transmission was handled by the pane, what's left is where images go
+                const auto& graphics = commands.graphics_commands[command.a];
+                if (graphics.drop_all) {
+                    drop_images(true);
+                } else if (graphics.drop) {
+                    drop_image(graphics.drop);
+                }
+                if (graphics.place) {
+                    place_graphics(graphics);
+                }
+                break;
+            }
+        }
+    }
+}
+
 
 void TermBuffer::reset() {
+    drop_images(true);
     buffer_.clear();
     buffer_.resize(height_cells_, std::vector<Cell>(width_cells_));
     cursor_x_ = 0;
@@ -60,6 +164,7 @@ void TermBuffer::reset_cursor(bool x_dir, bool y_dir) {
 
 
 void TermBuffer::add_cells(std::vector<Cell>&& cells) {
+    TRACE_SCOPE("TermBuffer::add_cells");
     for (auto&& cell : cells) {
         if (cell.codepoint == 0x0A) { // If newline
             cursor_down();
@@ -87,9 +192,25 @@ void TermBuffer::add_cells(std::vector<Cell>&& cells) {
 }
 
 
+void TermBuffer::print(const uint32_t* codepoints, int n) {
+    auto cell = pen_;
+    for (auto i = 0; i < n; ++i) {
+        cell.codepoint = codepoints[i];
+        buffer_[cursor_y_][cursor_x_] = cell;
+        if (++cursor_x_ >= width_cells_) {
+            // Set wrapline flag for the last symbol
+            buffer_[cursor_y_][width_cells_ - 1].set_wrapline();
+            cursor_down();
+            cursor_x_ = 0;
+        }
+    }
+}
+
+
 void TermBuffer::cursor_down() {
     if (++cursor_y_ == buffer_.size()) {
         expand_down();
+        trim_scrollback();
     }
     max_pos_y_ = std::max(cursor_y_, max_pos_y_);
 }
@@ -102,12 +223,146 @@ void TermBuffer::cursor_up(int n) {
 
 void TermBuffer::expand_down(int n) {
     for (auto i = 0; i < n; i++) {
-        buffer_.emplace_back(width_cells_);
+        if (!spare_rows_.empty() && static_cast<int>(spare_rows_.back().size()) == width_cells_) {
+            auto& row = buffer_.emplace_back(std::move(spare_rows_.back()));
+            spare_rows_.pop_back();
+            std::fill(row.begin(), row.end(), Cell{});
+        } else {
+            buffer_.emplace_back(width_cells_);
+        }
     }
     height_cells_ += n;
 }
 
 
+// Scrollback
+void TermBuffer::set_scrollback_limit(size_t lines) {
+    scrollback_limit_ = lines;
+    trim_scrollback(true);
+}
+
+void TermBuffer::trim_scrollback(bool force) {
+    size_t max_lines = get_max_lines();
+    size_t batch = std::max<size_t>(64, scrollback_limit_ / 8); // Erasing from the front moves every row, so do it rarely
+    if (buffer_.size() <= max_lines + (force ? 0 : batch)) {
+        return;
+    }
+    TRACE_SCOPE("TermBuffer::trim_scrollback");
+    int n = static_cast<int>(buffer_.size() - max_lines);
+    remove_selection(); // Selected rows may be gone, restore colors while they are still there
+
+    spare_rows_.clear();
+    for (auto it = buffer_.begin(); it != buffer_.begin() + std::min<size_t>(n, batch); ++it) { // Enough to cover the next batch
+        spare_rows_.push_back(std::move(*it));
+    }
+    buffer_.erase(buffer_.begin(), buffer_.begin() + n);
+
+    evicted_lines_ += n;
+    height_cells_ -= n;
+    cursor_y_ = std::max(0, cursor_y_ - n);
+    max_pos_y_ = std::max(0, max_pos_y_ - n);
+    drop_images(false);
+}
+
+size_t TermBuffer::memory_usage() const {
+    size_t bytes = (buffer_.capacity() + spare_rows_.capacity()) * sizeof(std::vector<Cell>);
+    for (const auto& row : buffer_) {
+        bytes += row.capacity() * sizeof(Cell);
+    }
+    for (const auto& row : spare_rows_) {
+        bytes += row.capacity() * sizeof(Cell);
+    }
+    return bytes;
+}
+
+void TermBuffer::discard_lines(size_t n) {
+    TRACE_SCOPE("TermBuffer::discard_lines");
+    remove_selection();
+    evicted_lines_ += cursor_y_ + n;
+    drop_images(true); // Nothing of the grid is left
+
+    buffer_.clear();
+    buffer_.resize(screen_rows_, std::vector<Cell>(width_cells_));
+    height_cells_ = screen_rows_;
+    cursor_x_ = 0;
+    cursor_y_ = 0;
+    max_pos_y_ = 0;
+}
+
+
+void TermBuffer::place_image(uint32_t image, int height_px) {
+    auto [line, col] = image_anchor_;
+    int rows = std::max(1, (height_px + cell_size_.second - 1) / cell_size_.second);
+    images_.push_back(ImagePlacement{image, line, col, rows});
+    // Text goes on below the image
+    auto cursor_line = evicted_lines_ + cursor_y_;
+    for (auto target = line + rows; cursor_line < target; ++cursor_line) {
+        cursor_down();
+    }
+    reset_cursor(true, false);
+    drop_images(false); // Going down may have evicted lines
+}
+
+void TermBuffer::place_graphics(const GraphicsCommand& command) {
+    auto [cell_w, cell_h] = cell_size_;
+    int cols = command.cols, rows = command.rows;
+    auto cells = [](long long pixels, int cell) { return static_cast<int>((pixels + cell - 1) / cell); };
+    if (cols == 0 && rows == 0) {
+        cols = cells(command.width, cell_w);
+        rows = cells(command.height, cell_h);
+    } else if (cols == 0) { // The missing one follows from the aspect ratio
+        cols = cells(static_cast<long long>(command.width) * rows * cell_h / std::max(1, command.height), cell_w);
+    } else if (rows == 0) {
+        rows = cells(static_cast<long long>(command.height) * cols * cell_w / std::max(1, command.width), cell_h);
+    }
+    cols = std::max(1, cols);
+    rows = std::max(1, rows);
+    images_.push_back(ImagePlacement{command.place, evicted_lines_ + cursor_y_, cursor_x_, rows, cols, command.cols > 0 || command.rows > 0});
+    if (command.keep_cursor) {
+        return;
+    }
+    // Right after the image on its last row, like kitty does
+    for (int row = 1; row < rows; ++row) {
+        cursor_down();
+    }
+    cursor_x_ = std::min(cursor_x_ + cols, width_cells_ - 1);
+    drop_images(false);
+}
+
+void TermBuffer::drop_image(uint32_t image) {
+    auto kept = std::remove_if(images_.begin(), images_.end(), [image](const ImagePlacement& placement) {
+        return placement.image == image;
+    });
+    if (kept != images_.end()) {
+        dropped_images_.push_back(image);
+    }
+    images_.erase(kept, images_.end());
+}
+
+void TermBuffer::drop_images(bool all) {
+    auto kept = std::remove_if(images_.begin(), images_.end(), [&](const ImagePlacement& placement) {
+        if (!all && placement.line + placement.rows > evicted_lines_) {
+            return false;
+        }
+        dropped_images_.push_back(placement.image);
+        return true;
+    });
+    images_.erase(kept, images_.end());
+}
+
+bool TermBuffer::drop_oldest_image() {
+    if (images_.empty()) {
+        return false;
+    }
+    dropped_images_.push_back(images_.front().image);
+    images_.erase(images_.begin());
+    return true;
+}
+
+std::vector<uint32_t> TermBuffer::take_dropped_images() {
+    return std::exchange(dropped_images_, {});
+}
+
 void TermBuffer::erase_in_line(int mode) {
     if (cursor_y_ >= (int)buffer_.size()) return;
 
@@ -225,6 +480,7 @@ void TermBuffer::iterate_mouse_selection(bool should_clear) {
 }
 
 void TermBuffer::set_selection(int start_x, int start_y, int end_x, int end_y, int scroll_offset) {
+    TRACE_SCOPE("TermBuffer::set_selection");
 
     if (start_y <= end_y) {
         mouse_start_cell.first = start_x / cell_size_.first;
@@ -256,6 +512,7 @@ void TermBuffer::set_selection(int start_x, int start_y, int end_x, int end_y, i
 }
 
 void TermBuffer::remove_selection() {
+    TRACE_SCOPE("TermBuffer::remove_selection");
     if (mouse_start_cell.first == -1 || mouse_start_cell.second == -1 || mouse_end_cell.first == -1 || mouse_end_cell.second == -1) {
         return;
     }
@@ -268,63 +525,41 @@ void TermBuffer::remove_selection() {
     mouse_end_cell.second = -1;
 }
 
-std::string TermBuffer::get_selected_text() const {
+std::optional<std::pair<std::pair<int, int>, std::pair<int, int>>> TermBuffer::selection_range() const {
     if (mouse_start_cell.first == -1 || mouse_start_cell.second == -1 || mouse_end_cell.first == -1 || mouse_end_cell.second == -1) {
-        return "";
+        return std::nullopt;
     }
-    std::string result;
-
-    if (mouse_start_cell.second == mouse_end_cell.second) {
-        // Selection on the same line
-        int x_start{0};
-        int x_end;
-        if (mouse_start_cell.first <= mouse_end_cell.first) {
-            x_start = mouse_start_cell.first;
-            x_end = mouse_end_cell.first;
-        } else if (mouse_start_cell.first > mouse_end_cell.first) {
-            x_start = mouse_end_cell.first;
-            x_end = mouse_start_cell.first;
-        }
-        x_end = std::min(x_end, width_cells_ - 1);
-
-        for (auto j = x_start; j <= x_end; ++j) {
-            auto character = buffer_[mouse_start_cell.second][j].codepoint;
-            result += std::move(utf8::utf32to8(std::u32string{character}));
-        }
-        return result;
+    auto start = mouse_start_cell;
+    auto end = mouse_end_cell;
+    if (start.second == end.second && start.first > end.first) { // Selection on the same line made backwards
+        std::swap(start.first, end.first);
     }
+    end.first = std::min(end.first, width_cells_ - 1);
+    return std::make_pair(start, end);
+}
 
-    auto i = mouse_start_cell.second;
-    do { // Iterating from start_cell.y up until end_cell.y
-
-        int x_start;
-        int x_end;
-
-        if (i == mouse_start_cell.second) {
-            x_start = mouse_start_cell.first;
-            x_end = width_cells_;
-        } else if (i == mouse_end_cell.second) {
-            x_start = 0;
-            x_end = mouse_end_cell.first;
-        } else {
-            x_start = 0;
-            x_end = width_cells_;
-        }
-
-        x_end = std::min(x_end, width_cells_ - 1);
+std::string TermBuffer::get_selected_text() const {
+    TRACE_SCOPE("TermBuffer::get_selected_text");
+    auto range = selection_range();
+    if (!range) {
+        return "";
+    }
+    return SelectionExporter{buffer_, range->first, range->second}.to_string();
+}
 
-        for (auto j = x_start; j <= x_end; ++j) {
-            auto character = buffer_[i][j].codepoint;
-            result += std::move(utf8::utf32to8(std::u32string{character}));
-        }
-        ++i;
-    } while (i <= mouse_end_cell.second);
-    return result;
+void TermBuffer::write_selected_text(const SelectionExporter::Sink& sink) const {
+    TRACE_SCOPE("TermBuffer::write_selected_text");
+    auto range = selection_range();
+    if (!range) {
+        return;
+    }
+    SelectionExporter{buffer_, range->first, range->second}.stream(sink);
 }
 
 
 // Resizing
 void TermBuffer::resize(std::pair<int, int> new_window_size, std::pair<int, int> font_size) {
+    TRACE_SCOPE("TermBuffer::resize");
     remove_selection(); // Check if something is selected already inside remove func
 
     cell_size_.first = font_size.first;
@@ -332,6 +567,7 @@ void TermBuffer::resize(std::pair<int, int> new_window_size, std::pair<int, int>
 
     int new_height_cells = new_window_size.second / cell_size_.second - 1;
     int new_width_cells = new_window_size.first / cell_size_.first;
+    screen_rows_ = std::max(new_height_cells, 1);
 
     if (height_cells_ < new_height_cells) {
         grow_lines(new_height_cells - height_cells_ + 1);
@@ -361,6 +597,7 @@ void TermBuffer::shrink_lines(int n) {
 
 
 void TermBuffer::grow_cols(int n) {
+    TRACE_SCOPE("TermBuffer::grow_cols");
     width_cells_ += n;
 
     std::vector<std::vector<Cell>> new_buffer;
@@ -409,6 +646,7 @@ void TermBuffer::grow_cols(int n) {
 
 
 void TermBuffer::shrink_cols(int n) {
+    TRACE_SCOPE("TermBuffer::shrink_cols");
     if (n >= width_cells_) {
         width_cells_ = 1;
     } else {
@@ -431,7 +669,7 @@ void TermBuffer::shrink_cols(int n) {
             } else { // If no wrapline
                 carry.resize(width_cells_);
                 new_buffer.push_back(std::move(carry)); // Push onto a new line
-                cursor_down(); // Make sure it doesnt fuck things up
+                ++cursor_y_; // Not cursor_down(), it could grow or trim buffer_ while we iterate over it
                 ++max_pos_y_; // So scrolling  isnt fucked
             }
             carry.clear(); // Clear carry-over
@@ -464,7 +702,11 @@ void TermBuffer::shrink_cols(int n) {
     }
 
     buffer_ = std::move(new_buffer);
+    height_cells_ = std::max<int>(height_cells_, buffer_.size());
     if (static_cast<int>(buffer_.size()) < height_cells_) {
         expand_down(height_cells_ - buffer_.size());
     }
+    cursor_y_ = std::min<int>(cursor_y_, buffer_.size() - 1);
+    max_pos_y_ = std::min<int>(max_pos_y_, buffer_.size() - 1);
+    trim_scrollback(); // Reflow may have produced more lines than the limit
 }
@@ -1,11 +1,14 @@
 #pragma once
-#include <SDL_pixels.h>
+#include <algorithm>
 #include <cstdint>
+#include <optional>
 #include <string>
 #include <utility>
 #include <vector>
 #include <unicode/uchar.h>
 #include "Cell.hpp"
+#include "SelectionExporter.hpp"
+#include "TermCommand.hpp"
 
 inline int cell_width(uint32_t codepoint) {
     if (codepoint == 0) return 1;
@@ -16,6 +19,35 @@ inline int cell_width(uint32_t codepoint) {
     return 1;
 }
 
+// Hash of how a row looks, the renderer keys cached row textures by it.
+// Hits aren't verified, a 64-bit collision draws one row stale until it changes
+inline uint64_t row_hash(const std::vector<Cell>& row) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    auto mix = [&hash](uint64_t value) {
+        hash = (hash ^ value) * 0x9e3779b97f4a7c15ull;
+        hash ^= hash >> 32;
+    };
+    for (const auto& cell : row) {
+        auto codepoint = cell.codepoint == 0 ? uint32_t{' '} : cell.codepoint; // Holes are drawn as blanks
+        uint64_t colors = (uint64_t{cell.fg_color.r} << 56) | (uint64_t{cell.fg_color.g} << 48) | (uint64_t{cell.fg_color.b} << 40) | (uint64_t{cell.fg_color.a} << 32)
+                        | (uint64_t{cell.bg_color.r} << 24) | (uint64_t{cell.bg_color.g} << 16) | (uint64_t{cell.bg_color.b} << 8) | cell.bg_color.a;
+        mix((uint64_t{codepoint} << 16) | (cell.flags & 0b0111)); // Wrapline doesn't change the look
+        mix(colors);
+    }
+    mix(row.size());
+    return hash;
+}
+
+
+// An image on the grid. It is anchored to a line, so it scrolls with the text and goes away with it
+struct ImagePlacement {
+    uint32_t image; // Id the pane keeps the pixels by
+    size_t line; // Absolute (evicted lines included) of the top row
+    int col;
+    int rows; // Cells it covers
+    int cols{0}; // Only known for fit images
+    bool fit{false}; // Stretched over cols x rows cells instead of drawn at its own size
+};
 
 // 0000 0000 0000 0001 - underline
 // 0000 0000 0000 0010 - bold
@@ -34,9 +66,28 @@ private:
 
     int width_cells_;
     int height_cells_;
+    int screen_rows_; // Rows visible at once, everything above them is scrollback
+
+    // Scrollback
+    size_t scrollback_limit_{10000}; // Lines kept above the screen
+    size_t evicted_lines_{0}; // Total amount of lines dropped from the top so far
+    std::vector<std::vector<Cell>> spare_rows_; // Evicted rows reused by expand_down instead of allocating new ones
 
     std::pair<int, int> cell_size_;
 
+    Cell pen_; // Attributes for printed characters, set by SGR commands
+    std::optional<int> scroll_request_; // Row the view should jump to, set by clearing the screen
+    bool synchronized_output_{false}; // Mode 2026, the grid holds a half drawn frame
+    bool bracketed_paste_{false}; // Mode 2004
+
+    // Images
+    std::vector<ImagePlacement> images_; // In the order they were placed
+    std::vector<uint32_t> dropped_images_; // Scrolled out or cleared since take_dropped_images()
+    std::pair<size_t, int> image_anchor_{0, 0}; // Cursor when the image being received started
+    void place_image(uint32_t image, int height_px);
+    void place_graphics(const GraphicsCommand& command); // Kitty placement at the cursor
+    void drop_images(bool all); // The ones above the scrollback, or all
+
     // mouse selection
     std::pair<int, int> mouse_start_cell{-1, -1};
     std::pair<int, int> mouse_end_cell{-1, -1};
@@ -48,15 +99,33 @@ private:
     void shrink_cols(int n);
 
     void iterate_mouse_selection(bool should_clear);
+    void trim_scrollback(bool force = false); // Drop lines over the scrollback limit, in batches unless forced
+    std::optional<std::pair<std::pair<int, int>, std::pair<int, int>>> selection_range() const; // Normalized {start, end} in cells
 public:
     TermBuffer() = delete;
     explicit TermBuffer(int width, int height, int cell_width, int cell_height);
+    static TermBuffer from_grid(int cols, int rows) { // Sized in cells instead of pixels, for headless use
+        return TermBuffer{cols + 1, rows, 1, 1};
+    }
     ~TermBuffer();
 
+    // Applying parser output
+    void apply(const CommandBuffer& commands);
+    std::optional<int> take_scroll_request();
+    void set_private_mode(int mode, bool enabled);
+    bool is_synchronized_output() const {
+        return synchronized_output_;
+    }
+    bool is_bracketed_paste() const {
+        return bracketed_paste_;
+    }
+
     // Adding cells
     void add_cells(std::vector<Cell>&& cells);
+    void print(const uint32_t* codepoints, int n); // Writes n characters with the current pen
 
     void clear_all();
+    void clear_screen(bool remove); // remove == false pushes the screen up into the scrollback
     void reset();
 
     // Cursor
@@ -73,6 +142,18 @@ public:
     void insert_chars(int n); // Insert n spaces henceforth shifting existing chars to the right
     void delete_chars(int n); // Delete n chars henceforth shiting existing chars to the left
 
+    // Scrollback
+    void set_scrollback_limit(size_t lines);
+    void discard_lines(size_t n); // Fast-forward: the next n lines would be evicted anyway, drop the grid instead of writing them
+
+    // Images
+    const std::vector<ImagePlacement>& get_images() const {
+        return images_;
+    }
+    bool drop_oldest_image(); // To free memory, false if there are none
+    void drop_image(uint32_t image); // All placements of it
+    std::vector<uint32_t> take_dropped_images(); // Their pixels can go
+
     // Resize stuff
     void resize(std::pair<int, int> new_window_size, std::pair<int, int> font_size);
 
@@ -80,6 +161,7 @@ public:
     void set_selection(int start_x, int start_y, int end_x, int end_y, int scroll_offset); // Invert colors to signal 'selection'
     void remove_selection(); // Unset mouse selection vaiables and undo
     std::string get_selected_text() const;
+    void write_selected_text(const SelectionExporter::Sink& sink) const; // Same text as get_selected_text but in chunks
 
     // Some getters
     const std::vector<std::vector<Cell>>& get_buffer() const {
@@ -91,4 +173,20 @@ public:
     int get_max_y() const {
         return max_pos_y_;
     }
+    size_t get_evicted_lines() const {
+        return evicted_lines_;
+    }
+    int get_screen_top() const { // First row of the screen when it follows the cursor
+        return std::max(0, std::max(cursor_y_, max_pos_y_) - screen_rows_ + 1);
+    }
+    std::pair<int, int> get_screen_size() const { // {cols, rows}
+        return {width_cells_, screen_rows_};
+    }
+    size_t get_max_lines() const { // Screen plus scrollback
+        return screen_rows_ + scrollback_limit_;
+    }
+    size_t get_scrollback_lines() const { // Lines above the screen
+        return get_screen_top();
+    }
+    size_t memory_usage() const; // Bytes held by rows, including the spare ones
 };
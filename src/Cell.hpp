@@ -1,9 +1,11 @@
-#include "SDL_pixels.h"
+#pragma once
+#include <cstdint>
+#include "Color.hpp"
 
 struct Cell {
     uint32_t codepoint;
-    SDL_Color fg_color{200, 200, 200, 255};
-    SDL_Color bg_color{0, 0, 0, 255};
+    Color fg_color{200, 200, 200, 255};
+    Color bg_color{0, 0, 0, 255};
     uint16_t flags{0}; // Underline, bold, etc
 
     void set_underline(bool value = true) {
@@ -1,8 +1,12 @@
 #pragma once
-#include <SDL2/SDL_pixels.h>
-bool inline operator==(const SDL_Color& lhs, const SDL_Color& rhs) {
-    if (lhs.r == rhs.r && lhs.g == rhs.g && lhs.b == rhs.b && lhs.a == rhs.a) {
-        return true;
-    }
-    return false;
-}
\ No newline at end of file
+#include <cstdint>
+
+// Same layout as SDL_Color, so the core doesn't need SDL headers
+struct Color {
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+    uint8_t a;
+
+    bool operator==(const Color& rhs) const = default;
+};
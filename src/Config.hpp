@@ -1,13 +1,23 @@
+#pragma once
+#include <algorithm>
 #include <filesystem>
 #include <iostream>
 #include <string>
 #include <fstream>
+#include <vector>
 
 struct Config {
     std::string font_path{"/usr/share/fonts/TTF/DejaVuSansMono.ttf"};
     int font_ptsize{16};
+    std::vector<std::string> font_fallback; // Tried in order for glyphs the main font doesn't have
+    bool ligatures{true}; // Shape text, when built with KEMUL_SHAPING
     int default_window_width{400};
     int default_window_height{200};
+    size_t scrollback_lines{10000};
+    int max_fps{0}; // 0 = as fast as the display refreshes
+    size_t row_cache_mb{64}; // VRAM for cached row textures
+    size_t image_cache_mb{128}; // VRAM for textures of images on screen
+    bool software_renderer{false}; // renderer=software, draw on the CPU
 
     Config(const std::filesystem::path& path) {
         std::ifstream file{path};
@@ -35,6 +45,20 @@ struct Config {
                         continue;
                     }
                     font_path = std::move(value);
+                } else if (name == "fontFallback") {
+                    font_fallback.clear();
+                    size_t start = 0;
+                    while (start <= value.size()) {
+                        auto end = std::min(value.find(',', start), value.size());
+                        auto fallback = value.substr(start, end - start);
+                        start = end + 1;
+                        if (fallback.empty()) continue;
+                        if (!std::filesystem::exists(fallback)) {
+                            std::cerr << "Such fallback font doesn't exist: " << fallback << std::endl;
+                            continue;
+                        }
+                        font_fallback.push_back(std::move(fallback));
+                    }
                 } else if (name == "defaultWindowWidth") {
                     try {
                         auto width = std::stoi(value);
@@ -51,6 +75,50 @@ struct Config {
                     } catch (const std::exception& ex) {
                         std::cerr << ex.what() << std::endl;
                     }
+                } else if (name == "scrollbackLines") {
+                    try {
+                        auto lines = std::stoi(value);
+                        if (lines < 0) continue;
+                        scrollback_lines = lines;
+                    } catch (const std::exception& ex) {
+                        std::cerr << ex.what() << std::endl;
+                    }
+                } else if (name == "maxFps") {
+                    try {
+                        auto fps = std::stoi(value);
+                        if (fps < 0) continue;
+                        max_fps = fps;
+                    } catch (const std::exception& ex) {
+                        std::cerr << ex.what() << std::endl;
+                    }
+                } else if (name == "renderer") {
+                    if (value != "software" && value != "gpu") {
+                        std::cerr << "Unknown renderer, expected software or gpu" << std::endl;
+                        continue;
+                    }
+                    software_renderer = value == "software";
+                } else if (name == "ligatures") {
+                    if (value != "on" && value != "off") {
+                        std::cerr << "Ligatures are either on or off" << std::endl;
+                        continue;
+                    }
+                    ligatures = value == "on";
+                } else if (name == "rowCacheMB") {
+                    try {
+                        auto megabytes = std::stoi(value);
+                        if (megabytes < 0) continue;
+                        row_cache_mb = megabytes;
+                    } catch (const std::exception& ex) {
+                        std::cerr << ex.what() << std::endl;
+                    }
+                } else if (name == "imageCacheMB") {
+                    try {
+                        auto megabytes = std::stoi(value);
+                        if (megabytes < 0) continue;
+                        image_cache_mb = megabytes;
+                    } catch (const std::exception& ex) {
+                        std::cerr << ex.what() << std::endl;
+                    }
                 }
             } else {
                 continue;
@@ -36,6 +36,11 @@ void EventHandler::handle_event(SDL_Event& event) {
             dispatch(SDL_MOUSEBUTTONUP, event);
             break;
         }
+        case SDL_RENDER_TARGETS_RESET:
+        case SDL_RENDER_DEVICE_RESET: {
+            dispatch(SDL_RENDER_TARGETS_RESET, event);
+            break;
+        }
         case SDL_WINDOWEVENT: {
             dispatch(SDL_WINDOWEVENT, event);
             // COnnect app to this
@@ -0,0 +1,149 @@
+#include "FontCoverage.hpp"
+#include <bit>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <unistd.h>
+#include "Trace.hpp"
+
+namespace {
+constexpr uint32_t coverage_version = 1;
+
+void put_le(std::ofstream& file, uint64_t value, int size) {
+    char bytes[8];
+    for (auto i = 0; i < size; ++i) {
+        bytes[i] = static_cast<char>(value >> (8 * i));
+    }
+    file.write(bytes, size);
+}
+
+bool get_le(std::ifstream& file, uint64_t& value, int size) {
+    unsigned char bytes[8];
+    if (!file.read(reinterpret_cast<char*>(bytes), size)) {
+        return false;
+    }
+    value = 0;
+    for (auto i = 0; i < size; ++i) {
+        value |= static_cast<uint64_t>(bytes[i]) << (8 * i);
+    }
+    return true;
+}
+
+// Size and modification time, a font that was updated gets its coverage built again
+bool fingerprint(const std::filesystem::path& font, uint64_t& size, int64_t& mtime) {
+    std::error_code error;
+    size = std::filesystem::file_size(font, error);
+    if (error) {
+        return false;
+    }
+    auto time = std::filesystem::last_write_time(font, error);
+    mtime = std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+    return !error;
+}
+}
+
+FontCoverage::FontCoverage() : bits_(codepoint_count / 64, 0) {}
+
+void FontCoverage::set(uint32_t codepoint) {
+    if (codepoint < codepoint_count) {
+        bits_[codepoint >> 6] |= uint64_t{1} << (codepoint & 63);
+    }
+}
+
+size_t FontCoverage::count() const {
+    size_t total = 0;
+    for (auto word : bits_) {
+        total += std::popcount(word);
+    }
+    return total;
+}
+
+std::filesystem::path FontCoverage::cache_path(const std::filesystem::path& cache_dir, const std::filesystem::path& font) {
+    auto name = std::hash<std::string>{}(std::filesystem::absolute(font).string());
+    return cache_dir / (std::to_string(name) + ".kcov");
+}
+
+bool FontCoverage::save(const std::filesystem::path& path, const std::filesystem::path& font) const {
+    uint64_t size;
+    int64_t mtime;
+    if (!fingerprint(font, size, mtime)) {
+        return false;
+    }
+    auto font_path = std::filesystem::absolute(font).string();
+    auto temp = path;
+    temp += "." + std::to_string(getpid()); // Renamed over the cache once complete, so a reader never sees half of it
+    {
+        std::ofstream file{temp, std::ios::binary | std::ios::trunc};
+        if (!file.is_open()) {
+            return false;
+        }
+        file.write("KCOV", 4);
+        put_le(file, coverage_version, 4);
+        put_le(file, size, 8);
+        put_le(file, static_cast<uint64_t>(mtime), 8);
+        put_le(file, font_path.size(), 4);
+        file.write(font_path.data(), font_path.size());
+        for (auto word : bits_) {
+            put_le(file, word, 8);
+        }
+        if (!file) {
+            std::filesystem::remove(temp);
+            return false;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temp, path, error);
+    return !error;
+}
+
+std::optional<FontCoverage> FontCoverage::load(const std::filesystem::path& path, const std::filesystem::path& font) {
+    std::ifstream file{path, std::ios::binary};
+    if (!file.is_open()) {
+        return std::nullopt;
+    }
+    uint64_t size;
+    int64_t mtime;
+    if (!fingerprint(font, size, mtime)) {
+        return std::nullopt;
+    }
+    char magic[4];
+    uint64_t version, file_size, file_mtime, path_length;
+    if (!file.read(magic, 4) || std::string_view{magic, 4} != "KCOV" || !get_le(file, version, 4) || version != coverage_version
+        || !get_le(file, file_size, 8) || !get_le(file, file_mtime, 8) || file_size != size || file_mtime != static_cast<uint64_t>(mtime)
+        || !get_le(file, path_length, 4) || path_length > 4096) {
+        return std::nullopt;
+    }
+    std::string font_path(path_length, '\0');
+    if (!file.read(font_path.data(), path_length) || font_path != std::filesystem::absolute(font).string()) {
+        return std::nullopt; // Another font with the same hash
+    }
+    FontCoverage coverage;
+    for (auto& word : coverage.bits_) {
+        if (!get_le(file, word, 8)) {
+            return std::nullopt;
+        }
+    }
+    return coverage;
+}
+
+FontCoverage FontCoverage::load_or_build(const std::filesystem::path& cache_dir, const std::filesystem::path& font, const std::function<bool(uint32_t)>& has_glyph) {
+    auto path = cache_path(cache_dir, font);
+    if (auto cached = load(path, font)) {
+        return std::move(*cached);
+    }
+    TRACE_SCOPE("FontCoverage::build");
+    FontCoverage coverage;
+    for (uint32_t codepoint = 0; codepoint < codepoint_count; ++codepoint) {
+        if ((codepoint < 0xD800 || codepoint > 0xDFFF) && has_glyph(codepoint)) { // Surrogates aren't characters
+            coverage.set(codepoint);
+        }
+    }
+    std::error_code error;
+    std::filesystem::create_directories(cache_dir, error);
+    if (!coverage.save(path, font)) {
+        std::cerr << "Could not cache font coverage in " << path << std::endl;
+    }
+    return coverage;
+}
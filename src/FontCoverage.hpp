@@ -0,0 +1,35 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <vector>
+
+// Which codepoints a font has glyphs for, one bit each over all of Unicode (136 KB). Picking the face of a fallback chain
+// for a glyph is a bit test then. Building it means asking the font about every codepoint, so it is cached on disk.
+// Cache file, integers little-endian:
+//   "KCOV", u32 version (1), u64 font file size, i64 font mtime, u32 path length, font path, then the bits as u64 words
+class FontCoverage {
+public:
+    static constexpr uint32_t codepoint_count = 0x110000;
+
+    FontCoverage();
+
+    void set(uint32_t codepoint);
+    bool test(uint32_t codepoint) const {
+        return codepoint < codepoint_count && ((bits_[codepoint >> 6] >> (codepoint & 63)) & 1);
+    }
+    size_t count() const;
+
+    bool save(const std::filesystem::path& path, const std::filesystem::path& font) const; // Atomically, other processes may read it
+    // nullopt if there is no cache or it was made for another font or an older version of the file
+    static std::optional<FontCoverage> load(const std::filesystem::path& path, const std::filesystem::path& font);
+    static std::filesystem::path cache_path(const std::filesystem::path& cache_dir, const std::filesystem::path& font);
+
+    // From the cache in cache_dir, or asks has_glyph about every codepoint and caches the result
+    static FontCoverage load_or_build(const std::filesystem::path& cache_dir, const std::filesystem::path& font, const std::function<bool(uint32_t)>& has_glyph);
+
+private:
+    std::vector<uint64_t> bits_;
+};
@@ -0,0 +1,218 @@
+#include "FontFace.hpp"
+#include "BoxDrawing.hpp"
+#include "Trace.hpp"
+#include <iostream>
+#include <stdexcept>
+#include <utf8cpp/utf8/cpp17.h>
+#ifdef KEMUL_SHAPING
+#include "TextShaper.hpp"
+#endif
+
+FontFace::FontFace(const std::string& path, int ptsize, const std::vector<std::string>& fallbacks, const std::filesystem::path& cache_dir, bool shaping) {
+    font_ = TTF_OpenFont(path.c_str(), ptsize);
+    if (!font_) {
+        throw std::runtime_error(std::string{"Could not load a font: "} + TTF_GetError());
+    }
+    TTF_SizeText(font_, " ", &cell_size_.first, &cell_size_.second);
+#ifdef KEMUL_SHAPING
+    if (shaping) {
+        try {
+            shaper_ = std::make_unique<TextShaper>(path, ptsize, cell_size_, TTF_FontAscent(font_));
+        } catch (const std::exception& ex) {
+            std::cerr << ex.what() << ", no ligatures" << std::endl;
+        }
+    }
+#else
+    (void)shaping;
+#endif
+    if (fallbacks.empty()) {
+        return; // Everything comes from the main font, no need to know what it covers
+    }
+
+    TRACE_SCOPE("FontFace::load_fallbacks");
+    auto coverage_of = [&](TTF_Font* font, const std::string& font_path) {
+        return FontCoverage::load_or_build(cache_dir, font_path, [font](uint32_t codepoint) {
+            return TTF_GlyphIsProvided32(font, codepoint) != 0;
+        });
+    };
+    try {
+        chain_.push_back({font_, coverage_of(font_, path)});
+        for (const auto& fallback_path : fallbacks) {
+            TTF_Font* fallback = TTF_OpenFont(fallback_path.c_str(), ptsize);
+            if (!fallback) {
+                std::cerr << "Could not load fallback font " << fallback_path << ": " << TTF_GetError() << std::endl;
+                continue;
+            }
+            chain_.push_back({fallback, FontCoverage{}});
+            chain_.back().coverage = coverage_of(fallback, fallback_path);
+        }
+    } catch (...) {
+        close_fonts();
+        throw;
+    }
+}
+
+FontFace::~FontFace() {
+    for (auto& [codepoint, surface] : surfaces_) {
+        SDL_FreeSurface(surface);
+    }
+    close_fonts();
+}
+
+void FontFace::close_fonts() {
+    for (size_t i = 1; i < chain_.size(); ++i) { // The first one is font_
+        TTF_CloseFont(chain_[i].font);
+    }
+    chain_.clear();
+    TTF_CloseFont(font_);
+}
+
+TTF_Font* FontFace::font_for(uint32_t codepoint) const {
+    for (const auto& face : chain_) {
+        if (face.coverage.test(codepoint)) {
+            return face.font;
+        }
+    }
+    return font_;
+}
+
+uint32_t FontFace::glyph_key(uint32_t codepoint) const {
+    if (chain_.empty() || (codepoint & glyph_index_bit) || is_box_drawing(codepoint)) {
+        return codepoint;
+    }
+    for (const auto& face : chain_) {
+        if (face.coverage.test(codepoint)) {
+            return codepoint;
+        }
+    }
+    return 0xFFFD; // Nobody has it, one replacement glyph for all of them instead of a tofu box rasterized per codepoint
+}
+
+const ShapedRun* FontFace::shape(std::u32string_view text, uint16_t style) {
+#ifdef KEMUL_SHAPING
+    if (!shaper_) {
+        return nullptr;
+    }
+    if (auto* run = shaped_runs_.find(text, style)) {
+        return run;
+    }
+    return &shaped_runs_.insert(text, style, shaper_->shape(text));
+#else
+    (void)text;
+    (void)style;
+    return nullptr;
+#endif
+}
+
+int FontFace::glyph_offset(uint32_t key) const {
+    auto iter = glyph_offsets_.find(key);
+    return iter != glyph_offsets_.end() ? iter->second : 0;
+}
+
+int FontFace::height() const {
+    return TTF_FontHeight(font_);
+}
+
+SDL_Surface* FontFace::box_surface(const GlyphMask& mask) const {
+    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, mask.width, mask.height, 32, SDL_PIXELFORMAT_ARGB8888);
+    if (!surface) {
+        std::cerr << "Could not create glyph surface: " << SDL_GetError() << '\n';
+        return nullptr;
+    }
+    SDL_LockSurface(surface);
+    for (int y = 0; y < mask.height; ++y) {
+        auto* line = reinterpret_cast<uint32_t*>(static_cast<uint8_t*>(surface->pixels) + y * surface->pitch);
+        for (int x = 0; x < mask.width; ++x) {
+            line[x] = static_cast<uint32_t>(mask.alpha[static_cast<size_t>(y) * mask.width + x]) << 24 | 0x00FFFFFFu; // White like TTF glyphs
+        }
+    }
+    SDL_UnlockSurface(surface);
+    return surface;
+}
+
+SDL_Surface* FontFace::render(uint32_t codepoint) {
+    TRACE_SCOPE("FontFace::render");
+    if (auto box = box_glyph(codepoint, cell_size_.first, cell_size_.second)) {
+        return box_surface(*box);
+    }
+#ifdef KEMUL_SHAPING
+    if (codepoint & glyph_index_bit) {
+        if (!shaper_) {
+            return nullptr;
+        }
+        int offset_x = 0;
+        auto* surface = shaper_->render(codepoint & ~glyph_index_bit, offset_x);
+        if (offset_x != 0) {
+            glyph_offsets_[codepoint] = offset_x;
+        }
+        return surface;
+    }
+#endif
+    TTF_Font* font = font_for(codepoint);
+    std::string utf8_char = utf8::utf32to8(std::u32string{codepoint});
+    SDL_Surface* surface = TTF_RenderUTF8_Blended(font, utf8_char.c_str(), SDL_Color{255, 255, 255, 255});
+    if (!surface) {
+        std::cerr << "Glyph surface is null\n";
+    }
+    return surface;
+}
+
+SDL_Surface* FontFace::glyph_surface(uint32_t codepoint) {
+    codepoint = glyph_key(codepoint);
+    if (auto iter = surfaces_.find(codepoint); iter != surfaces_.end()) {
+        return iter->second;
+    }
+    SDL_Surface* surface = render(codepoint);
+    if (surface) {
+        surfaces_.emplace(codepoint, surface);
+    }
+    return surface;
+}
+
+void FontFace::prerender(uint32_t first, uint32_t last, bool masks) {
+    TRACE_SCOPE("FontFace::prerender");
+    for (auto codepoint = first; codepoint <= last; ++codepoint) {
+        if (masks) {
+            glyph_mask(codepoint);
+        } else {
+            glyph_surface(codepoint);
+        }
+    }
+}
+
+const GlyphMask* FontFace::find_glyph_mask(uint32_t codepoint) const {
+    auto iter = masks_.find(glyph_key(codepoint));
+    return iter != masks_.end() ? &iter->second : nullptr;
+}
+
+const GlyphMask* FontFace::glyph_mask(uint32_t codepoint) {
+    codepoint = glyph_key(codepoint);
+    if (auto* mask = find_glyph_mask(codepoint)) {
+        return mask;
+    }
+    if (auto box = box_glyph(codepoint, cell_size_.first, cell_size_.second)) {
+        return &(masks_[codepoint] = std::move(*box));
+    }
+    SDL_Surface* rendered = render(codepoint);
+    if (!rendered) {
+        return nullptr;
+    }
+    SDL_Surface* glyph_surf = SDL_ConvertSurfaceFormat(rendered, SDL_PIXELFORMAT_ARGB8888, 0); // So alpha is always the top byte
+    SDL_FreeSurface(rendered);
+    if (!glyph_surf) {
+        std::cerr << "Could not convert glyph surface: " << SDL_GetError() << '\n';
+        return nullptr;
+    }
+
+    GlyphMask mask{glyph_surf->w, glyph_surf->h, std::vector<uint8_t>(static_cast<size_t>(glyph_surf->w) * glyph_surf->h)};
+    SDL_LockSurface(glyph_surf);
+    for (int y = 0; y < glyph_surf->h; ++y) {
+        const auto* line = reinterpret_cast<const uint32_t*>(static_cast<const uint8_t*>(glyph_surf->pixels) + y * glyph_surf->pitch);
+        for (int x = 0; x < glyph_surf->w; ++x) {
+            mask.alpha[static_cast<size_t>(y) * glyph_surf->w + x] = line[x] >> 24;
+        }
+    }
+    SDL_UnlockSurface(glyph_surf);
+    SDL_FreeSurface(glyph_surf);
+    return &(masks_[codepoint] = std::move(mask));
+}
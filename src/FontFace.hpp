@@ -0,0 +1,72 @@
+#pragma once
+#include <SDL2/SDL_surface.h>
+#include <SDL2/SDL_ttf.h>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "FontCoverage.hpp"
+#include "ShapeCache.hpp"
+#include "SoftwareRasterizer.hpp"
+
+// A loaded font and the glyphs rendered from it. One per font in the process, shared by all windows:
+// a glyph is rasterized once and then only uploaded into the atlas of each window that draws it.
+// With fallback fonts every glyph comes from the first font of the chain that has it, looked up in their coverage bits.
+// Built with KEMUL_SHAPING runs of text can be shaped, their glyphs are keyed by index with glyph_index_bit set
+class TextShaper;
+
+class FontFace {
+private:
+    struct Fallback {
+        TTF_Font* font;
+        FontCoverage coverage;
+    };
+
+    TTF_Font* font_;
+    std::pair<int, int> cell_size_{0, 0};
+    std::vector<Fallback> chain_; // The main font first, empty without fallbacks
+    std::unordered_map<uint32_t, SDL_Surface*> surfaces_; // White on transparent
+    std::unordered_map<uint32_t, GlyphMask> masks_; // For the software renderer
+#ifdef KEMUL_SHAPING
+    std::unique_ptr<TextShaper> shaper_; // nullptr with shaping off
+#endif
+    ShapeCache shaped_runs_;
+    std::unordered_map<uint32_t, int> glyph_offsets_; // Of shaped glyphs that start left of their pen position
+
+    SDL_Surface* render(uint32_t codepoint); // Caller owns the surface. Box drawing is generated, not taken from the font
+    SDL_Surface* box_surface(const GlyphMask& mask) const;
+    TTF_Font* font_for(uint32_t codepoint) const;
+    // What a glyph is cached under: U+FFFD for codepoints no font has, so they all share one replacement glyph
+    uint32_t glyph_key(uint32_t codepoint) const;
+    void close_fonts();
+public:
+    static constexpr uint32_t glyph_index_bit = 0x8000'0000; // Past any codepoint
+
+    // Throws if the font can't be opened, a fallback that can't is skipped. Coverage of the fonts is kept in cache_dir.
+    // shaping is ignored without KEMUL_SHAPING
+    FontFace(const std::string& path, int ptsize, const std::vector<std::string>& fallbacks = {}, const std::filesystem::path& cache_dir = {}, bool shaping = false);
+    ~FontFace();
+    FontFace(const FontFace&) = delete;
+    FontFace& operator=(const FontFace&) = delete;
+
+    TTF_Font* font() const { return font_; }
+    std::pair<int, int> cell_size() const { return cell_size_; }
+    int height() const;
+
+    SDL_Surface* glyph_surface(uint32_t codepoint); // nullptr if the glyph can't be rendered
+    const GlyphMask* glyph_mask(uint32_t codepoint); // Same
+    const GlyphMask* find_glyph_mask(uint32_t codepoint) const; // Without rendering, nullptr if not there yet
+    // Renders first..last ahead of time, surfaces or masks for the software renderer. Safe on another thread as long as nothing else uses the face meanwhile
+    void prerender(uint32_t first, uint32_t last, bool masks);
+
+    // Glyphs for a run of cells, memoized. nullptr if shaping is off
+    const ShapedRun* shape(std::u32string_view text, uint16_t style);
+    int glyph_offset(uint32_t key) const; // Where the surface of a shaped glyph starts relative to its pen position
+
+    size_t glyph_count() const { return surfaces_.size() + masks_.size(); }
+};
@@ -0,0 +1,72 @@
+#include "FrameScheduler.hpp"
+#include <algorithm>
+
+namespace {
+// SDL events are only read between polls, this bounds how late a key is picked up. Waking 250 times a second
+// costs well under 1% of a core, and only while the window has keyboard focus
+constexpr int input_wait_ms = 4;
+constexpr int fallback_refresh_hz = 60;
+}
+
+FrameScheduler::FrameScheduler(int max_fps) : max_fps_(std::max(0, max_fps)) {}
+
+void FrameScheduler::set_refresh_rate(int hz) {
+    refresh_hz_ = hz > 0 ? hz : fallback_refresh_hz;
+}
+
+void FrameScheduler::set_max_fps(int fps) {
+    max_fps_ = std::max(0, fps);
+}
+
+FrameScheduler::Clock::duration FrameScheduler::frame_interval() const {
+    int fps = max_fps_ > 0 ? std::min(max_fps_, refresh_hz_) : refresh_hz_;
+    return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / fps));
+}
+
+FrameScheduler::Clock::duration FrameScheduler::parse_budget() const {
+    return frame_interval() / 2; // The other half is for drawing and events
+}
+
+bool FrameScheduler::should_present(bool dirty, const LatencyTracker& latency, Clock::time_point now) const {
+    if (!dirty) {
+        return false;
+    }
+    if (latency.echo_ready()) {
+        return true;
+    }
+    if (latency.waiting_for_echo(now)) {
+        return false;
+    }
+    return now - last_present_ >= frame_interval();
+}
+
+int FrameScheduler::wait_ms(bool dirty, bool backlog, const LatencyTracker& latency, Clock::time_point now) const {
+    if (backlog) {
+        return 0;
+    }
+    // Without focus no keys come, a frame is soon enough for the mouse
+    long long max_wait = input_focus_ ? input_wait_ms : std::chrono::ceil<std::chrono::milliseconds>(frame_interval()).count();
+    if (!dirty) {
+        return static_cast<int>(max_wait);
+    }
+    if (latency.echo_ready()) {
+        return 0;
+    }
+    auto present_at = last_present_ + frame_interval();
+    if (latency.waiting_for_echo(now)) {
+        present_at = latency.echo_deadline();
+    }
+    if (present_at <= now) {
+        return 0;
+    }
+    auto wait = std::chrono::ceil<std::chrono::milliseconds>(present_at - now).count();
+    return static_cast<int>(std::min<long long>(wait, max_wait));
+}
+
+void FrameScheduler::on_present(Clock::time_point time) {
+    last_present_ = time;
+}
+
+void FrameScheduler::set_input_focus(bool focused) {
+    input_focus_ = focused;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <chrono>
+#include "LatencyTracker.hpp"
+
+// Decides when the main loop presents a frame and how long it may sleep.
+// Frames go out at most once per display refresh (or maxFps if it is lower), except for the echo of typed input
+// which is presented as soon as it arrives. Panes in a synchronized update (mode 2026) hold their own slots, see Pane::holds_frame
+class FrameScheduler {
+public:
+    using Clock = LatencyTracker::Clock;
+
+    explicit FrameScheduler(int max_fps = 0); // 0 = display refresh rate
+
+    void set_refresh_rate(int hz); // 0 if the display doesn't report it
+    void set_max_fps(int fps);
+    Clock::duration frame_interval() const;
+    Clock::duration parse_budget() const; // How long parsing may run before the next frame has to be drawn
+
+    // dirty: there is something new to draw
+    bool should_present(bool dirty, const LatencyTracker& latency, Clock::time_point now) const;
+    // poll timeout in ms, backlog: there is unparsed output that has to be picked up without waiting
+    int wait_ms(bool dirty, bool backlog, const LatencyTracker& latency, Clock::time_point now) const;
+    void on_present(Clock::time_point time);
+    void set_input_focus(bool focused); // Keys only come to a focused window, an unfocused one may sleep a frame
+
+private:
+    int refresh_hz_{60};
+    int max_fps_{0};
+    bool input_focus_{true};
+    Clock::time_point last_present_{};
+};
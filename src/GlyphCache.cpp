@@ -1,57 +1,56 @@
 #include "GlyphCache.hpp"
+#include "Trace.hpp"
 #include <SDL_rect.h>
 #include <SDL_render.h>
 #include <SDL_surface.h>
 #include <SDL_ttf.h>
 #include <optional>
 #include <stdexcept>
-#include <utf8cpp/utf8/cpp17.h>
 #include <iostream>
 #include <utility>
 
-GlyphCache::GlyphCache(SDL_Renderer* renderer, TTF_Font* font, std::pair<int, int> max_dimensions) : max_width_(max_dimensions.first), max_height_(max_dimensions.second) {
+GlyphCache::GlyphCache(SDL_Renderer* renderer, std::pair<int, int> max_dimensions) : max_width_(max_dimensions.first), max_height_(max_dimensions.second) {
     reset_atlas(renderer);
 }
 GlyphCache::~GlyphCache() {
     SDL_DestroyTexture(atlas_texture_);
 }
 
-SDL_Rect GlyphCache::add_glyph(SDL_Renderer* renderer, TTF_Font* font, uint32_t codepoint) {
-    std::string utf8_char = utf8::utf32to8(std::u32string{codepoint});
-    SDL_Surface* glyph_surf = TTF_RenderUTF8_Blended(font, utf8_char.c_str(), SDL_Color{255, 255, 255, 255});
+SDL_Rect GlyphCache::add_glyph(SDL_Renderer* renderer, FontFace& face, uint32_t codepoint) {
+    TRACE_SCOPE("GlyphCache::add_glyph");
+    SDL_Surface* glyph_surf = face.glyph_surface(codepoint); // Rendered once per process, owned by the face
     if (!glyph_surf) {
-        std::cerr << "Glyph surface is null\n";
         return{};
     }
-    
+
     SDL_Texture* glyph_texture = SDL_CreateTextureFromSurface(renderer, glyph_surf);
     if (!glyph_texture) {
         std::cerr << "Glyph texture is null\n";
-        SDL_FreeSurface(glyph_surf);
         return{};
     }
 
     SDL_SetTextureBlendMode(glyph_texture, SDL_BLENDMODE_NONE);
 
     if (atlas_x_ + glyph_surf->w > max_width_) {
-        atlas_y_ += TTF_FontHeight(font);
+        atlas_y_ += face.height();
         atlas_x_ = 0;
     }
+    row_height_ = face.height();
 
-    if (atlas_y_ + TTF_FontHeight(font) > max_height_) {
+    if (atlas_y_ + face.height() > max_height_) {
         reset_atlas(renderer);
     }
 
     SDL_Rect dest_rect = {atlas_x_, atlas_y_, glyph_surf->w, glyph_surf->h};
+    auto* previous_target = SDL_GetRenderTarget(renderer); // Might be a row texture being drawn
     SDL_SetRenderTarget(renderer, atlas_texture_);
     SDL_RenderCopy(renderer, glyph_texture, NULL, &dest_rect);
-    SDL_SetRenderTarget(renderer, NULL);
+    SDL_SetRenderTarget(renderer, previous_target);
     glyph_positions_[codepoint] = dest_rect;
 
     atlas_x_ += glyph_surf->w;
 
     SDL_DestroyTexture(glyph_texture);
-    SDL_FreeSurface(glyph_surf);
     return dest_rect;
 }
 
@@ -64,6 +63,15 @@ void GlyphCache::reset_atlas(SDL_Renderer* renderer) {
     atlas_y_ = 0;
 }
 
+double GlyphCache::atlas_occupancy() const {
+    double used = static_cast<double>(atlas_y_) * max_width_ + static_cast<double>(atlas_x_) * row_height_;
+    return used / (static_cast<double>(max_width_) * max_height_);
+}
+
+void GlyphCache::invalidate(SDL_Renderer* renderer) {
+    reset_atlas(renderer);
+}
+
 bool GlyphCache::glyph_exists(uint32_t codepoint) {
     return glyph_positions_.find(codepoint) != glyph_positions_.end();
 }
@@ -75,10 +83,21 @@ std::optional<SDL_Rect> GlyphCache::get_glyph_pos(uint32_t codepoint) {
     return std::nullopt;
 }
 
-SDL_Rect GlyphCache::get_or_create_glyph_pos(SDL_Renderer* renderer, TTF_Font* font, uint32_t codepoint) {
+const GlyphMask* GlyphCache::get_or_create_mask(FontFace& face, uint32_t codepoint) {
+    if (auto* mask = face.find_glyph_mask(codepoint)) {
+        ++hits_;
+        return mask;
+    }
+    ++misses_;
+    return face.glyph_mask(codepoint);
+}
+
+SDL_Rect GlyphCache::get_or_create_glyph_pos(SDL_Renderer* renderer, FontFace& face, uint32_t codepoint) {
     if (auto iter = glyph_positions_.find(codepoint); iter != glyph_positions_.end()) {
+        ++hits_;
         return iter->second;
     }
-    auto rect = add_glyph(renderer, font, codepoint);
+    ++misses_;
+    auto rect = add_glyph(renderer, face, codepoint);
     return rect;
 }
\ No newline at end of file
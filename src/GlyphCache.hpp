@@ -7,6 +7,7 @@
 #include <string>
 #include <unordered_map>
 #include <utility>
+#include "FontFace.hpp"
 
 class GlyphCache {
 private:
@@ -17,18 +18,30 @@ private:
 
     int atlas_x_{0};
     int atlas_y_{0};
+    int row_height_{0}; // Height of the atlas row being filled
+
+    // Stats for the HUD
+    uint64_t hits_{0};
+    uint64_t misses_{0};
 
     std::unordered_map<uint32_t, SDL_Rect> glyph_positions_;
 
     void reset_atlas(SDL_Renderer* renderer);
 public:
-    explicit GlyphCache(SDL_Renderer* renderer, TTF_Font* font, std::pair<int, int> max_dimensions);
+    explicit GlyphCache(SDL_Renderer* renderer, std::pair<int, int> max_dimensions);
     ~GlyphCache();
 
-    SDL_Rect add_glyph(SDL_Renderer* renderer, TTF_Font* font, uint32_t codepoint);
+    SDL_Rect add_glyph(SDL_Renderer* renderer, FontFace& face, uint32_t codepoint);
+    void invalidate(SDL_Renderer* renderer); // Starts over with an empty atlas
 
     bool glyph_exists(uint32_t codepoint);
     std::optional<SDL_Rect> get_glyph_pos(uint32_t codepoint);
-    SDL_Rect get_or_create_glyph_pos(SDL_Renderer* renderer, TTF_Font* font, uint32_t codepoint);
+    SDL_Rect get_or_create_glyph_pos(SDL_Renderer* renderer, FontFace& face, uint32_t codepoint);
+    const GlyphMask* get_or_create_mask(FontFace& face, uint32_t codepoint); // For the software renderer, nullptr if the glyph can't be rendered
     SDL_Texture* const atlas() const { return atlas_texture_; }
+
+    uint64_t get_hits() const { return hits_; }
+    uint64_t get_misses() const { return misses_; }
+    size_t glyph_count() const { return glyph_positions_.size(); }
+    double atlas_occupancy() const; // Used part of the atlas, 0..1
 };
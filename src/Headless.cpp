@@ -0,0 +1,114 @@
+#include "Headless.hpp"
+#include "Utf8.hpp"
+#include <algorithm>
+#include <cstdint>
+
+HeadlessTerminal::HeadlessTerminal(int cols, int rows, size_t scrollback_lines) : buffer_(TermBuffer::from_grid(cols, rows)) {
+    buffer_.set_scrollback_limit(scrollback_lines);
+}
+
+void HeadlessTerminal::resize(int cols, int rows) {
+    // Pixels are cells here. TermBuffer::resize grows one column past the width it's given, shrinking is exact
+    int old_cols = buffer_.get_screen_size().first;
+    buffer_.resize({cols > old_cols ? cols - 1 : cols, rows + 1}, {1, 1});
+}
+
+void HeadlessTerminal::feed(std::string_view bytes) {
+    std::string_view text = bytes;
+    if (!pending_.empty()) {
+        pending_.append(bytes);
+        text = pending_;
+    }
+
+    auto [cols, rows] = buffer_.get_screen_size();
+    size_t consumed = 0;
+    do { // More than one pass only if parsing stopped at the end of a synchronized update
+        auto rest = text.substr(consumed);
+        size_t keep_lines = fast_forward_ && rest.size() > static_cast<size_t>(cols * rows) ? buffer_.get_max_lines() : 0;
+        consumed += parser_.parse(rest, commands_, keep_lines);
+        buffer_.apply(commands_);
+        if (commands_.title) {
+            title_ = *commands_.title;
+        }
+        commands_.clear();
+    } while (parser_.stopped_at_frame_end() && consumed < text.size());
+
+    pending_ = std::string{text.substr(consumed)};
+}
+
+std::string HeadlessTerminal::dump_text(bool with_scrollback) const {
+    const auto& rows = buffer_.get_buffer();
+    int top = with_scrollback ? 0 : buffer_.get_screen_top();
+    int bottom = with_scrollback ? static_cast<int>(rows.size()) : std::min<int>(rows.size(), top + buffer_.get_screen_size().second);
+
+    std::string result;
+    char encoded[4];
+    for (auto i = top; i < bottom; ++i) {
+        const auto& row = rows[i];
+        auto end = static_cast<int>(row.size());
+        while (end > 0 && (row[end - 1].codepoint == 0 || row[end - 1].codepoint == ' ')) {
+            --end;
+        }
+        for (auto j = 0; j < end; ++j) {
+            auto codepoint = row[j].codepoint == 0 ? uint32_t{' '} : row[j].codepoint;
+            result.append(encoded, encode_utf8(codepoint, encoded));
+        }
+        result += '\n';
+    }
+    return result;
+}
+
+uint64_t HeadlessTerminal::render() const {
+    const auto& rows = buffer_.get_buffer();
+    int top = buffer_.get_screen_top();
+    int bottom = std::min<int>(rows.size(), top + buffer_.get_screen_size().second);
+
+    uint64_t checksum = 0;
+    for (auto i = top; i < bottom; ++i) {
+        for (const auto& cell : rows[i]) {
+            checksum = checksum * 31 + cell.codepoint + cell.fg_color.r + cell.bg_color.r + cell.flags;
+        }
+    }
+    return checksum;
+}
+
+namespace {
+void put_u32(std::ostream& out, uint32_t value) {
+    char bytes[4] = {static_cast<char>(value), static_cast<char>(value >> 8), static_cast<char>(value >> 16), static_cast<char>(value >> 24)};
+    out.write(bytes, 4);
+}
+
+void put_color(std::ostream& out, const Color& color) {
+    char bytes[4] = {static_cast<char>(color.r), static_cast<char>(color.g), static_cast<char>(color.b), static_cast<char>(color.a)};
+    out.write(bytes, 4);
+}
+}
+
+// Snapshot format, all integers little-endian:
+//   "KSNP", u32 version (1), u32 cols, u32 rows, u32 cursor col, u32 cursor row (relative to the screen top)
+//   then rows * cols cells: u32 codepoint, fg rgba, bg rgba, u16 flags
+void HeadlessTerminal::write_snapshot(std::ostream& out) const {
+    const auto& rows = buffer_.get_buffer();
+    auto [cols, screen_rows] = buffer_.get_screen_size();
+    auto [cursor_x, cursor_y] = buffer_.get_cursor_pos();
+    int top = buffer_.get_screen_top();
+
+    out.write("KSNP", 4);
+    put_u32(out, 1);
+    put_u32(out, cols);
+    put_u32(out, screen_rows);
+    put_u32(out, cursor_x);
+    put_u32(out, std::max(0, cursor_y - top));
+
+    const Cell blank{};
+    for (auto i = top; i < top + screen_rows; ++i) {
+        for (auto j = 0; j < cols; ++j) {
+            const Cell& cell = i < static_cast<int>(rows.size()) && j < static_cast<int>(rows[i].size()) ? rows[i][j] : blank;
+            put_u32(out, cell.codepoint);
+            put_color(out, cell.fg_color);
+            put_color(out, cell.bg_color);
+            char flags[2] = {static_cast<char>(cell.flags), static_cast<char>(cell.flags >> 8)};
+            out.write(flags, 2);
+        }
+    }
+}
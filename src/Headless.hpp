@@ -0,0 +1,47 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include "ANSIParser.hpp"
+#include "Buffer.hpp"
+#include "TermCommand.hpp"
+
+// Parser and grid without a window: feeds bytes in and dumps what the screen would show.
+// Used by kemul_headless, benchmarks and tests
+class HeadlessTerminal {
+private:
+    AnsiParser parser_;
+    TermBuffer buffer_;
+    CommandBuffer commands_;
+    std::string pending_; // Cut escape sequence waiting for the rest of it
+    std::string title_;
+    bool fast_forward_{true};
+
+public:
+    explicit HeadlessTerminal(int cols, int rows, size_t scrollback_lines = 10000);
+
+    void feed(std::string_view bytes);
+    void resize(int cols, int rows);
+    void set_fast_forward(bool value) {
+        fast_forward_ = value;
+    }
+
+    // Rows of the screen (or everything with scrollback) as UTF-8, trailing blanks trimmed, one row per line
+    std::string dump_text(bool with_scrollback = false) const;
+    // Binary snapshot of the screen, see the format in Headless.cpp
+    void write_snapshot(std::ostream& out) const;
+    // Walks the visible cells like Window::draw does and returns a checksum of them, stands in for a frame in benchmarks
+    uint64_t render() const;
+
+    const TermBuffer& buffer() const {
+        return buffer_;
+    }
+    TermBuffer& buffer() {
+        return buffer_;
+    }
+    const std::string& title() const {
+        return title_;
+    }
+};
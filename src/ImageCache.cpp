@@ -0,0 +1,61 @@
+#include "ImageCache.hpp"
+#include <SDL2/SDL_pixels.h>
+
+ImageCache::ImageCache(size_t budget_bytes) : budget_bytes_(budget_bytes) {}
+
+ImageCache::~ImageCache() {
+    clear();
+}
+
+void ImageCache::set_budget(size_t budget_bytes) {
+    budget_bytes_ = budget_bytes;
+    evict(0);
+}
+
+void ImageCache::clear() {
+    for (auto& [key, entry] : entries_) {
+        SDL_DestroyTexture(entry.texture);
+    }
+    entries_.clear();
+    lru_.clear();
+    used_bytes_ = 0;
+}
+
+void ImageCache::erase(uint64_t key) {
+    auto iter = entries_.find(key);
+    if (iter == entries_.end()) {
+        return;
+    }
+    SDL_DestroyTexture(iter->second.texture);
+    used_bytes_ -= iter->second.bytes;
+    lru_.erase(iter->second.lru_pos);
+    entries_.erase(iter);
+}
+
+void ImageCache::evict(size_t needed) {
+    while (!lru_.empty() && used_bytes_ + needed > budget_bytes_) {
+        erase(lru_.back());
+    }
+}
+
+SDL_Texture* ImageCache::get(SDL_Renderer* renderer, uint64_t key, const DecodedImage& image) {
+    if (auto iter = entries_.find(key); iter != entries_.end()) {
+        lru_.splice(lru_.begin(), lru_, iter->second.lru_pos);
+        return iter->second.texture;
+    }
+    auto bytes = image.bytes();
+    if (bytes == 0 || bytes > budget_bytes_) {
+        return nullptr;
+    }
+    evict(bytes);
+    auto* texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, image.width, image.height);
+    if (!texture) {
+        return nullptr;
+    }
+    SDL_UpdateTexture(texture, nullptr, image.pixels.data(), image.width * static_cast<int>(sizeof(uint32_t)));
+    SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_BLEND); // Transparent sixels show the text background
+    lru_.push_front(key);
+    entries_[key] = Entry{texture, bytes, lru_.begin()};
+    used_bytes_ += bytes;
+    return texture;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <SDL2/SDL_render.h>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include "Sixel.hpp"
+
+// Textures of the images panes show, uploaded once and drawn over the rows they cover.
+// Least recently used ones are dropped once they take more than the budget, the pixels stay with the pane
+class ImageCache {
+private:
+    struct Entry {
+        SDL_Texture* texture;
+        size_t bytes;
+        std::list<uint64_t>::iterator lru_pos;
+    };
+
+    std::unordered_map<uint64_t, Entry> entries_;
+    std::list<uint64_t> lru_; // Most recently used first
+    size_t budget_bytes_;
+    size_t used_bytes_{0};
+
+    void evict(size_t needed);
+
+public:
+    explicit ImageCache(size_t budget_bytes);
+    ~ImageCache();
+    ImageCache(const ImageCache&) = delete;
+    ImageCache& operator=(const ImageCache&) = delete;
+
+    void set_budget(size_t budget_bytes);
+    void clear(); // Before the renderer goes, or after the render targets were lost
+    void erase(uint64_t key);
+
+    // Uploaded on a miss. nullptr if it can't be created or is bigger than the whole budget
+    SDL_Texture* get(SDL_Renderer* renderer, uint64_t key, const DecodedImage& image);
+
+    size_t size() const { return entries_.size(); }
+    size_t memory_usage() const { return used_bytes_; }
+};
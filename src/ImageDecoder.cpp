@@ -0,0 +1,148 @@
+#include "ImageDecoder.hpp"
+#include <cerrno>
+#include <cstring>
+#include <optional>
+#include <iostream>
+#include <stdexcept>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <unordered_map>
+#include "Trace.hpp"
+
+ImageDecoder::~ImageDecoder() {
+    if (worker_.joinable()) {
+        {
+            std::lock_guard lock{mutex_};
+            stopping_ = true;
+        }
+        wake_.notify_one();
+        worker_.join();
+    }
+    if (event_fd_ >= 0) {
+        close(event_fd_);
+    }
+}
+
+void ImageDecoder::start() {
+    event_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (event_fd_ < 0) {
+        throw std::runtime_error(std::string{"Could not create eventfd: "} + std::strerror(errno));
+    }
+    worker_ = std::thread{&ImageDecoder::run, this};
+}
+
+void ImageDecoder::begin(uint32_t id, bool transparent) {
+    if (!worker_.joinable()) {
+        start();
+    }
+    {
+        std::lock_guard lock{mutex_};
+        ++in_flight_;
+    }
+    push(Job{Job::Kind::begin, id, transparent, {}});
+}
+
+void ImageDecoder::feed(uint32_t id, std::string_view data) {
+    if (!worker_.joinable() || data.empty() || dropped_.contains(id)) {
+        return;
+    }
+    {
+        std::lock_guard lock{mutex_};
+        if (queued_bytes_ + data.size() > max_queued_bytes) {
+            std::cerr << "Image " << id << " comes in faster than it can be decoded, dropping it" << std::endl;
+            dropped_.insert(id);
+            return;
+        }
+        queued_bytes_ += data.size();
+    }
+    push(Job{Job::Kind::data, id, false, std::string{data}});
+}
+
+void ImageDecoder::end(uint32_t id) {
+    if (!worker_.joinable()) {
+        return;
+    }
+    dropped_.erase(id); // Still ends, as an image cut where it was dropped
+    push(Job{Job::Kind::end, id, false, {}});
+}
+
+void ImageDecoder::convert(uint32_t id, PixelData pixels, int format, int width, int height) {
+    if (!worker_.joinable()) {
+        start();
+    }
+    {
+        std::lock_guard lock{mutex_};
+        ++in_flight_;
+    }
+    push(Job{Job::Kind::convert, id, false, {}, std::move(pixels), format, width, height});
+}
+
+void ImageDecoder::push(Job job) {
+    {
+        std::lock_guard lock{mutex_};
+        jobs_.push_back(std::move(job));
+    }
+    wake_.notify_one();
+}
+
+void ImageDecoder::run() {
+    std::unordered_map<uint32_t, SixelDecoder> decoders; // Only touched by this thread
+    std::unique_lock lock{mutex_};
+    while (true) {
+        wake_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+        if (stopping_) {
+            return;
+        }
+        auto job = std::move(jobs_.front());
+        jobs_.pop_front();
+        queued_bytes_ -= job.data.size();
+        lock.unlock();
+
+        std::optional<std::pair<uint32_t, DecodedImage>> finished;
+        if (job.kind == Job::Kind::begin) {
+            decoders.insert_or_assign(job.id, SixelDecoder{job.transparent});
+        } else if (job.kind == Job::Kind::convert) {
+            TRACE_SCOPE("ImageDecoder::convert");
+            if (job.pixels.read()) {
+                finished.emplace(job.id, convert_pixels(job.pixels.bytes(), job.format, job.width, job.height));
+            } else {
+                std::cerr << "Image " << job.id << " got shorter before it could be read, dropping it" << std::endl;
+                finished.emplace(job.id, DecodedImage{}); // No pixels, the pane drops it
+            }
+            job.pixels = PixelData{}; // Freed here, not under the lock
+        } else if (auto iter = decoders.find(job.id); iter != decoders.end()) {
+            TRACE_SCOPE("ImageDecoder::decode");
+            if (job.kind == Job::Kind::data) {
+                iter->second.feed(job.data);
+            } else {
+                finished.emplace(job.id, iter->second.finish());
+                decoders.erase(iter);
+            }
+        }
+
+        lock.lock();
+        if (finished) {
+            decoded_.push_back(std::move(*finished));
+            uint64_t one = 1;
+            if (write(event_fd_, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+                std::cerr << "Could not signal a decoded image: " << std::strerror(errno) << std::endl;
+            }
+        }
+    }
+}
+
+std::vector<std::pair<uint32_t, DecodedImage>> ImageDecoder::take_decoded() {
+    if (event_fd_ >= 0) {
+        uint64_t count;
+        while (read(event_fd_, &count, sizeof(count)) > 0) {
+        }
+    }
+    std::lock_guard lock{mutex_};
+    in_flight_ -= decoded_.size();
+    return std::exchange(decoded_, {});
+}
+
+bool ImageDecoder::busy() const {
+    std::lock_guard lock{mutex_};
+    return in_flight_ > 0;
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "KittyGraphics.hpp"
+#include "Sixel.hpp"
+
+// Decodes sixel images on a worker thread, so parsing never waits for it. Data is handed over piece by piece as the parser
+// sees it, finished images are picked up with take_decoded(). event_fd() becomes readable when there are some.
+// Raw pixels of the kitty graphics protocol are read from their file and converted there too.
+// The thread and the eventfd are only created with the first image
+class ImageDecoder {
+public:
+    static constexpr size_t max_queued_bytes = 64 * 1024 * 1024; // An image arriving faster than this is decoded is dropped
+
+    ImageDecoder() = default;
+    ~ImageDecoder();
+    ImageDecoder(const ImageDecoder&) = delete;
+    ImageDecoder& operator=(const ImageDecoder&) = delete;
+
+    void begin(uint32_t id, bool transparent);
+    void feed(uint32_t id, std::string_view data);
+    void end(uint32_t id);
+    void convert(uint32_t id, PixelData pixels, int format, int width, int height); // RGB or RGBA, see convert_pixels()
+
+    int event_fd() const { return event_fd_; } // -1 before the first image
+    std::vector<std::pair<uint32_t, DecodedImage>> take_decoded(); // Also resets event_fd()
+    bool busy() const; // Images begun but not taken yet
+
+private:
+    struct Job {
+        enum class Kind : uint8_t { begin, data, end, convert } kind;
+        uint32_t id;
+        bool transparent{false};
+        std::string data;
+        PixelData pixels{}; // Of convert
+        int format{0};
+        int width{0};
+        int height{0};
+    };
+
+    std::thread worker_;
+    int event_fd_{-1};
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::deque<Job> jobs_;
+    size_t queued_bytes_{0};
+    std::vector<std::pair<uint32_t, DecodedImage>> decoded_;
+    size_t in_flight_{0}; // Begun, not taken
+    std::unordered_set<uint32_t> dropped_; // Ids that went over max_queued_bytes, their remaining data is ignored. Main thread only
+    bool stopping_{false};
+
+    void start();
+    void push(Job job);
+    void run();
+};
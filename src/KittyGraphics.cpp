@@ -0,0 +1,248 @@
+#include "KittyGraphics.hpp"
+#include <array>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+namespace {
+std::runtime_error error(const char* code, std::string_view what) {
+    return std::runtime_error(std::string{code} + ":" + std::string{what});
+}
+
+// Checks what fd is before anything reads from it, size bytes from offset are read later, all there is after offset if size is 0
+PixelData read_later(int fd, const GraphicsCommand& command) {
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        close(fd);
+        throw error("EINVAL", "Not a regular file");
+    }
+    auto total = static_cast<size_t>(info.st_size);
+    if (command.offset > total || command.size > total - command.offset) {
+        close(fd);
+        throw error("ENODATA", "Offset and size are past the end");
+    }
+    return PixelData{fd, command.offset, command.size ? command.size : total - command.offset};
+}
+
+std::string decode_name(const GraphicsCommand& command) {
+    std::string name;
+    if (!base64_decode(command.payload, name) || name.empty()) {
+        throw error("EINVAL", "Bad file name");
+    }
+    return name;
+}
+
+std::string resolve(const std::string& path) { // Empty if it doesn't exist
+    char resolved[PATH_MAX];
+    return realpath(path.c_str(), resolved) ? std::string{resolved} : std::string{};
+}
+
+// t=t may only delete files marked for it right in a temporary directory, path is resolved already
+bool is_temporary_file(const std::string& path) {
+    auto slash = path.rfind('/');
+    auto parent = path.substr(0, slash);
+    if (path.find("tty-graphics-protocol", slash) == std::string::npos) {
+        return false;
+    }
+    const char* tmpdir = std::getenv("TMPDIR");
+    for (const char* dir : {"/tmp", "/dev/shm", tmpdir}) {
+        if (dir && !parent.empty() && resolve(dir) == parent) {
+            return true;
+        }
+    }
+    return false;
+}
+}
+
+PixelData::PixelData(std::string bytes) : bytes_(std::move(bytes)) {}
+
+PixelData::PixelData(int fd, size_t offset, size_t length) : fd_(fd), offset_(offset), length_(length) {}
+
+PixelData::~PixelData() {
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+}
+
+PixelData::PixelData(PixelData&& other) noexcept {
+    *this = std::move(other);
+}
+
+PixelData& PixelData::operator=(PixelData&& other) noexcept {
+    if (this == &other) {
+        return *this;
+    }
+    if (fd_ >= 0) {
+        close(fd_);
+    }
+    bytes_ = std::move(other.bytes_);
+    fd_ = std::exchange(other.fd_, -1);
+    offset_ = other.offset_;
+    length_ = other.length_;
+    return *this;
+}
+
+bool PixelData::read() {
+    if (fd_ < 0) {
+        return true;
+    }
+    bytes_.resize(length_);
+    size_t done = 0;
+    while (done < length_) {
+        auto size = pread(fd_, bytes_.data() + done, length_ - done, static_cast<off_t>(offset_ + done));
+        if (size < 0 && errno == EINTR) {
+            continue;
+        }
+        if (size <= 0) {
+            break; // Truncated or gone bad since it was checked
+        }
+        done += size;
+    }
+    close(fd_);
+    fd_ = -1;
+    if (done < length_) {
+        bytes_ = std::string{};
+        return false;
+    }
+    return true;
+}
+
+PixelData load_graphics_pixels(const GraphicsCommand& command) {
+    if (command.format == 100) {
+        throw error("EINVAL", "PNG isn't supported, send f=24 or f=32");
+    }
+    if (command.format != 24 && command.format != 32) {
+        throw error("EINVAL", "Unknown format");
+    }
+    if (command.compression) {
+        throw error("EINVAL", "Compression isn't supported");
+    }
+    if (command.width <= 0 || command.height <= 0 || command.width > max_graphics_side || command.height > max_graphics_side) {
+        throw error("EINVAL", "Bad image size");
+    }
+
+    PixelData pixels;
+    if (command.medium == 'd') {
+        std::string bytes;
+        if (!base64_decode(command.payload, bytes)) {
+            throw error("EINVAL", "Bad base64");
+        }
+        pixels = PixelData{std::move(bytes)};
+    } else if (command.medium == 'f' || command.medium == 't') {
+        auto path = resolve(decode_name(command)); // No getting around the checks with .. or symlinks
+        if (path.empty()) {
+            throw error("ENOENT", std::strerror(errno));
+        }
+        if (path.starts_with("/proc/") || path.starts_with("/sys/") || (path.starts_with("/dev/") && !path.starts_with("/dev/shm/"))) {
+            throw error("EPERM", "Not reading that");
+        }
+        if (command.medium == 't' && !is_temporary_file(path)) {
+            throw error("EPERM", "Temporary files have to be named tty-graphics-protocol and be in a temporary directory");
+        }
+        // Non-blocking, so a FIFO can't hang the UI thread before it's found out not to be a file
+        int fd = open(path.c_str(), O_RDONLY | O_NONBLOCK | O_NOFOLLOW | O_CLOEXEC);
+        if (fd < 0) {
+            throw error("ENOENT", std::strerror(errno));
+        }
+        pixels = read_later(fd, command);
+        if (command.medium == 't') {
+            unlink(path.c_str());
+        }
+    } else if (command.medium == 's') {
+        auto name = decode_name(command);
+        int fd = shm_open(name.c_str(), O_RDONLY | O_NONBLOCK, 0); // glibc hands the flags on to open()
+        if (fd < 0) {
+            throw error("ENOENT", std::strerror(errno));
+        }
+        shm_unlink(name.c_str()); // Ours now, freed once read
+        pixels = read_later(fd, command);
+    } else {
+        throw error("EINVAL", "Unknown transmission medium");
+    }
+
+    auto needed = static_cast<size_t>(command.width) * command.height * (command.format / 8);
+    if (pixels.size() < needed) {
+        throw error("ENODATA", "Insufficient image data");
+    }
+    return pixels;
+}
+
+DecodedImage convert_pixels(std::string_view bytes, int format, int width, int height) {
+    DecodedImage image;
+    image.width = width;
+    image.height = height;
+    image.pixels.resize(static_cast<size_t>(width) * height);
+    auto* src = reinterpret_cast<const uint8_t*>(bytes.data());
+    int step = format / 8;
+    for (auto& pixel : image.pixels) {
+        uint32_t alpha = step == 4 ? src[3] : 0xFF;
+        pixel = (alpha << 24) | (uint32_t{src[0]} << 16) | (uint32_t{src[1]} << 8) | src[2];
+        src += step;
+    }
+    return image;
+}
+
+std::string graphics_reply(const GraphicsCommand& command, std::string_view message) {
+    bool ok = message == "OK";
+    if ((!command.id && !command.number) || command.quiet >= 2 || (ok && command.quiet == 1)) {
+        return {};
+    }
+    std::string reply = "\x1b_Gi=" + std::to_string(command.id);
+    if (command.number) {
+        reply += ",I=" + std::to_string(command.number);
+    }
+    if (command.placement_id) {
+        reply += ",p=" + std::to_string(command.placement_id);
+    }
+    reply += ';';
+    reply += message;
+    reply += "\x1b\\";
+    return reply;
+}
+
+bool base64_decode(std::string_view text, std::string& out) {
+    static const auto table = [] {
+        std::array<int8_t, 256> values;
+        values.fill(-1);
+        constexpr std::string_view alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        for (size_t i = 0; i < alphabet.size(); ++i) {
+            values[static_cast<unsigned char>(alphabet[i])] = static_cast<int8_t>(i);
+        }
+        return values;
+    }();
+    out.clear();
+    out.reserve(text.size() / 4 * 3 + 3);
+    uint32_t bits = 0;
+    int count = 0;
+    for (char c : text) {
+        if (c == '=') {
+            break;
+        }
+        auto value = table[static_cast<unsigned char>(c)];
+        if (value < 0) {
+            return false;
+        }
+        bits = (bits << 6) | static_cast<uint32_t>(value);
+        if (++count == 4) {
+            out.push_back(static_cast<char>(bits >> 16));
+            out.push_back(static_cast<char>(bits >> 8));
+            out.push_back(static_cast<char>(bits));
+            bits = 0;
+            count = 0;
+        }
+    }
+    if (count == 2) {
+        out.push_back(static_cast<char>(bits >> 4));
+    } else if (count == 3) {
+        out.push_back(static_cast<char>(bits >> 10));
+        out.push_back(static_cast<char>(bits >> 2));
+    }
+    return count != 1;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include "Sixel.hpp"
+#include "TermCommand.hpp"
+
+// Pixels an application hands over with the kitty graphics protocol. Files and shared memory are opened and checked when
+// the command comes in, but only read on the decoder thread with pread(): the application still owns them and may truncate
+// them any time, a short read then just fails the image (a mapping would take the whole process down with SIGBUS)
+class PixelData {
+public:
+    PixelData() = default;
+    explicit PixelData(std::string bytes);
+    PixelData(int fd, size_t offset, size_t length); // Takes over fd
+    ~PixelData();
+    PixelData(PixelData&& other) noexcept;
+    PixelData& operator=(PixelData&& other) noexcept;
+
+    bool read(); // Reads the part of the file in and closes it, false if it got shorter meanwhile
+    size_t size() const { return fd_ >= 0 ? length_ : bytes_.size(); }
+    std::string_view bytes() const { return bytes_; } // Empty before read() for files
+
+private:
+    std::string bytes_;
+    int fd_{-1};
+    size_t offset_{0};
+    size_t length_{0};
+};
+
+constexpr int max_graphics_side = 10000; // Pixels, what kitty itself accepts
+
+// Pixels of a transmit command (a=t, T or q), read from the payload, a file (t=f, t=t) or shared memory (t=s).
+// Temporary files and shared memory are unlinked once opened. Throws std::runtime_error with the protocol error, e.g. "ENOENT:..."
+PixelData load_graphics_pixels(const GraphicsCommand& command);
+// RGB (f=24) or RGBA (f=32) bytes to the ARGB of DecodedImage
+DecodedImage convert_pixels(std::string_view bytes, int format, int width, int height);
+// "ESC _ G i=...;message ESC \" for the application, empty if it has no id or asked to be quiet
+std::string graphics_reply(const GraphicsCommand& command, std::string_view message);
+bool base64_decode(std::string_view text, std::string& out); // false on characters outside the alphabet
@@ -0,0 +1,112 @@
+#include "LatencyTracker.hpp"
+#include <algorithm>
+
+namespace {
+constexpr size_t recent_capacity = 1024;
+constexpr auto input_timeout = std::chrono::seconds{1}; // Input that got no answer (password prompt, ignored key) stops being tracked
+constexpr auto min_echo_wait = std::chrono::milliseconds{1};
+constexpr auto max_echo_wait = std::chrono::milliseconds{8};
+constexpr auto default_echo_wait = std::chrono::milliseconds{4};
+}
+
+void LatencyTracker::reset_pending() {
+    input_at_.reset();
+    output_at_.reset();
+}
+
+void LatencyTracker::on_input(Clock::time_point time) {
+    if (input_at_ && time - *input_at_ > input_timeout) {
+        reset_pending();
+    }
+    if (!input_at_) {
+        input_at_ = time;
+    }
+}
+
+void LatencyTracker::on_output(Clock::time_point time) {
+    if (!input_at_ || output_at_) {
+        return;
+    }
+    output_at_ = time;
+    auto delay = time - *input_at_;
+    echo_delay_ = echo_delay_ ? (*echo_delay_ * 7 + delay) / 8 : delay;
+}
+
+void LatencyTracker::on_present(Clock::time_point time) {
+    if (!input_at_) {
+        return;
+    }
+    if (output_at_) {
+        add_sample(std::chrono::duration<double, std::milli>(time - *input_at_).count());
+        reset_pending();
+    } else if (time - *input_at_ > input_timeout) {
+        reset_pending();
+    }
+}
+
+bool LatencyTracker::waiting_for_echo(Clock::time_point now) const {
+    return input_at_ && !output_at_ && now < echo_deadline();
+}
+
+bool LatencyTracker::echo_ready() const {
+    return input_at_ && output_at_;
+}
+
+LatencyTracker::Clock::time_point LatencyTracker::echo_deadline() const {
+    return input_at_.value_or(Clock::time_point{}) + echo_wait();
+}
+
+LatencyTracker::Clock::duration LatencyTracker::echo_wait() const {
+    if (!echo_delay_) {
+        return default_echo_wait;
+    }
+    return std::clamp<Clock::duration>(*echo_delay_ * 2, min_echo_wait, max_echo_wait);
+}
+
+void LatencyTracker::add_sample(double ms) {
+    size_t bucket = 0;
+    while (ms > buckets_ms[bucket]) {
+        ++bucket;
+    }
+    ++histogram_[bucket];
+    ++samples_;
+    sum_ms_ += ms;
+    max_ms_ = std::max(max_ms_, ms);
+
+    if (recent_ms_.size() < recent_capacity) {
+        recent_ms_.push_back(ms);
+    } else {
+        recent_ms_[next_recent_] = ms;
+        next_recent_ = (next_recent_ + 1) % recent_capacity;
+    }
+}
+
+double LatencyTracker::percentile(double p) const {
+    if (recent_ms_.empty()) {
+        return 0;
+    }
+    auto sorted = recent_ms_;
+    auto nth = sorted.begin() + static_cast<size_t>(p * (sorted.size() - 1));
+    std::nth_element(sorted.begin(), nth, sorted.end());
+    return *nth;
+}
+
+void LatencyTracker::write_json(std::ostream& out) const {
+    out << "{\"samples\": " << samples_
+        << ", \"avg_ms\": " << (samples_ ? sum_ms_ / samples_ : 0.0)
+        << ", \"p50_ms\": " << percentile(0.5)
+        << ", \"p99_ms\": " << percentile(0.99)
+        << ", \"max_ms\": " << max_ms_
+        << ", \"echo_wait_ms\": " << std::chrono::duration<double, std::milli>(echo_wait()).count()
+        << ", \"histogram\": {";
+    for (size_t i = 0; i < histogram_.size(); ++i) {
+        out << (i ? ", " : "") << "\"";
+        if (i + 1 < histogram_.size()) {
+            out << "<" << buckets_ms[i];
+        } else {
+            out << ">" << buckets_ms[i - 1];
+        }
+        out << "\": " << histogram_[i];
+    }
+    out << "}}";
+}
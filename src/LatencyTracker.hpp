@@ -0,0 +1,48 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <vector>
+
+// Keypress-to-photon latency: time from writing input to the pty until the first frame presented after the pty answered.
+// Only one input is tracked at a time, keys typed before the echo shows up are covered by the first one
+class LatencyTracker {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Upper bounds of the histogram buckets in ms, the last one catches everything
+    static constexpr std::array<double, 8> buckets_ms{1.0, 2.0, 4.0, 8.0, 16.0, 32.0, 64.0, 1e9};
+
+    void on_input(Clock::time_point time);
+    void on_output(Clock::time_point time);
+    void on_present(Clock::time_point time);
+
+    // Input was sent and the echo is likely to come soon, presenting now would show a stale frame
+    bool waiting_for_echo(Clock::time_point now) const;
+    bool echo_ready() const; // Echo arrived but isn't on screen yet
+    Clock::time_point echo_deadline() const; // Only meaningful while waiting_for_echo
+    Clock::duration echo_wait() const; // About twice the usual echo delay, clamped to a few ms
+
+    const std::array<uint32_t, buckets_ms.size()>& get_histogram() const { return histogram_; }
+    uint64_t get_samples() const { return samples_; }
+    double get_max_ms() const { return max_ms_; }
+    double percentile(double p) const; // Over the recent samples, p in 0..1
+    void write_json(std::ostream& out) const;
+
+private:
+    std::optional<Clock::time_point> input_at_;
+    std::optional<Clock::time_point> output_at_;
+    std::optional<Clock::duration> echo_delay_; // Moving average of input -> first output
+
+    std::array<uint32_t, buckets_ms.size()> histogram_{};
+    std::vector<double> recent_ms_; // Ring of the last recent_capacity samples
+    size_t next_recent_{0};
+    uint64_t samples_{0};
+    double sum_ms_{0};
+    double max_ms_{0};
+
+    void add_sample(double ms);
+    void reset_pending();
+};
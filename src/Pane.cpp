@@ -0,0 +1,375 @@
+#include "Pane.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <poll.h>
+#include <pty.h>
+#include <stdexcept>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+#include "Trace.hpp"
+
+Pane::Pane(int width, int height, std::pair<int, int> cell_size, int pty_fd)
+    : master_fd_(pty_fd), buffer_(width, height, cell_size.first, cell_size.second) {
+    update_winsize();
+}
+
+Pane::~Pane() {
+    if (master_fd_ >= 0) {
+        close(master_fd_); // The shell gets SIGHUP
+    }
+}
+
+int Pane::spawn_shell() {
+    char slave_name[128];
+    winsize ws{};
+    ws.ws_col = 80; // Until the pane knows better
+    ws.ws_row = 24;
+    int master_fd = -1;
+    int slave_id = forkpty(&master_fd, slave_name, NULL, &ws);
+
+    if (slave_id < 0) {
+        throw std::runtime_error("Could not fork properly");
+    } else if (slave_id == 0) {
+        execl("/bin/bash", "-", NULL);
+        std::cerr << "Execl didn't work: " << std::strerror(errno) << std::endl;
+        _exit(127); // Never unwind into the parent's code in the child
+    }
+
+    fcntl(master_fd, F_SETFD, FD_CLOEXEC); // Shells of other panes mustn't inherit it
+    fcntl(master_fd, F_SETFL, fcntl(master_fd, F_GETFL) | O_NONBLOCK);
+    int slave_fd = open(slave_name, O_RDONLY | O_CLOEXEC);
+    if (slave_fd < 0) {
+        close(master_fd);
+        throw std::runtime_error("Failed to open slave pty");
+    }
+
+    termios term_attribs;
+    bool configured = tcgetattr(slave_fd, &term_attribs) == 0;
+    term_attribs.c_lflag |= IUTF8;
+    configured = configured && tcsetattr(slave_fd, TCSANOW, &term_attribs) == 0;
+    close(slave_fd); // Only the shell keeps the slave open, so the master gets POLLHUP when it exits
+    if (!configured) {
+        close(master_fd);
+        throw std::runtime_error("Failed to set terminal attributes");
+    }
+    return master_fd;
+}
+
+short Pane::pty_events() const {
+    // No POLLIN while the ring is full, the pty would stay readable and poll() would spin until parsing makes room
+    short events = pending_output_.free_space() ? POLLIN : 0;
+    return pty_writer_.pending() ? events | POLLOUT : events;
+}
+
+ssize_t Pane::read_pty(SessionRecorder* recorder) {
+    TRACE_SCOPE("pty_read");
+    ssize_t total = 0;
+    ssize_t rd_size;
+    // Straight into the ring. Once it's full the rest waits in the pty so a flood can't grow memory without bound
+    while ((rd_size = pending_output_.read_from(master_fd_)) > 0) {
+        total += rd_size;
+        if (recorder) {
+            auto [cols, rows] = buffer_.get_screen_size();
+            recorder->record_resize(cols, rows); // Output after a resize was written for the new size
+            auto pending = pending_output_.readable();
+            recorder->record(pending.substr(pending.size() - rd_size));
+        }
+    }
+    new_output_ = new_output_ || total > 0;
+    return total;
+}
+
+size_t Pane::append_output(std::string_view bytes) {
+    auto appended = pending_output_.append(bytes);
+    new_output_ = new_output_ || appended > 0;
+    return appended;
+}
+
+bool Pane::flush_writes() {
+    return master_fd_ < 0 || pty_writer_.flush(master_fd_);
+}
+
+void Pane::write(std::string_view data) {
+    pty_writer_.push(data);
+    if (!flush_writes()) { // Keys go out right away unless a paste is still queued
+        std::cerr << "Could not write to pty: " << std::strerror(errno) << std::endl;
+    }
+}
+
+void Pane::paste(std::string_view text) {
+    pty_writer_.push_paste(text, buffer_.is_bracketed_paste());
+    if (!flush_writes()) {
+        std::cerr << "Could not write to pty: " << std::strerror(errno) << std::endl;
+    }
+}
+
+void Pane::process_output(Clock::duration budget) {
+    constexpr size_t slice_size = 256 * 1024; // Budget is checked between slices
+    auto parse_start = Clock::now();
+    auto [cols, rows] = buffer_.get_screen_size();
+    std::string_view pending = pending_output_.readable();
+    size_t offset = 0;
+    new_output_ = false;
+    backlog_ = false;
+    collect_images();
+    // Backlog is bigger than a screen, let the parser skip lines that would scroll out unseen. Planned over all of it,
+    // a slice alone rarely has more lines than the scrollback keeps
+    bool big = pending.size() > static_cast<size_t>(cols * rows);
+    parser_.fast_forward(big ? parser_.plan_fast_forward(pending, buffer_.get_max_lines()) : 0);
+    while (offset < pending.size()) {
+        auto slice = pending.substr(offset, slice_size);
+        auto consumed = parser_.parse(slice, commands_);
+        if (!commands_.empty()) {
+            feed_images();
+            buffer_.apply(commands_);
+            if (commands_.title) {
+                title_ = std::move(commands_.title);
+            }
+            damaged_ = true;
+        }
+        commands_.clear();
+        offset += consumed;
+        if (parser_.stopped_at_frame_end()) {
+            backlog_ = offset < pending.size(); // Synchronized frame is complete, let it be presented first
+            break;
+        }
+        if (consumed == 0 || (consumed < slice.size() && offset + slice.size() - consumed == pending.size())) {
+            break; // What's left is a cut sequence waiting for more bytes
+        }
+        if (offset < pending.size() && Clock::now() - parse_start >= budget) {
+            backlog_ = true; // Let a frame out, continue on the next iteration
+            break;
+        }
+    }
+    pending_output_.consume(offset);
+    release_dropped_images();
+    if (!buffer_.is_synchronized_output()) {
+        sync_since_.reset();
+    } else if (!sync_since_) {
+        sync_since_ = Clock::now();
+    }
+}
+
+bool Pane::holds_frame(Clock::time_point now) const {
+    return sync_since_ && now - *sync_since_ < sync_timeout;
+}
+
+void Pane::feed_images() {
+    for (const auto& command : commands_.commands) {
+        if (command.type == CommandType::SIXEL_BEGIN) {
+            receiving_image_ = command.a;
+            decoder_.begin(receiving_image_, command.b != 0);
+        } else if (command.type == CommandType::SIXEL_DATA) {
+            decoder_.feed(receiving_image_, commands_.graphics_of(command)); // The image may have begun a slice or a read earlier
+        } else if (command.type == CommandType::SIXEL_END) {
+            decoder_.end(command.a);
+            receiving_image_ = 0;
+        } else if (command.type == CommandType::GRAPHICS) {
+            handle_graphics(commands_.graphics_commands[command.a]);
+        }
+    }
+}
+
+void Pane::handle_graphics(GraphicsCommand& command) {
+    if (kitty_upload_) { // Later chunks only carry m= and the next piece of the payload
+        kitty_upload_->payload += command.payload;
+        bool more = command.more;
+        command = GraphicsCommand{}; // Nothing for the grid until the last chunk
+        if (kitty_upload_->payload.size() > max_image_bytes) {
+            reply(*kitty_upload_, "EFBIG:Image too big");
+            kitty_upload_.reset();
+            return;
+        }
+        if (more) {
+            return;
+        }
+        command = std::move(*kitty_upload_);
+        kitty_upload_.reset();
+    } else if (command.more && command.medium == 'd' && command.image) {
+        kitty_upload_ = std::move(command);
+        command = GraphicsCommand{};
+        return;
+    }
+
+    if (command.image) { // a=t, T or q
+        transmit_image(command);
+    } else if (command.action == 'p') {
+        const auto* image = find_kitty_image(command);
+        if (!image) {
+            reply(command, "ENOENT:No such image");
+            return;
+        }
+        command.place = image->image;
+        command.width = image->width;
+        command.height = image->height;
+        reply(command, "OK");
+    } else if (command.action == 'd') {
+        // Uppercase frees the pixels too. Deleting by cell, cursor or z-index isn't supported
+        bool free_pixels = std::isupper(static_cast<unsigned char>(command.what));
+        auto what = std::tolower(static_cast<unsigned char>(command.what));
+        if (what == 'a') {
+            command.drop_all = true;
+            while (free_pixels && !kitty_images_.empty()) {
+                forget_kitty_image(kitty_images_.begin()->first);
+            }
+        } else if (what == 'i' || what == 'n') {
+            if (const auto* image = find_kitty_image(command)) {
+                command.drop = image->image;
+                if (free_pixels) {
+                    forget_kitty_image(command.id ? command.id : kitty_numbers_[command.number]);
+                }
+            }
+        }
+    }
+}
+
+void Pane::transmit_image(GraphicsCommand& command) {
+    PixelData pixels;
+    try {
+        pixels = load_graphics_pixels(command); // Mapped, the conversion reads it on the decoder thread
+    } catch (const std::runtime_error& error) {
+        reply(command, error.what());
+        return;
+    }
+    if (command.action == 'q') {
+        reply(command, "OK"); // Only checked, nothing is kept
+        return;
+    }
+    if (command.id || command.number) {
+        if (!command.id) {
+            command.id = command.image; // Picked for the application, the reply tells it
+        }
+        if (kitty_images_.contains(command.id)) { // Replaced, along with where it's shown
+            command.drop = kitty_images_[command.id].image;
+            forget_kitty_image(command.id);
+        }
+        kitty_images_[command.id] = KittyImage{command.image, command.width, command.height};
+        if (command.number) {
+            kitty_numbers_[command.number] = command.id;
+        }
+    }
+    decoder_.convert(command.image, std::move(pixels), command.format, command.width, command.height);
+    reply(command, "OK");
+    if (command.action == 'T') {
+        command.place = command.image;
+    }
+}
+
+void Pane::reply(const GraphicsCommand& command, std::string_view message) {
+    auto response = graphics_reply(command, message);
+    if (!response.empty()) {
+        write(response);
+    }
+}
+
+const Pane::KittyImage* Pane::find_kitty_image(const GraphicsCommand& command) const {
+    auto id = command.id;
+    if (!id) {
+        auto number = kitty_numbers_.find(command.number);
+        id = number != kitty_numbers_.end() ? number->second : 0;
+    }
+    auto iter = kitty_images_.find(id);
+    return iter != kitty_images_.end() ? &iter->second : nullptr;
+}
+
+void Pane::forget_kitty_image(uint32_t id) {
+    auto iter = kitty_images_.find(id);
+    if (iter == kitty_images_.end()) {
+        return;
+    }
+    free_image(iter->second.image);
+    kitty_images_.erase(iter);
+    std::erase_if(kitty_numbers_, [id](const auto& number) { return number.second == id; });
+}
+
+bool Pane::is_kitty_image(uint32_t image) const {
+    return std::any_of(kitty_images_.begin(), kitty_images_.end(), [image](const auto& entry) { return entry.second.image == image; });
+}
+
+bool Pane::evict_unplaced_kitty_image() {
+    const auto& placed = buffer_.get_images();
+    uint32_t oldest = 0, oldest_image = 0;
+    for (const auto& [id, image] : kitty_images_) {
+        bool shown = std::any_of(placed.begin(), placed.end(), [&](const ImagePlacement& placement) { return placement.image == image.image; });
+        if (!shown && images_.contains(image.image) && (!oldest || image.image < oldest_image)) {
+            oldest = id;
+            oldest_image = image.image; // Ids only grow, the smallest is the oldest
+        }
+    }
+    if (!oldest) {
+        return false;
+    }
+    forget_kitty_image(oldest);
+    return true;
+}
+
+void Pane::free_image(uint32_t image) {
+    if (auto iter = images_.find(image); iter != images_.end()) {
+        image_bytes_ -= iter->second.bytes();
+        images_.erase(iter);
+        damaged_ = true;
+    }
+}
+
+void Pane::release_dropped_images() {
+    for (auto id : buffer_.take_dropped_images()) {
+        if (!is_kitty_image(id)) { // Those stay for the next placement
+            free_image(id);
+        }
+    }
+}
+
+void Pane::collect_images() {
+    if (images_fd() < 0) {
+        return;
+    }
+    for (auto& [id, image] : decoder_.take_decoded()) {
+        const auto& placed = buffer_.get_images();
+        bool placed_or_kept = is_kitty_image(id) || std::any_of(placed.begin(), placed.end(), [id](const ImagePlacement& placement) { return placement.image == id; });
+        if (image.pixels.empty() || !placed_or_kept) {
+            continue; // Scrolled out or deleted before it was done
+        }
+        image_bytes_ += image.bytes();
+        images_[id] = std::move(image);
+        damaged_ = true;
+    }
+    // Images nothing shows go first, then the oldest placements
+    while (image_bytes_ > max_image_bytes && (evict_unplaced_kitty_image() || buffer_.drop_oldest_image())) {
+        release_dropped_images();
+    }
+}
+
+const DecodedImage* Pane::image(uint32_t id) const {
+    auto iter = images_.find(id);
+    return iter != images_.end() ? &iter->second : nullptr;
+}
+
+bool Pane::take_damage() {
+    return std::exchange(damaged_, false);
+}
+
+std::optional<std::string> Pane::take_title() {
+    return std::exchange(title_, std::nullopt);
+}
+
+void Pane::resize(int width, int height, std::pair<int, int> cell_size) {
+    buffer_.resize({width, height}, cell_size);
+    damaged_ = true;
+    update_winsize();
+}
+
+void Pane::update_winsize() {
+    if (master_fd_ < 0) {
+        return;
+    }
+    auto [cols, rows] = buffer_.get_screen_size();
+    winsize ws{};
+    ws.ws_col = cols;
+    ws.ws_row = rows;
+    ioctl(master_fd_, TIOCSWINSZ, &ws); // The shell gets SIGWINCH
+}
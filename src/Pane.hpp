@@ -0,0 +1,113 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+#include <unordered_map>
+#include <utility>
+#include "ANSIParser.hpp"
+#include "Buffer.hpp"
+#include "ImageDecoder.hpp"
+#include "PtyWriter.hpp"
+#include "RingBuffer.hpp"
+#include "SessionRecording.hpp"
+#include "TermCommand.hpp"
+
+// One terminal of a window: a shell on its own pty, the parser and grid its output goes into and the input queued for it.
+// Output is read into the ring when the pty is readable and parsed in slices by process_output(), so a busy pane
+// can't hold up the others. A pane that got nothing since the last frame isn't touched at all.
+// Sixel images are decoded on a worker thread, the grid reserves their rows right away and the pixels show up once ready.
+// Kitty graphics are read from files or shared memory the application names, so their pixels never go through the pty
+class Pane {
+public:
+    using Clock = std::chrono::steady_clock;
+    static constexpr size_t max_pending_output = 4 * 1024 * 1024;
+    static constexpr size_t max_image_bytes = 256 * 1024 * 1024; // Decoded pixels kept, the oldest images go first
+    static constexpr auto sync_timeout = std::chrono::milliseconds{150}; // A crashed or stopped TUI must not freeze the pane
+
+    // Size in pixels, like TermBuffer. Takes over pty_fd, the master side of spawn_shell().
+    // Without a shell (replays, tests) output comes in through append_output()
+    Pane(int width, int height, std::pair<int, int> cell_size, int pty_fd = -1);
+    ~Pane();
+    Pane(const Pane&) = delete;
+    Pane& operator=(const Pane&) = delete;
+
+    // Pty
+    int pty_fd() const { return master_fd_; }
+    short pty_events() const; // What to poll pty_fd for
+    ssize_t read_pty(SessionRecorder* recorder = nullptr); // Reads what fits into the ring, total bytes read
+    bool flush_writes(); // false on a write error, the queued input is dropped then
+    void write(std::string_view data);
+    void paste(std::string_view text); // Bracketed if the application asked for it
+    size_t append_output(std::string_view bytes); // As if read from the pty, returns how much fit
+    // The shell is gone. The pty isn't polled anymore, but what it still holds is read and parsed before the pane closes
+    void hang_up() { hung_up_ = true; }
+    bool hung_up() const { return hung_up_; }
+
+    // Parsing
+    bool has_output() const { return new_output_ || backlog_; }
+    bool has_backlog() const { return backlog_; } // Parsing stopped on the budget with more to go
+    void process_output(Clock::duration budget = Clock::duration::max());
+    bool take_damage(); // The grid changed since the last call
+    // In a synchronized update (mode 2026): its slots keep the last frame until the update ends or runs past sync_timeout
+    bool holds_frame(Clock::time_point now) const;
+    std::optional<std::string> take_title(); // Set by the application since the last call
+
+    void resize(int width, int height, std::pair<int, int> cell_size); // Grid and pty window size
+
+    // Images
+    int images_fd() const { return decoder_.event_fd(); } // Readable when decoded images are waiting, -1 before the first one
+    void on_images_ready() { new_output_ = true; } // Picked up by the next process_output()
+    const DecodedImage* image(uint32_t id) const; // nullptr while it's being decoded
+
+    // Forks a shell on a new pty and returns the master fd. Meant to be called as early as possible, the shell
+    // starts up while the window is created and gets its real size once it has a pane
+    static int spawn_shell();
+
+    TermBuffer& buffer() { return buffer_; }
+    const TermBuffer& buffer() const { return buffer_; }
+
+private:
+    int master_fd_{-1};
+    TermBuffer buffer_;
+    AnsiParser parser_;
+    CommandBuffer commands_; // Reused for every slice
+    RingBuffer pending_output_{max_pending_output}; // Read from the pty but not parsed yet, e.g. a cut escape sequence
+    PtyWriter pty_writer_; // Input waiting for the pty to take it
+    std::optional<std::string> title_;
+    bool new_output_{false}; // Read since the last process_output()
+    bool backlog_{false};
+    bool hung_up_{false};
+    std::optional<Clock::time_point> sync_since_; // Start of the synchronized update in progress
+    bool damaged_{true};
+    ImageDecoder decoder_;
+    std::unordered_map<uint32_t, DecodedImage> images_; // Of buffer_.get_images()
+    size_t image_bytes_{0};
+    uint32_t receiving_image_{0}; // Sixel whose data is coming in
+
+    // Kitty graphics protocol. Transmitted images stay until deleted or evicted, even without placements
+    struct KittyImage {
+        uint32_t image; // Id of the pixels in images_
+        int width;
+        int height;
+    };
+    std::unordered_map<uint32_t, KittyImage> kitty_images_; // By the id the application gave
+    std::unordered_map<uint32_t, uint32_t> kitty_numbers_; // I= image numbers to ids
+    std::optional<GraphicsCommand> kitty_upload_; // Direct transmission split into chunks (m=1), payload so far
+
+    void update_winsize();
+    void feed_images(); // Sixel data of commands_ to the decoder
+    void collect_images();
+    void release_dropped_images(); // Pixels of images the grid dropped
+    void handle_graphics(GraphicsCommand& command); // Loads, replies and fills in what the grid should do
+    void transmit_image(GraphicsCommand& command);
+    void reply(const GraphicsCommand& command, std::string_view message); // Through the input queue, if the application wants it
+    const KittyImage* find_kitty_image(const GraphicsCommand& command) const; // By i= or I=
+    void forget_kitty_image(uint32_t id); // Pixels and all
+    bool is_kitty_image(uint32_t image) const;
+    bool evict_unplaced_kitty_image(); // Oldest one not on the grid, false if there is none
+    void free_image(uint32_t image);
+};
@@ -0,0 +1,105 @@
+#include "PaneLayout.hpp"
+#include <stdexcept>
+#include <string>
+
+PaneLayout::PaneLayout(int root_pane) : root_(std::make_unique<Node>()) {
+    root_->pane = root_pane;
+}
+
+PaneLayout::~PaneLayout() = default;
+
+PaneLayout::Node* PaneLayout::find(Node* node, int pane) const {
+    if (!node) {
+        return nullptr;
+    }
+    if (node->pane >= 0) {
+        return node->pane == pane ? node : nullptr;
+    }
+    if (auto* found = find(node->first.get(), pane)) {
+        return found;
+    }
+    return find(node->second.get(), pane);
+}
+
+void PaneLayout::split(int pane, int new_pane, Split direction) {
+    auto* leaf = find(root_.get(), pane);
+    if (!leaf) {
+        throw std::runtime_error("No pane " + std::to_string(pane) + " to split");
+    }
+    // The leaf becomes the split, the old pane moves one level down
+    leaf->first = std::make_unique<Node>();
+    leaf->first->pane = pane;
+    leaf->first->parent = leaf;
+    leaf->second = std::make_unique<Node>();
+    leaf->second->pane = new_pane;
+    leaf->second->parent = leaf;
+    leaf->pane = -1;
+    leaf->direction = direction;
+    ++panes_;
+}
+
+int PaneLayout::remove(int pane) {
+    auto* leaf = find(root_.get(), pane);
+    if (!leaf || !leaf->parent) {
+        return -1; // The last pane stays, closing it closes the window
+    }
+    auto* parent = leaf->parent;
+    auto sibling = std::move(parent->first.get() == leaf ? parent->second : parent->first);
+    // The sibling's content replaces the parent, so its children keep their own parent pointers
+    parent->pane = sibling->pane;
+    parent->direction = sibling->direction;
+    parent->first = std::move(sibling->first);
+    parent->second = std::move(sibling->second);
+    if (parent->first) {
+        parent->first->parent = parent;
+        parent->second->parent = parent;
+    }
+    --panes_;
+
+    auto* next = parent;
+    while (next->pane < 0) {
+        next = next->first.get();
+    }
+    return next->pane;
+}
+
+void PaneLayout::walk(const Node* node, PaneRect area, int gap, std::vector<std::pair<int, PaneRect>>* panes, std::vector<PaneRect>* dividers) const {
+    if (node->pane >= 0) {
+        if (panes) {
+            panes->emplace_back(node->pane, area);
+        }
+        return;
+    }
+    PaneRect first = area, second = area, divider = area;
+    if (node->direction == Split::SideBySide) {
+        first.w = (area.w - gap) / 2;
+        divider.x = area.x + first.w;
+        divider.w = gap;
+        second.x = divider.x + gap;
+        second.w = area.w - first.w - gap;
+    } else {
+        first.h = (area.h - gap) / 2;
+        divider.y = area.y + first.h;
+        divider.h = gap;
+        second.y = divider.y + gap;
+        second.h = area.h - first.h - gap;
+    }
+    if (dividers) {
+        dividers->push_back(divider);
+    }
+    walk(node->first.get(), first, gap, panes, dividers);
+    walk(node->second.get(), second, gap, panes, dividers);
+}
+
+std::vector<std::pair<int, PaneRect>> PaneLayout::layout(PaneRect area, int gap) const {
+    std::vector<std::pair<int, PaneRect>> panes;
+    panes.reserve(panes_);
+    walk(root_.get(), area, gap, &panes, nullptr);
+    return panes;
+}
+
+std::vector<PaneRect> PaneLayout::dividers(PaneRect area, int gap) const {
+    std::vector<PaneRect> result;
+    walk(root_.get(), area, gap, nullptr, &result);
+    return result;
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+struct PaneRect {
+    int x{0};
+    int y{0};
+    int w{0};
+    int h{0};
+
+    bool contains(int px, int py) const {
+        return px >= x && px < x + w && py >= y && py < y + h;
+    }
+    bool operator==(const PaneRect&) const = default;
+};
+
+// Binary split tree of the panes of a window. Leaves are pane ids, inner nodes split their area in two.
+// Only geometry lives here, the panes themselves are owned by the window
+class PaneLayout {
+public:
+    enum class Split {
+        SideBySide, // New pane to the right
+        Stacked, // New pane below
+    };
+
+    explicit PaneLayout(int root_pane);
+    ~PaneLayout();
+
+    // pane gives half of its area to new_pane. Throws if pane isn't in the layout
+    void split(int pane, int new_pane, Split direction);
+    // The sibling of pane takes its area. Returns a pane of that sibling to move focus to, -1 if pane was the last one or unknown
+    int remove(int pane);
+
+    // Area of every pane in tree order (left to right, top to bottom), gap pixels are left between neighbours
+    std::vector<std::pair<int, PaneRect>> layout(PaneRect area, int gap = 1) const;
+    std::vector<PaneRect> dividers(PaneRect area, int gap = 1) const; // The gaps, to draw separators into
+    size_t size() const { return panes_; }
+
+private:
+    struct Node {
+        int pane{-1}; // Leaf if >= 0
+        Split direction{Split::SideBySide};
+        std::unique_ptr<Node> first;
+        std::unique_ptr<Node> second;
+        Node* parent{nullptr};
+    };
+    std::unique_ptr<Node> root_;
+    size_t panes_{1};
+
+    Node* find(Node* node, int pane) const;
+    void walk(const Node* node, PaneRect area, int gap, std::vector<std::pair<int, PaneRect>>* panes, std::vector<PaneRect>* dividers) const;
+};
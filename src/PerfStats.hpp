@@ -0,0 +1,83 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// Counters behind the performance HUD. Only plain adds and a clock read per frame, so they stay on all the time
+class PerfStats {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // Upper bounds of the frame time histogram buckets in ms, the last one catches everything
+    static constexpr std::array<double, 7> frame_buckets_ms{2.0, 4.0, 8.0, 16.7, 33.3, 66.7, 1e9};
+
+    void add_pty_bytes(size_t n) {
+        bytes_in_window_ += n;
+        total_bytes_ += n;
+    }
+    void add_parse_time(Clock::duration duration) {
+        parse_since_frame_ += duration;
+    }
+    void add_frame(Clock::duration frame_time, size_t cells_drawn) {
+        auto ms = std::chrono::duration<double, std::milli>(frame_time).count();
+        size_t bucket = 0;
+        while (ms > frame_buckets_ms[bucket]) {
+            ++bucket;
+        }
+        ++frame_histogram_[bucket];
+        last_frame_ms_ = ms;
+        max_frame_ms_in_window_ = std::max(max_frame_ms_in_window_, ms);
+        last_parse_ms_ = std::chrono::duration<double, std::milli>(parse_since_frame_).count();
+        parse_since_frame_ = {};
+        cells_drawn_ = cells_drawn;
+        ++frames_in_window_;
+        update_rates();
+    }
+    void reset_histogram() {
+        frame_histogram_ = {};
+    }
+
+    // Rates are recomputed about once a second
+    void update_rates() {
+        auto now = Clock::now();
+        auto elapsed = std::chrono::duration<double>(now - window_start_).count();
+        if (elapsed < 1.0) {
+            return;
+        }
+        bytes_per_second_ = bytes_in_window_ / elapsed;
+        fps_ = frames_in_window_ / elapsed;
+        max_frame_ms_ = max_frame_ms_in_window_;
+        bytes_in_window_ = 0;
+        frames_in_window_ = 0;
+        max_frame_ms_in_window_ = 0;
+        window_start_ = now;
+    }
+
+    const std::array<uint32_t, frame_buckets_ms.size()>& get_frame_histogram() const { return frame_histogram_; }
+    double get_last_frame_ms() const { return last_frame_ms_; }
+    double get_max_frame_ms() const { return max_frame_ms_; } // Worst frame of the last second
+    double get_last_parse_ms() const { return last_parse_ms_; } // Parsing done for the last frame
+    double get_bytes_per_second() const { return bytes_per_second_; }
+    double get_fps() const { return fps_; }
+    size_t get_cells_drawn() const { return cells_drawn_; }
+    uint64_t get_total_bytes() const { return total_bytes_; }
+
+private:
+    std::array<uint32_t, frame_buckets_ms.size()> frame_histogram_{};
+    double last_frame_ms_{0};
+    double max_frame_ms_{0};
+    double last_parse_ms_{0};
+    size_t cells_drawn_{0};
+    uint64_t total_bytes_{0};
+    Clock::duration parse_since_frame_{};
+
+    // Current one second window
+    Clock::time_point window_start_{Clock::now()};
+    size_t bytes_in_window_{0};
+    size_t frames_in_window_{0};
+    double max_frame_ms_in_window_{0};
+    double bytes_per_second_{0};
+    double fps_{0};
+};
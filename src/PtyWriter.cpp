@@ -0,0 +1,61 @@
+#include "PtyWriter.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <unistd.h>
+
+namespace {
+constexpr std::string_view paste_start = "\033[200~";
+constexpr std::string_view paste_end = "\033[201~";
+}
+
+PtyWriter::PtyWriter(size_t max_write_per_flush) : max_write_per_flush_(std::max<size_t>(1, max_write_per_flush)) {}
+
+void PtyWriter::push(std::string_view data) {
+    queue_.append(data);
+}
+
+void PtyWriter::push_paste(std::string_view text, bool bracketed) {
+    if (!bracketed) {
+        push(text);
+        return;
+    }
+    push(paste_start);
+    // Removing a marker joins what was around it, which can make another one ("\033[20\033[201~1~"), so search again from there
+    auto start = queue_.size();
+    push(text);
+    size_t pos = start;
+    while ((pos = queue_.find(paste_end, pos)) != std::string::npos) {
+        queue_.erase(pos, paste_end.size());
+        pos = std::max(start, pos - std::min(pos, paste_end.size() - 1));
+    }
+    push(paste_end);
+}
+
+bool PtyWriter::flush(int fd) {
+    size_t budget = max_write_per_flush_;
+    while (pending() && budget > 0) {
+        size_t chunk = std::min(size(), budget);
+        ssize_t written = write(fd, queue_.data() + offset_, chunk);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break; // Pty is full, wait for POLLOUT
+            }
+            queue_.clear();
+            offset_ = 0;
+            return false;
+        }
+        offset_ += written;
+        budget -= written;
+    }
+    if (!pending()) {
+        queue_.clear();
+        offset_ = 0;
+    } else if (offset_ > queue_.size() / 2) {
+        queue_.erase(0, offset_);
+        offset_ = 0;
+    }
+    return true;
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// Input going to the pty. Everything is queued and written when the pty accepts it (POLLOUT),
+// so a huge paste into a child that isn't reading can't block the event loop, and short writes don't lose bytes.
+// Keys typed during a paste stay in order behind it
+class PtyWriter {
+public:
+    explicit PtyWriter(size_t max_write_per_flush = 64 * 1024);
+
+    void push(std::string_view data);
+    // Pasted text, wrapped in ESC[200~ ... ESC[201~ if the application enabled bracketed paste (mode 2004).
+    // An end marker inside the text is dropped so the paste can't break out of the brackets
+    void push_paste(std::string_view text, bool bracketed);
+
+    // Writes what the fd takes without blocking, at most max_write_per_flush per call so a paste is spread over loop iterations.
+    // fd has to be non-blocking. Returns false on a write error other than EAGAIN, the queue is dropped then
+    bool flush(int fd);
+
+    bool pending() const { return offset_ < queue_.size(); }
+    size_t size() const { return queue_.size() - offset_; }
+
+private:
+    std::string queue_;
+    size_t offset_{0}; // Already written part of queue_, compacted once it's most of it
+    size_t max_write_per_flush_;
+};
@@ -0,0 +1,70 @@
+#include "RingBuffer.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+RingBuffer::RingBuffer(size_t capacity) {
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    capacity_ = std::max(page, (capacity + page - 1) / page * page);
+
+    fd_ = memfd_create("kemul-ring", MFD_CLOEXEC);
+    if (fd_ < 0) {
+        throw std::runtime_error(std::string{"Could not create ring buffer memfd: "} + std::strerror(errno));
+    }
+    if (ftruncate(fd_, capacity_) != 0) {
+        close(fd_);
+        throw std::runtime_error(std::string{"Could not size ring buffer: "} + std::strerror(errno));
+    }
+    // Reserve both halves first so nothing else can land in the second one
+    void* area = mmap(nullptr, 2 * capacity_, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (area == MAP_FAILED) {
+        close(fd_);
+        throw std::runtime_error(std::string{"Could not reserve ring buffer: "} + std::strerror(errno));
+    }
+    data_ = static_cast<char*>(area);
+    for (char* half : {data_, data_ + capacity_}) {
+        if (mmap(half, capacity_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd_, 0) == MAP_FAILED) {
+            munmap(data_, 2 * capacity_);
+            close(fd_);
+            throw std::runtime_error(std::string{"Could not map ring buffer: "} + std::strerror(errno));
+        }
+    }
+}
+
+RingBuffer::~RingBuffer() {
+    munmap(data_, 2 * capacity_);
+    close(fd_);
+}
+
+ssize_t RingBuffer::read_from(int fd) {
+    auto space = writable();
+    if (space.empty()) {
+        return 0;
+    }
+    int available = 0;
+    size_t want = space.size();
+    if (ioctl(fd, FIONREAD, &available) == 0 && available > 0) {
+        want = std::min(want, static_cast<size_t>(available));
+    }
+    ssize_t size;
+    do {
+        size = read(fd, space.data(), want); // The mirror makes the free space one range, no need for a second iovec
+    } while (size < 0 && errno == EINTR);
+    if (size > 0) {
+        commit(size);
+    }
+    return size;
+}
+
+size_t RingBuffer::append(std::string_view data) {
+    auto space = writable();
+    size_t size = std::min(space.size(), data.size());
+    std::memcpy(space.data(), data.data(), size);
+    commit(size);
+    return size;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <sys/types.h>
+
+// Byte ring backed by a memfd that is mapped twice back to back, so both the readable and the writable part
+// are always one contiguous range, also across the wrap point. Pty output is read straight into it and parsed in place
+class RingBuffer {
+public:
+    explicit RingBuffer(size_t capacity); // Rounded up to whole pages, throws if the mapping can't be set up
+    ~RingBuffer();
+    RingBuffer(const RingBuffer&) = delete;
+    RingBuffer& operator=(const RingBuffer&) = delete;
+
+    std::string_view readable() const {
+        return {data_ + head_ % capacity_, size()};
+    }
+    std::span<char> writable() {
+        return {data_ + tail_ % capacity_, free_space()};
+    }
+    void commit(size_t bytes) { tail_ += bytes; } // After writing into writable()
+    void consume(size_t bytes) { head_ += bytes; } // After parsing from readable()
+
+    // Reads what the fd has (FIONREAD), as much as fits. Same return value as read(), 0 if the ring is full
+    ssize_t read_from(int fd);
+    size_t append(std::string_view data); // Copies as much as fits, returns how much that was
+
+    size_t size() const { return tail_ - head_; }
+    size_t free_space() const { return capacity_ - size(); }
+    size_t capacity() const { return capacity_; }
+    bool empty() const { return head_ == tail_; }
+
+private:
+    int fd_{-1};
+    char* data_{nullptr}; // 2 * capacity_ bytes, the second half is the same memory as the first
+    size_t capacity_;
+    uint64_t head_{0}; // Total bytes consumed
+    uint64_t tail_{0}; // Total bytes committed
+};
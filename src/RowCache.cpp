@@ -0,0 +1,63 @@
+#include "RowCache.hpp"
+#include <SDL2/SDL_pixels.h>
+
+RowCache::RowCache(size_t budget_bytes) : budget_bytes_(budget_bytes) {}
+
+RowCache::~RowCache() {
+    clear();
+}
+
+void RowCache::set_row_size(int width, int height) {
+    if (width == row_width_ && height == row_height_) {
+        return;
+    }
+    clear();
+    row_width_ = width;
+    row_height_ = height;
+    row_bytes_ = static_cast<size_t>(width) * height * 4;
+}
+
+void RowCache::clear() {
+    for (auto& [key, entry] : entries_) {
+        SDL_DestroyTexture(entry.texture);
+    }
+    entries_.clear();
+    lru_.clear();
+}
+
+SDL_Texture* RowCache::find(uint64_t key) {
+    auto iter = entries_.find(key);
+    if (iter == entries_.end()) {
+        ++misses_;
+        return nullptr;
+    }
+    ++hits_;
+    lru_.splice(lru_.begin(), lru_, iter->second.lru_pos);
+    return iter->second.texture;
+}
+
+SDL_Texture* RowCache::create(SDL_Renderer* renderer, uint64_t key) {
+    if (row_bytes_ == 0 || row_bytes_ > budget_bytes_) {
+        return nullptr;
+    }
+    SDL_Texture* texture = nullptr;
+    while (!entries_.empty() && (entries_.size() + 1) * row_bytes_ > budget_bytes_) { // Evict, reusing the last texture
+        auto oldest = entries_.find(lru_.back());
+        if (texture) {
+            SDL_DestroyTexture(texture);
+        }
+        texture = oldest->second.texture;
+        entries_.erase(oldest);
+        lru_.pop_back();
+    }
+    if (!texture) {
+        texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, row_width_, row_height_);
+        if (!texture) {
+            return nullptr;
+        }
+        SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_NONE); // Rows are opaque
+    }
+    lru_.push_front(key);
+    entries_[key] = Entry{texture, lru_.begin()};
+    return texture;
+}
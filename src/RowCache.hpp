@@ -0,0 +1,46 @@
+#pragma once
+#include <SDL2/SDL_render.h>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+
+// Rendered rows kept as textures, keyed by row_hash of their cells.
+// Unchanged rows and rows scrolled back into view are copied in one go instead of being drawn cell by cell.
+// Least recently used rows are dropped once the textures take more than the budget
+class RowCache {
+private:
+    struct Entry {
+        SDL_Texture* texture;
+        std::list<uint64_t>::iterator lru_pos;
+    };
+
+    std::unordered_map<uint64_t, Entry> entries_;
+    std::list<uint64_t> lru_; // Most recently used first
+    size_t budget_bytes_;
+    size_t row_bytes_{0}; // All rows have the same size
+    int row_width_{0};
+    int row_height_{0};
+
+    // Stats for the HUD
+    uint64_t hits_{0};
+    uint64_t misses_{0};
+
+public:
+    explicit RowCache(size_t budget_bytes);
+    ~RowCache();
+    RowCache(const RowCache&) = delete;
+    RowCache& operator=(const RowCache&) = delete;
+
+    void set_row_size(int width, int height); // Drops everything if the size changes
+    void clear(); // After the render targets were lost, or when rows would look different (font change)
+
+    SDL_Texture* find(uint64_t key); // nullptr on a miss
+    // Texture for a new row, to be drawn into by the caller. nullptr if it can't be created
+    SDL_Texture* create(SDL_Renderer* renderer, uint64_t key);
+
+    uint64_t get_hits() const { return hits_; }
+    uint64_t get_misses() const { return misses_; }
+    size_t size() const { return entries_.size(); }
+    size_t memory_usage() const { return entries_.size() * row_bytes_; }
+};
@@ -0,0 +1,64 @@
+#include "SelectionExporter.hpp"
+#include <algorithm>
+
+SelectionExporter::SelectionExporter(const std::vector<std::vector<Cell>>& buffer, std::pair<int, int> start, std::pair<int, int> end)
+    : buffer_(buffer), start_(start), end_(end) {}
+
+template <typename Emit>
+void SelectionExporter::walk(Emit&& emit) const {
+    int last_row = std::min(end_.second, static_cast<int>(buffer_.size()) - 1);
+    for (int i = std::max(start_.second, 0); i <= last_row; ++i) {
+        const auto& row = buffer_[i];
+        int x_start = i == start_.second ? start_.first : 0;
+        int x_end = i == end_.second ? end_.first : static_cast<int>(row.size()) - 1;
+        x_start = std::max(x_start, 0);
+        x_end = std::min(x_end, static_cast<int>(row.size()) - 1);
+
+        // A wrapped row continues on the next one, so nothing gets trimmed and no newline is needed
+        bool wrapped = !row.empty() && row.back().is_wrapline() && x_end == static_cast<int>(row.size()) - 1;
+        if (!wrapped) {
+            while (x_end >= x_start && (row[x_end].codepoint == 0 || row[x_end].codepoint == ' ')) {
+                --x_end;
+            }
+        }
+
+        for (auto j = x_start; j <= x_end; ++j) {
+            auto codepoint = row[j].codepoint;
+            emit(codepoint == 0 ? uint32_t{' '} : codepoint); // Holes left by cursor movement are blanks
+        }
+        if (!wrapped && i != last_row) {
+            emit(uint32_t{'\n'});
+        }
+    }
+}
+
+size_t SelectionExporter::encoded_size() const {
+    size_t size = 0;
+    walk([&size](uint32_t codepoint) { size += utf8_length(codepoint); });
+    return size;
+}
+
+std::string SelectionExporter::to_string() const {
+    std::string result;
+    result.resize(encoded_size());
+    char* out = result.data();
+    walk([&out](uint32_t codepoint) { out += encode_utf8(codepoint, out); });
+    return result;
+}
+
+void SelectionExporter::stream(const Sink& sink, size_t chunk_size) const {
+    chunk_size = std::max<size_t>(chunk_size, 4);
+    std::string chunk;
+    chunk.resize(chunk_size);
+    size_t used = 0;
+    walk([&](uint32_t codepoint) {
+        if (used + 4 > chunk_size) { // Not enough room for the longest sequence
+            sink(std::string_view{chunk.data(), used});
+            used = 0;
+        }
+        used += encode_utf8(codepoint, chunk.data() + used);
+    });
+    if (used > 0) {
+        sink(std::string_view{chunk.data(), used});
+    }
+}
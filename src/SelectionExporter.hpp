@@ -0,0 +1,32 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "Cell.hpp"
+#include "Utf8.hpp"
+
+// Turns a selected range of the grid into UTF-8 text.
+// Rows glued together by a wrapline are exported as one logical line, trailing blanks of a logical line are dropped
+class SelectionExporter {
+public:
+    using Sink = std::function<void(std::string_view)>;
+
+    // start and end are {col, row}, both inclusive, start must not be after end
+    SelectionExporter(const std::vector<std::vector<Cell>>& buffer, std::pair<int, int> start, std::pair<int, int> end);
+
+    size_t encoded_size() const; // Exact size of the exported text in bytes
+    std::string to_string() const; // Allocates once, with encoded_size() bytes
+    void stream(const Sink& sink, size_t chunk_size = 64 * 1024) const; // Feeds the text in chunks of at most chunk_size bytes
+
+private:
+    const std::vector<std::vector<Cell>>& buffer_;
+    std::pair<int, int> start_;
+    std::pair<int, int> end_;
+
+    template <typename Emit>
+    void walk(Emit&& emit) const;
+};
@@ -0,0 +1,351 @@
+#include "Server.hpp"
+#include <SDL2/SDL.h>
+#include <SDL2/SDL_ttf.h>
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "Trace.hpp"
+
+namespace {
+constexpr int idle_wait_ms = 50; // No windows, only the socket and SDL to look after
+constexpr auto client_timeout = std::chrono::milliseconds{200}; // A client that connects and says nothing is dropped
+constexpr size_t max_request_size = 64;
+
+sockaddr_un make_address(const std::filesystem::path& path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    auto text = path.string();
+    if (text.size() >= sizeof(address.sun_path)) {
+        throw std::runtime_error("Socket path is too long: " + text);
+    }
+    std::memcpy(address.sun_path, text.c_str(), text.size() + 1);
+    return address;
+}
+
+short to_poll_events(uint32_t events) {
+    short result = 0;
+    if (events & EPOLLIN) result |= POLLIN;
+    if (events & EPOLLOUT) result |= POLLOUT;
+    if (events & EPOLLHUP) result |= POLLHUP;
+    if (events & EPOLLERR) result |= POLLERR;
+    return result;
+}
+
+uint32_t to_epoll_events(short events) {
+    uint32_t result = 0;
+    if (events & POLLIN) result |= EPOLLIN;
+    if (events & POLLOUT) result |= EPOLLOUT;
+    return result;
+}
+
+// epoll data of a pty: the session it belongs to and the fd, a window has one pty per pane
+uint64_t pack_data(uint32_t session, int fd) {
+    return (uint64_t{session} << 32) | static_cast<uint32_t>(fd);
+}
+
+// Sends a one line request and reads the answer, false if nobody answered
+bool send_request(const std::filesystem::path& socket_path, std::string_view request, std::string& answer) {
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return false;
+    }
+    auto address = make_address(socket_path);
+    if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        close(fd);
+        return false;
+    }
+    bool sent = write(fd, request.data(), request.size()) == static_cast<ssize_t>(request.size());
+    char reply[256];
+    ssize_t size = sent ? read(fd, reply, sizeof(reply)) : -1;
+    close(fd);
+    if (size <= 0) {
+        return false;
+    }
+    answer.assign(reply, static_cast<size_t>(size));
+    return true;
+}
+
+// Window an input or window event belongs to, 0 for events of the whole app
+uint32_t event_window_id(const SDL_Event& event) {
+    switch (event.type) {
+        case SDL_WINDOWEVENT: return event.window.windowID;
+        case SDL_KEYDOWN:
+        case SDL_KEYUP: return event.key.windowID;
+        case SDL_TEXTINPUT: return event.text.windowID;
+        case SDL_MOUSEMOTION: return event.motion.windowID;
+        case SDL_MOUSEBUTTONDOWN:
+        case SDL_MOUSEBUTTONUP: return event.button.windowID;
+        case SDL_MOUSEWHEEL: return event.wheel.windowID;
+        default: return 0;
+    }
+}
+}
+
+Server::Server(std::filesystem::path socket_path) : socket_path_(std::move(socket_path)) {
+    std::signal(SIGCHLD, SIG_IGN); // Shells of closed windows are reaped by the kernel
+    std::signal(SIGPIPE, SIG_IGN); // A client hanging up early
+#ifdef SDL_HINT_QUIT_ON_LAST_WINDOW_CLOSE
+    SDL_SetHint(SDL_HINT_QUIT_ON_LAST_WINDOW_CLOSE, "0"); // Closing the last window doesn't stop the server
+#endif
+    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS) < 0) {
+        throw std::runtime_error(SDL_GetError());
+    }
+    if (TTF_Init() < 0) {
+        throw std::runtime_error(TTF_GetError());
+    }
+    shared_ = std::make_shared<SharedResources>();
+    shared_->default_font()->prerender(' ', '~', shared_->config().software_renderer); // Loaded up front so the first window is as fast as the rest
+
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ < 0) {
+        throw std::runtime_error(std::string{"Could not create epoll: "} + std::strerror(errno));
+    }
+    listen_socket();
+}
+
+Server::~Server() {
+    for (const auto& [fd, client] : clients_) {
+        close(fd);
+    }
+    sessions_.clear(); // Windows and fonts go before TTF_Quit
+    shared_.reset();
+    if (listen_fd_ >= 0) {
+        close(listen_fd_);
+        std::filesystem::remove(socket_path_);
+    }
+    close(epoll_fd_);
+    TTF_Quit();
+}
+
+std::filesystem::path Server::default_socket_path() {
+    if (const char* runtime_dir = std::getenv("XDG_RUNTIME_DIR")) {
+        return std::filesystem::path{runtime_dir} / "kemul.sock";
+    }
+    return SharedResources::appdata_dir() / "server.sock";
+}
+
+void Server::listen_socket() {
+    auto address = make_address(socket_path_);
+    listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0) {
+        throw std::runtime_error(std::string{"Could not create socket: "} + std::strerror(errno));
+    }
+    if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        if (errno != EADDRINUSE || ping(socket_path_)) { // Somebody answered, don't steal their socket
+            close(listen_fd_);
+            listen_fd_ = -1;
+            throw std::runtime_error("Could not listen on " + socket_path_.string() + ", is another server running?");
+        }
+        std::filesystem::remove(socket_path_); // Left over from a server that died
+        if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+            close(listen_fd_);
+            listen_fd_ = -1;
+            throw std::runtime_error(std::string{"Could not bind socket: "} + std::strerror(errno));
+        }
+    }
+    if (listen(listen_fd_, 16) != 0) {
+        throw std::runtime_error(std::string{"Could not listen: "} + std::strerror(errno));
+    }
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = pack_data(0, listen_fd_);
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &event);
+}
+
+bool Server::request_window(const std::filesystem::path& socket_path) {
+    std::string answer;
+    if (!send_request(socket_path, "open\n", answer)) {
+        return false;
+    }
+    if (!answer.starts_with("ok")) {
+        std::cerr << "Server could not open a window: " << answer;
+    }
+    return true;
+}
+
+bool Server::ping(const std::filesystem::path& socket_path) {
+    std::string answer;
+    return send_request(socket_path, "ping\n", answer);
+}
+
+void Server::accept_client() {
+    int client;
+    while ((client = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.u64 = pack_data(0, client);
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, client, &event) != 0) {
+            close(client);
+            continue;
+        }
+        clients_[client] = Client{{}, std::chrono::steady_clock::now() + client_timeout};
+    }
+}
+
+void Server::on_client_ready(int fd) {
+    auto& client = clients_[fd];
+    char data[max_request_size];
+    ssize_t size;
+    while ((size = read(fd, data, sizeof(data))) > 0 && client.request.size() < max_request_size) {
+        client.request.append(data, static_cast<size_t>(size));
+    }
+    bool hung_up = size == 0 || (size < 0 && errno != EAGAIN && errno != EINTR);
+    if (client.request.find('\n') == std::string::npos && client.request.size() < max_request_size && !hung_up) {
+        return; // Rest of the line is still coming
+    }
+
+    std::string reply;
+    if (client.request.starts_with("open")) {
+        std::string error;
+        reply = open_window(error) ? "ok\n" : "error " + error + "\n";
+    } else if (client.request.starts_with("ping")) {
+        reply = "pong\n";
+    } else {
+        reply = "error unknown request\n";
+    }
+    write(fd, reply.data(), reply.size()); // A few bytes into an empty socket buffer, doesn't block
+    close_client(fd);
+}
+
+void Server::close_client(int fd) {
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    clients_.erase(fd);
+}
+
+void Server::drop_stale_clients() {
+    auto now = std::chrono::steady_clock::now();
+    for (auto iter = clients_.begin(); iter != clients_.end();) {
+        int fd = iter->first;
+        bool stale = iter->second.deadline <= now;
+        ++iter;
+        if (stale) {
+            close_client(fd);
+        }
+    }
+}
+
+bool Server::open_window(std::string& error) {
+    TRACE_SCOPE("Server::open_window");
+    try {
+        auto id = next_session_id_++;
+        auto& session = sessions_[id];
+        session.app = std::make_unique<Application>(shared_);
+        watch_ptys(id, session);
+        return true;
+    } catch (const std::exception& ex) {
+        sessions_.erase(next_session_id_ - 1);
+        error = ex.what();
+        std::cerr << "Could not open a window: " << error << std::endl;
+        return false;
+    }
+}
+
+void Server::watch_ptys(uint32_t id, Session& session) {
+    pty_fds_.clear();
+    session.app->collect_pty_fds(pty_fds_);
+    for (auto iter = session.registered.begin(); iter != session.registered.end();) { // Panes that were closed
+        bool open = std::any_of(pty_fds_.begin(), pty_fds_.end(), [fd = iter->first](const pollfd& entry) { return entry.fd == fd; });
+        if (open) {
+            ++iter;
+            continue;
+        }
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, iter->first, nullptr); // Usually gone already with the fd
+        iter = session.registered.erase(iter);
+    }
+    for (const auto& entry : pty_fds_) {
+        uint32_t wanted = to_epoll_events(entry.events);
+        auto iter = session.registered.find(entry.fd);
+        if (iter != session.registered.end() && iter->second == wanted) {
+            continue;
+        }
+        epoll_event event{};
+        event.events = wanted;
+        event.data.u64 = pack_data(id, entry.fd);
+        // A new pane can get the number of a closed one, its registration went away with the old fd
+        if (iter == session.registered.end() || (epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, entry.fd, &event) != 0 && errno == ENOENT)) {
+            if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, entry.fd, &event) != 0) {
+                std::cerr << "Could not watch pty: " << std::strerror(errno) << std::endl;
+                continue; // Tried again on the next iteration
+            }
+        }
+        session.registered[entry.fd] = wanted;
+    }
+}
+
+void Server::close_finished_sessions() {
+    for (auto iter = sessions_.begin(); iter != sessions_.end();) {
+        if (iter->second.app->is_running()) {
+            ++iter;
+            continue;
+        }
+        for (const auto& [fd, events] : iter->second.registered) {
+            epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+        }
+        iter = sessions_.erase(iter); // Closes the window and the ptys
+    }
+}
+
+void Server::route_event(SDL_Event& event) {
+    if (event.type == SDL_QUIT) {
+        is_running_ = false;
+        return;
+    }
+    auto window_id = event_window_id(event);
+    for (auto& [id, session] : sessions_) {
+        if (window_id == 0 || session.app->window_id() == window_id) {
+            session.app->handle_event(event);
+        }
+    }
+}
+
+int Server::wait_ms() const {
+    int wait = idle_wait_ms;
+    for (const auto& [id, session] : sessions_) {
+        wait = std::min(wait, session.app->wait_ms());
+    }
+    return wait;
+}
+
+void Server::run() {
+    constexpr int max_events = 64;
+    epoll_event events[max_events];
+    while (is_running_) {
+        TRACE_SCOPE("Server::loop");
+        SDL_Event event;
+        while (SDL_PollEvent(&event) != 0) {
+            route_event(event);
+        }
+
+        int ready = epoll_wait(epoll_fd_, events, max_events, wait_ms());
+        if (ready < 0 && errno != EINTR) {
+            throw std::runtime_error(std::string{"epoll_wait failed: "} + std::strerror(errno));
+        }
+        for (int i = 0; i < ready; ++i) {
+            auto id = static_cast<uint32_t>(events[i].data.u64 >> 32);
+            auto fd = static_cast<int>(events[i].data.u64 & 0xFFFFFFFFu);
+            if (id == 0 && fd == listen_fd_) {
+                accept_client();
+            } else if (id == 0) {
+                on_client_ready(fd);
+            } else if (auto iter = sessions_.find(id); iter != sessions_.end()) {
+                iter->second.app->on_pty_ready(fd, to_poll_events(events[i].events));
+            }
+        }
+        for (auto& [id, session] : sessions_) {
+            session.app->update();
+            watch_ptys(id, session);
+        }
+        close_finished_sessions();
+        drop_stale_clients();
+    }
+}
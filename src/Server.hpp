@@ -0,0 +1,61 @@
+#pragma once
+#include <SDL2/SDL_events.h>
+#include <chrono>
+#include <filesystem>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <sys/poll.h>
+#include <unordered_map>
+#include <vector>
+#include "Application.hpp"
+#include "SharedResources.hpp"
+
+// Server mode: one process owning many terminal windows. The config, fonts and rendered glyphs are loaded once and shared,
+// pty I/O of all sessions is multiplexed with epoll on the main thread, next to SDL events (SDL wants those on the main thread anyway).
+// `proj --new-window` asks a running server over a unix socket to open another window
+class Server {
+private:
+    struct Session {
+        std::unique_ptr<Application> app;
+        std::unordered_map<int, uint32_t> registered; // Pty fds of its panes epoll watches, with the events
+    };
+    struct Client { // Connected, request not complete yet
+        std::string request;
+        std::chrono::steady_clock::time_point deadline;
+    };
+
+    std::filesystem::path socket_path_;
+    int listen_fd_{-1};
+    int epoll_fd_{-1};
+    std::shared_ptr<SharedResources> shared_;
+    std::unordered_map<uint32_t, Session> sessions_; // By id, 0 is the listening socket and clients in epoll data
+    std::unordered_map<int, Client> clients_; // By fd
+    uint32_t next_session_id_{1};
+    std::vector<pollfd> pty_fds_; // Scratch for watch_ptys
+    bool is_running_{true};
+
+    void listen_socket();
+    void accept_client();
+    void on_client_ready(int fd); // Reads what the client sent, answers once the request is complete
+    void close_client(int fd);
+    void drop_stale_clients();
+    bool open_window(std::string& error);
+    void close_finished_sessions();
+    void watch_ptys(uint32_t id, Session& session); // Keeps the epoll interest in sync with the panes of the session and what they wait for
+    void route_event(SDL_Event& event);
+    int wait_ms() const;
+public:
+    explicit Server(std::filesystem::path socket_path = default_socket_path());
+    ~Server();
+    Server(const Server&) = delete;
+    Server& operator=(const Server&) = delete;
+
+    void run(); // Until SDL_QUIT (e.g. Ctrl+C), windows come and go
+    size_t session_count() const { return sessions_.size(); }
+
+    static std::filesystem::path default_socket_path();
+    // Client side: asks a running server for a new window. False if no server is listening
+    static bool request_window(const std::filesystem::path& socket_path = default_socket_path());
+    static bool ping(const std::filesystem::path& socket_path = default_socket_path()); // Is a server listening, doesn't open anything
+};
@@ -0,0 +1,106 @@
+#include "SessionRecording.hpp"
+#include <stdexcept>
+
+namespace {
+constexpr uint32_t recording_version = 2;
+constexpr uint8_t output_record = 0;
+constexpr uint8_t resize_record = 1;
+
+void put_le(std::ofstream& file, uint64_t value, int size) {
+    char bytes[8];
+    for (auto i = 0; i < size; ++i) {
+        bytes[i] = static_cast<char>(value >> (8 * i));
+    }
+    file.write(bytes, size);
+}
+
+bool get_le(std::ifstream& file, uint64_t& value, int size) {
+    unsigned char bytes[8];
+    if (!file.read(reinterpret_cast<char*>(bytes), size)) {
+        return false;
+    }
+    value = 0;
+    for (auto i = 0; i < size; ++i) {
+        value |= static_cast<uint64_t>(bytes[i]) << (8 * i);
+    }
+    return true;
+}
+}
+
+SessionRecorder::SessionRecorder(const std::filesystem::path& path, int cols, int rows)
+    : file_(path, std::ios::binary | std::ios::trunc), start_(std::chrono::steady_clock::now()), cols_(cols), rows_(rows) {
+    if (!file_.is_open()) {
+        throw std::runtime_error("Could not open " + path.string() + " for recording");
+    }
+    file_.write("KREC", 4);
+    put_le(file_, recording_version, 4);
+    put_le(file_, cols, 2);
+    put_le(file_, rows, 2);
+}
+
+void SessionRecorder::write_record(uint8_t type, std::string_view bytes) {
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_);
+    put_le(file_, type, 1);
+    put_le(file_, elapsed.count(), 8);
+    put_le(file_, bytes.size(), 4);
+    file_.write(bytes.data(), bytes.size());
+}
+
+void SessionRecorder::record(std::string_view chunk) {
+    write_record(output_record, chunk);
+}
+
+void SessionRecorder::record_resize(int cols, int rows) {
+    if (cols == cols_ && rows == rows_) {
+        return;
+    }
+    cols_ = cols;
+    rows_ = rows;
+    char size[4] = {static_cast<char>(cols), static_cast<char>(cols >> 8), static_cast<char>(rows), static_cast<char>(rows >> 8)};
+    write_record(resize_record, {size, 4});
+}
+
+SessionReader::SessionReader(const std::filesystem::path& path) : file_(path, std::ios::binary) {
+    if (!file_.is_open()) {
+        throw std::runtime_error("Could not open recording " + path.string());
+    }
+    char magic[4];
+    uint64_t version;
+    if (!file_.read(magic, 4) || std::string_view{magic, 4} != "KREC" || !get_le(file_, version, 4) || version == 0 || version > recording_version) {
+        throw std::runtime_error(path.string() + " is not a kemul recording");
+    }
+    version_ = static_cast<uint32_t>(version);
+    uint64_t cols = 0;
+    uint64_t rows = 0;
+    if (version_ >= 2 && (!get_le(file_, cols, 2) || !get_le(file_, rows, 2))) {
+        throw std::runtime_error(path.string() + " is cut short");
+    }
+    cols_ = static_cast<int>(cols);
+    rows_ = static_cast<int>(rows);
+}
+
+bool SessionReader::next(RecordedChunk& chunk) {
+    uint64_t type = output_record;
+    uint64_t length;
+    if ((version_ >= 2 && !get_le(file_, type, 1)) || !get_le(file_, chunk.timestamp_ns, 8) || !get_le(file_, length, 4)) {
+        return false;
+    }
+    chunk.bytes.resize(length);
+    if (!file_.read(chunk.bytes.data(), length)) {
+        return false;
+    }
+    if (type > resize_record) {
+        return next(chunk); // From a newer kemul, nothing this one can replay
+    }
+    chunk.is_resize = type == resize_record;
+    if (chunk.is_resize) {
+        if (length != 4) {
+            return false;
+        }
+        auto byte = [&chunk](int i) { return static_cast<int>(static_cast<unsigned char>(chunk.bytes[i])); };
+        chunk.cols = byte(0) | byte(1) << 8;
+        chunk.rows = byte(2) | byte(3) << 8;
+        chunk.bytes.clear();
+    }
+    return true;
+}
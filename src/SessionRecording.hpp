@@ -0,0 +1,52 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+
+// Raw pty output with timestamps and read boundaries, for reproducing sessions later.
+// File format, integers little-endian:
+//   "KREC", u32 version (2), u16 cols, u16 rows of the grid when the recording started
+//   then one record per read or resize: u8 type, u64 nanoseconds since the recording started, u32 length, length bytes.
+//   Type 0 is output, type 1 a resize with u16 cols, u16 rows as its bytes
+// Version 1 files (no grid size, no type byte) are still read
+class SessionRecorder {
+private:
+    std::ofstream file_;
+    std::chrono::steady_clock::time_point start_;
+    int cols_;
+    int rows_;
+
+    void write_record(uint8_t type, std::string_view bytes);
+public:
+    SessionRecorder(const std::filesystem::path& path, int cols, int rows);
+
+    void record(std::string_view chunk);
+    void record_resize(int cols, int rows); // Nothing is written if the size didn't change
+};
+
+struct RecordedChunk {
+    uint64_t timestamp_ns{0};
+    std::string bytes;
+    bool is_resize{false}; // bytes is empty then, the grid is cols x rows from here on
+    int cols{0};
+    int rows{0};
+};
+
+class SessionReader {
+private:
+    std::ifstream file_;
+    uint32_t version_{0};
+    int cols_{0};
+    int rows_{0};
+
+public:
+    explicit SessionReader(const std::filesystem::path& path);
+
+    bool next(RecordedChunk& chunk); // false at the end of the recording
+    // Grid size at the start, 0 if the recording doesn't say (version 1)
+    int cols() const { return cols_; }
+    int rows() const { return rows_; }
+};
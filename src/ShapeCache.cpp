@@ -0,0 +1,44 @@
+#include "ShapeCache.hpp"
+#include <utility>
+
+ShapeCache::ShapeCache(size_t capacity) : capacity_(capacity) {}
+
+const std::u32string& ShapeCache::make_key(std::u32string_view text, uint16_t style) {
+    key_.assign(text);
+    key_.push_back(static_cast<char32_t>(0x110000 + style)); // Past Unicode, can't be confused with text
+    return key_;
+}
+
+const ShapedRun* ShapeCache::find(std::u32string_view text, uint16_t style) {
+    auto iter = entries_.find(make_key(text, style));
+    if (iter == entries_.end()) {
+        ++misses_;
+        return nullptr;
+    }
+    ++hits_;
+    lru_.splice(lru_.begin(), lru_, iter->second.lru_pos);
+    return &iter->second.run;
+}
+
+const ShapedRun& ShapeCache::insert(std::u32string_view text, uint16_t style, ShapedRun run) {
+    const auto& key = make_key(text, style);
+    if (auto iter = entries_.find(key); iter != entries_.end()) {
+        iter->second.run = std::move(run);
+        lru_.splice(lru_.begin(), lru_, iter->second.lru_pos);
+        return iter->second.run;
+    }
+    while (!entries_.empty() && entries_.size() >= capacity_) {
+        // By iterator, erase(key) could read the key after the node holding it is gone
+        entries_.erase(entries_.find(*lru_.back()));
+        lru_.pop_back();
+    }
+    auto [iter, inserted] = entries_.emplace(key, Entry{std::move(run), {}});
+    lru_.push_front(&iter->first); // Keys of an unordered_map stay put on rehash
+    iter->second.lru_pos = lru_.begin();
+    return iter->second.run;
+}
+
+void ShapeCache::clear() {
+    entries_.clear();
+    lru_.clear();
+}
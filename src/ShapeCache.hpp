@@ -0,0 +1,52 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// A glyph of a shaped run, placed relative to the cell its cluster starts at
+struct ShapedGlyph {
+    uint32_t glyph; // Glyph index in the font, not a codepoint
+    uint16_t cell; // Within the run
+    int16_t x_offset; // Pixels
+    int16_t y_offset;
+};
+
+struct ShapedRun {
+    bool plain{true}; // One nominal glyph per cell, nothing to gain over drawing codepoint by codepoint
+    std::vector<ShapedGlyph> glyphs;
+};
+
+// Shaped runs keyed by their text and style, so a run seen before (prompt, keywords, "=>") is shaped once.
+// Least recently used runs are dropped once there are more than capacity of them
+class ShapeCache {
+private:
+    struct Entry {
+        ShapedRun run;
+        std::list<const std::u32string*>::iterator lru_pos;
+    };
+
+    std::unordered_map<std::u32string, Entry> entries_;
+    std::list<const std::u32string*> lru_; // Keys of entries_, most recently used first
+    std::u32string key_; // Reused for lookups
+    size_t capacity_;
+
+    // Stats for the HUD
+    uint64_t hits_{0};
+    uint64_t misses_{0};
+
+    const std::u32string& make_key(std::u32string_view text, uint16_t style);
+public:
+    explicit ShapeCache(size_t capacity = 4096);
+
+    const ShapedRun* find(std::u32string_view text, uint16_t style); // nullptr on a miss
+    const ShapedRun& insert(std::u32string_view text, uint16_t style, ShapedRun run);
+    void clear();
+
+    uint64_t get_hits() const { return hits_; }
+    uint64_t get_misses() const { return misses_; }
+    size_t size() const { return entries_.size(); }
+};
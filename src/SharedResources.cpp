@@ -0,0 +1,33 @@
+#include "SharedResources.hpp"
+#include <cstdlib>
+
+SharedResources::SharedResources(const std::filesystem::path& config_path) : config_path_(config_path) {}
+
+const Config& SharedResources::config() {
+    if (!config_) {
+        config_.emplace(config_path_);
+    }
+    return *config_;
+}
+
+std::filesystem::path SharedResources::appdata_dir() {
+    return std::filesystem::path(std::getenv("HOME")) / ".local/share/kemul";
+}
+
+std::filesystem::path SharedResources::default_config_path() {
+    return appdata_dir() / "config.cock";
+}
+
+std::shared_ptr<FontFace> SharedResources::font(const std::string& path, int ptsize) {
+    auto& face = fonts_[{path, ptsize}];
+    if (!face) {
+        const auto& settings = config();
+        face = std::make_shared<FontFace>(path, ptsize, settings.font_fallback, appdata_dir() / "coverage", settings.ligatures);
+    }
+    return face;
+}
+
+std::shared_ptr<FontFace> SharedResources::default_font() {
+    const auto& settings = config();
+    return font(settings.font_path, settings.font_ptsize);
+}
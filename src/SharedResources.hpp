@@ -0,0 +1,27 @@
+#pragma once
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include "Config.hpp"
+#include "FontFace.hpp"
+
+// What all windows of one process share: the config, parsed once, and the fonts with their rendered glyphs
+class SharedResources {
+private:
+    std::filesystem::path config_path_;
+    std::optional<Config> config_; // Parsed on first use
+    std::map<std::pair<std::string, int>, std::shared_ptr<FontFace>> fonts_; // Kept loaded, the next window opens without touching the disk
+
+public:
+    explicit SharedResources(const std::filesystem::path& config_path = default_config_path());
+
+    static std::filesystem::path appdata_dir(); // ~/.local/share/kemul
+    static std::filesystem::path default_config_path();
+
+    const Config& config();
+    std::shared_ptr<FontFace> font(const std::string& path, int ptsize); // Throws if it can't be loaded
+    std::shared_ptr<FontFace> default_font(); // From the config
+};
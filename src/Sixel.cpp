@@ -0,0 +1,130 @@
+#include "Sixel.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+uint32_t rgb(int r, int g, int b) { // Components 0..100 like sixel has them
+    auto scale = [](int value) { return static_cast<uint32_t>(std::clamp(value, 0, 100) * 255 / 100); };
+    return 0xFF000000u | scale(r) << 16 | scale(g) << 8 | scale(b);
+}
+
+uint32_t hls(int hue, int lightness, int saturation) {
+    // Sixel hue starts at blue: 0 = blue, 120 = red, 240 = green
+    double h = std::fmod(hue + 240, 360) / 360.0, l = std::clamp(lightness, 0, 100) / 100.0, s = std::clamp(saturation, 0, 100) / 100.0;
+    double q = l < 0.5 ? l * (1 + s) : l + s - l * s;
+    double p = 2 * l - q;
+    auto channel = [p, q](double t) {
+        t = t < 0 ? t + 1 : (t > 1 ? t - 1 : t);
+        double value = t < 1.0 / 6 ? p + (q - p) * 6 * t : t < 0.5 ? q : t < 2.0 / 3 ? p + (q - p) * (2.0 / 3 - t) * 6 : p;
+        return static_cast<int>(std::lround(value * 100));
+    };
+    return rgb(channel(h + 1.0 / 3), channel(h), channel(h - 1.0 / 3));
+}
+}
+
+SixelDecoder::SixelDecoder(bool transparent) : background_(transparent ? 0 : 0xFF000000u) {
+    // VT340 colors, the rest start out black
+    constexpr int vt340[16][3] = {
+        {0, 0, 0}, {20, 20, 80}, {80, 13, 13}, {20, 80, 20}, {80, 20, 80}, {20, 80, 80}, {80, 80, 20}, {53, 53, 53},
+        {26, 26, 26}, {33, 33, 60}, {60, 26, 26}, {33, 60, 33}, {60, 33, 60}, {33, 60, 60}, {60, 60, 33}, {80, 80, 80},
+    };
+    palette_.fill(0xFF000000u);
+    for (int i = 0; i < 16; ++i) {
+        palette_[i] = rgb(vt340[i][0], vt340[i][1], vt340[i][2]);
+    }
+    color_ = palette_[0];
+}
+
+void SixelDecoder::feed(std::string_view data) {
+    for (char c : data) {
+        if (command_) {
+            if (c >= '0' && c <= '9') {
+                auto& param = params_[std::min(param_count_, static_cast<int>(params_.size()) - 1)];
+                param = std::min(param * 10 + (c - '0'), 99999);
+                continue;
+            }
+            if (c == ';') {
+                param_count_ = std::min(param_count_ + 1, static_cast<int>(params_.size()) - 1);
+                continue;
+            }
+            end_command();
+        }
+        if (c >= '?' && c <= '~') {
+            draw(c - '?');
+        } else if (c == '$') { // Back to the start of the band
+            x_ = 0;
+        } else if (c == '-') { // Next band
+            x_ = 0;
+            y_ += 6;
+        } else if (c == '"' || c == '#' || c == '!') {
+            command_ = c;
+            params_.fill(0);
+            param_count_ = 0;
+        } // Anything else (line breaks some encoders add) is ignored
+    }
+}
+
+void SixelDecoder::end_command() {
+    if (command_ == '!') {
+        repeat_ = std::max(1, params_[0]);
+    } else if (command_ == '#') {
+        auto& entry = palette_[params_[0] % palette_.size()];
+        if (param_count_ >= 4 && params_[1] == 1) {
+            entry = hls(params_[2], params_[3], params_[4]);
+        } else if (param_count_ >= 4 && params_[1] == 2) {
+            entry = rgb(params_[2], params_[3], params_[4]);
+        }
+        color_ = entry;
+    } else if (command_ == '"') { // Pan;Pad;Ph;Pv, only the size is used
+        raster_width_ = std::min(params_[2], max_side);
+        raster_height_ = std::min(params_[3], max_side);
+        if (raster_width_ > 0 && raster_height_ > 0 && rows_.empty()) {
+            rows_.assign(raster_height_, std::vector<uint32_t>(raster_width_, background_)); // Allocated once instead of growing
+        }
+    }
+    command_ = 0;
+}
+
+void SixelDecoder::draw(int bits) {
+    int count = repeat_;
+    repeat_ = 1;
+    int x = x_;
+    x_ += count;
+    if (x >= max_side || y_ >= max_side) {
+        return;
+    }
+    count = std::min(count, max_side - x);
+    for (int bit = 0; bit < 6; ++bit) {
+        if (!(bits & (1 << bit)) || y_ + bit >= max_side) {
+            continue;
+        }
+        size_t y = y_ + bit;
+        if (rows_.size() <= y) {
+            rows_.resize(y + 1);
+        }
+        auto& row = rows_[y];
+        if (row.size() < static_cast<size_t>(x + count)) {
+            row.resize(x + count, background_);
+        }
+        std::fill_n(row.begin() + x, count, color_);
+    }
+    width_ = std::max(width_, x + count);
+}
+
+DecodedImage SixelDecoder::finish() {
+    if (command_) {
+        end_command();
+    }
+    DecodedImage image;
+    image.width = std::max(width_, raster_width_);
+    image.height = std::max(static_cast<int>(rows_.size()), raster_height_);
+    if (image.width == 0 || image.height == 0) {
+        return {};
+    }
+    image.pixels.assign(static_cast<size_t>(image.width) * image.height, background_);
+    for (size_t y = 0; y < rows_.size(); ++y) {
+        std::copy_n(rows_[y].begin(), std::min<size_t>(rows_[y].size(), image.width), image.pixels.begin() + y * image.width);
+    }
+    rows_.clear();
+    return image;
+}
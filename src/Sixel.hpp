@@ -0,0 +1,45 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// Pixels of an image from the application, ARGB8888 like the framebuffer. Alpha is 0 where the image is transparent
+struct DecodedImage {
+    int width{0};
+    int height{0};
+    std::vector<uint32_t> pixels; // width * height
+
+    size_t bytes() const { return pixels.size() * sizeof(uint32_t); }
+};
+
+// Turns the data of a sixel DCS (what comes after "ESC P ... q", without the ST) into pixels.
+// Data can be fed in pieces as it arrives, sequences cut between pieces are fine
+class SixelDecoder {
+public:
+    static constexpr int max_side = 4096; // Pixels past this are dropped
+
+    explicit SixelDecoder(bool transparent = false); // P2 = 1: pixels without a sixel stay transparent instead of the background
+
+    void feed(std::string_view data);
+    DecodedImage finish(); // Whatever was drawn so far
+
+private:
+    std::array<uint32_t, 256> palette_;
+    std::vector<std::vector<uint32_t>> rows_; // Grown as sixels come in, the width isn't known up front
+    uint32_t color_;
+    uint32_t background_;
+    int x_{0};
+    int y_{0}; // Top of the current band of six rows
+    int width_{0};
+    int raster_width_{0}; // From "Pan;Pad;Ph;Pv, if given
+    int raster_height_{0};
+    int repeat_{1};
+
+    char command_{0}; // '"', '#' or '!' while its parameters are being read
+    std::array<int, 5> params_{};
+    int param_count_{0};
+
+    void end_command();
+    void draw(int bits);
+};
@@ -0,0 +1,225 @@
+#include "SoftwareRasterizer.hpp"
+#include <algorithm>
+#include <cstring>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KEMUL_HAS_X86 1
+#endif
+
+namespace {
+uint32_t pack(const Color& color) {
+    return 0xFF000000u | (uint32_t{color.r} << 16) | (uint32_t{color.g} << 8) | color.b;
+}
+
+// x / 255 rounded, exact for x up to 255 * 255. The SIMD version uses the same formula so both give identical pixels
+inline uint32_t div255(uint32_t x) {
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+void blend_rect_scalar(uint32_t* dst, int dst_stride, const uint8_t* alpha, int alpha_stride, int w, int h, uint32_t fg, uint32_t bg) {
+    for (int y = 0; y < h; ++y, dst += dst_stride, alpha += alpha_stride) {
+        for (int i = 0; i < w; ++i) {
+            uint32_t a = alpha[i];
+            if (a == 0) {
+                dst[i] = bg;
+            } else if (a == 255) {
+                dst[i] = fg;
+            } else {
+                uint32_t r = div255(((bg >> 16) & 0xFF) * (255 - a) + ((fg >> 16) & 0xFF) * a);
+                uint32_t g = div255(((bg >> 8) & 0xFF) * (255 - a) + ((fg >> 8) & 0xFF) * a);
+                uint32_t b = div255((bg & 0xFF) * (255 - a) + (fg & 0xFF) * a);
+                dst[i] = 0xFF000000u | (r << 16) | (g << 8) | b;
+            }
+        }
+    }
+}
+
+#ifdef KEMUL_HAS_X86
+// 8 pixels per step in 16 bit lanes: alpha is spread over the 4 channel bytes of each pixel, bg * (255 - a) + fg * a fits in 16 bits,
+// and mulhi by 257 is the same div255 as above. The ragged end of a line (glyphs are rarely a multiple of 8 wide) goes through a masked store
+__attribute__((target("avx2")))
+void blend_rect_avx2(uint32_t* dst, int dst_stride, const uint8_t* alpha, int alpha_stride, int w, int h, uint32_t fg, uint32_t bg) {
+    const __m256i fg16 = _mm256_cvtepu8_epi16(_mm_set1_epi32(static_cast<int>(fg)));
+    const __m256i bg16 = _mm256_cvtepu8_epi16(_mm_set1_epi32(static_cast<int>(bg)));
+    const __m256i full = _mm256_set1_epi16(255);
+    const __m256i half = _mm256_set1_epi16(128);
+    const __m256i by257 = _mm256_set1_epi16(257);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i spread = _mm256_setr_epi8(0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+                                            4, 4, 4, 4, 5, 5, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7);
+    const int tail = w % 8;
+    const __m256i tail_mask = _mm256_cmpgt_epi32(_mm256_set1_epi32(tail), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+
+    auto blend8 = [&](uint64_t alphas) __attribute__((target("avx2"))) {
+        __m256i a = _mm256_shuffle_epi8(_mm256_set1_epi64x(static_cast<long long>(alphas)), spread);
+        __m256i a_lo = _mm256_unpacklo_epi8(a, zero);
+        __m256i a_hi = _mm256_unpackhi_epi8(a, zero);
+        __m256i lo = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(bg16, _mm256_sub_epi16(full, a_lo)), _mm256_mullo_epi16(fg16, a_lo)), half);
+        __m256i hi = _mm256_add_epi16(_mm256_add_epi16(_mm256_mullo_epi16(bg16, _mm256_sub_epi16(full, a_hi)), _mm256_mullo_epi16(fg16, a_hi)), half);
+        return _mm256_packus_epi16(_mm256_mulhi_epu16(lo, by257), _mm256_mulhi_epu16(hi, by257));
+    };
+
+    for (int y = 0; y < h; ++y, dst += dst_stride, alpha += alpha_stride) {
+        int i = 0;
+        for (; i + 8 <= w; i += 8) {
+            uint64_t alphas;
+            std::memcpy(&alphas, alpha + i, 8);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), blend8(alphas));
+        }
+        if (tail) {
+            uint64_t alphas = 0;
+            for (int j = 0; j < tail; ++j) { // Don't read past the mask, a variable sized memcpy would be a call
+                alphas |= uint64_t{alpha[i + j]} << (8 * j);
+            }
+            _mm256_maskstore_epi32(reinterpret_cast<int*>(dst + i), tail_mask, blend8(alphas));
+        }
+    }
+}
+#endif
+}
+
+SoftwareRasterizer::SoftwareRasterizer(int cell_width, int cell_height, GlyphSource glyphs)
+    : cell_width_(cell_width), cell_height_(cell_height), glyphs_(std::move(glyphs)), blend_rect_(blend_rect_scalar) {
+    set_use_simd(true);
+}
+
+bool SoftwareRasterizer::has_avx2() {
+#ifdef KEMUL_HAS_X86
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+void SoftwareRasterizer::set_use_simd(bool value) {
+    blend_rect_ = blend_rect_scalar;
+#ifdef KEMUL_HAS_X86
+    if (value && has_avx2()) {
+        blend_rect_ = blend_rect_avx2;
+    }
+#endif
+}
+
+bool SoftwareRasterizer::uses_simd() const {
+    return blend_rect_ != blend_rect_scalar;
+}
+
+void SoftwareRasterizer::resize(int width, int height) {
+    width_ = std::max(0, width);
+    height_ = std::max(0, height);
+    framebuffer_.assign(static_cast<size_t>(width_) * height_, 0xFF000000u);
+    set_clip(0, width_);
+}
+
+void SoftwareRasterizer::set_origin(int x, int y) {
+    origin_x_ = x;
+    origin_y_ = y;
+}
+
+void SoftwareRasterizer::set_clip(int left, int right) {
+    clip_left_ = std::clamp(left, 0, width_);
+    clip_right_ = std::clamp(right, clip_left_, width_);
+}
+
+void SoftwareRasterizer::fill(int x, int y, int w, int h, uint32_t color) {
+    int x_end = std::min(x + w, clip_right_);
+    int y_end = std::min(y + h, height_);
+    x = std::max(x, clip_left_);
+    y = std::max(y, 0);
+    for (int line = y; line < y_end; ++line) {
+        std::fill(framebuffer_.data() + static_cast<size_t>(line) * width_ + x, framebuffer_.data() + static_cast<size_t>(line) * width_ + x_end, color);
+    }
+}
+
+void SoftwareRasterizer::draw_image(int x, int y, int w, int h, const uint32_t* pixels, int src_w, int src_h, int top, int bottom) {
+    int x_begin = std::max(x, clip_left_);
+    int x_end = std::min(x + w, clip_right_);
+    int y_begin = std::max({y, top, 0});
+    int y_end = std::min({y + h, bottom, height_});
+    for (int line = y_begin; line < y_end; ++line) {
+        const uint32_t* src = pixels + static_cast<size_t>(line - y) * src_h / h * src_w; // Nearest pixel when stretched
+        uint32_t* dst = framebuffer_.data() + static_cast<size_t>(line) * width_;
+        for (int px = x_begin; px < x_end; ++px) {
+            uint32_t color = src[w == src_w ? px - x : static_cast<size_t>(px - x) * src_w / w];
+            uint32_t alpha = color >> 24;
+            if (alpha == 255) {
+                dst[px] = color;
+            } else if (alpha != 0) { // Sixels are either drawn or not, only other formats get here
+                uint32_t mixed = 0xFF000000u;
+                for (int shift = 0; shift < 24; shift += 8) {
+                    uint32_t fg = (color >> shift) & 0xFF, bg = (dst[px] >> shift) & 0xFF;
+                    mixed |= ((fg * alpha + bg * (255 - alpha)) / 255) << shift;
+                }
+                dst[px] = mixed;
+            }
+        }
+    }
+}
+
+void SoftwareRasterizer::clear_row(int slot) {
+    fill(clip_left_, origin_y_ + slot * cell_height_, clip_right_ - clip_left_, cell_height_, 0xFF000000u);
+}
+
+void SoftwareRasterizer::draw_row(int slot, const std::vector<Cell>& row) {
+    clear_row(slot);
+    int x = origin_x_;
+    int y = origin_y_ + slot * cell_height_;
+    for (const auto& cell : row) {
+        if (x >= clip_right_) {
+            break;
+        }
+        int advance = cell_width_;
+        draw_cell(x, y, cell, advance);
+        x += advance;
+    }
+}
+
+void SoftwareRasterizer::move_rows(int from, int to, int count) {
+    int src_y = std::max(0, origin_y_ + from * cell_height_);
+    int dst_y = std::max(0, origin_y_ + to * cell_height_);
+    int lines = std::min({count * cell_height_, height_ - src_y, height_ - dst_y});
+    if (lines <= 0) {
+        return;
+    }
+    if (clip_left_ == 0 && clip_right_ == width_) { // Whole lines are one block
+        std::memmove(framebuffer_.data() + static_cast<size_t>(dst_y) * width_, framebuffer_.data() + static_cast<size_t>(src_y) * width_, static_cast<size_t>(lines) * width_ * 4);
+        return;
+    }
+    // Only the columns of this pane, line by line in the order that doesn't overwrite lines still to be copied
+    size_t span = static_cast<size_t>(clip_right_ - clip_left_) * 4;
+    auto line_ptr = [this](int y) { return framebuffer_.data() + static_cast<size_t>(y) * width_ + clip_left_; };
+    if (dst_y < src_y) {
+        for (int i = 0; i < lines; ++i) {
+            std::memcpy(line_ptr(dst_y + i), line_ptr(src_y + i), span);
+        }
+    } else {
+        for (int i = lines - 1; i >= 0; --i) {
+            std::memcpy(line_ptr(dst_y + i), line_ptr(src_y + i), span);
+        }
+    }
+}
+
+// Same layout and colors as Window::draw_row: the glyph box is filled with the background,
+// bold is drawn white, underline in the foreground color and strikethrough white
+void SoftwareRasterizer::draw_cell(int x, int y, const Cell& cell, int& advance) {
+    uint32_t bg = pack(cell.bg_color);
+    uint32_t fg = cell.is_bold() ? 0xFFFFFFFFu : pack(cell.fg_color);
+    const GlyphMask* mask = glyphs_(cell.codepoint == 0 ? uint32_t{' '} : cell.codepoint);
+    if (!mask || mask->width == 0) {
+        fill(x, y, cell_width_, cell_height_, bg);
+        return;
+    }
+
+    advance = mask->width;
+    int w = std::min(mask->width, clip_right_ - x);
+    int h = std::min(mask->height, height_ - y);
+    blend_rect_(framebuffer_.data() + static_cast<size_t>(y) * width_ + x, width_, mask->alpha.data(), mask->width, w, h, fg, bg);
+
+    if (cell.is_underline()) {
+        fill(x, y + mask->height - mask->height / 5, mask->width, 1, pack(cell.fg_color));
+    }
+    if (cell.is_strikethrough()) {
+        fill(x, y + mask->height / 2, mask->width, 1, 0xFFFFFFFFu);
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "Cell.hpp"
+
+// Coverage of one rendered glyph, 0 = background, 255 = foreground
+struct GlyphMask {
+    int width{0};
+    int height{0};
+    std::vector<uint8_t> alpha; // width * height
+};
+
+// CPU renderer for hosts without a GPU: draws rows of cells into an ARGB8888 framebuffer that is uploaded once per frame.
+// Background, glyph and decorations of a cell are written in one pass, glyph edges are blended with AVX2 when the CPU has it
+class SoftwareRasterizer {
+public:
+    using GlyphSource = std::function<const GlyphMask*(uint32_t codepoint)>; // nullptr if the glyph can't be rendered
+
+    SoftwareRasterizer(int cell_width, int cell_height, GlyphSource glyphs);
+
+    void resize(int width, int height); // Framebuffer size in pixels, clears it
+    void set_origin(int x, int y); // Top left corner of the first row slot
+    void set_clip(int left, int right); // Pixel columns row slots span, for panes side by side. The whole width after resize()
+
+    void draw_row(int slot, const std::vector<Cell>& row); // Slot is the row on screen
+    void clear_row(int slot);
+    void move_rows(int from, int to, int count); // Copies count row slots, for scrolling
+    void fill(int x, int y, int w, int h, uint32_t color); // Clipped to the framebuffer and the columns of set_clip
+    // ARGB pixels of a src_w x src_h image over what's there, stretched to w x h. Clipped like fill() and to the pixel lines [top, bottom)
+    void draw_image(int x, int y, int w, int h, const uint32_t* pixels, int src_w, int src_h, int top, int bottom);
+
+    const uint32_t* pixels() const { return framebuffer_.data(); }
+    int pitch() const { return width_ * 4; } // Bytes per line
+    int width() const { return width_; }
+    int height() const { return height_; }
+
+    static bool has_avx2();
+    void set_use_simd(bool value); // On by default if the CPU supports it, off is for tests and benchmarks
+    bool uses_simd() const;
+
+    // Fills a w x h rectangle of dst with bg and fg mixed by alpha, the hot loop. Strides are in elements
+    using BlendRect = void (*)(uint32_t* dst, int dst_stride, const uint8_t* alpha, int alpha_stride, int w, int h, uint32_t fg, uint32_t bg);
+
+private:
+    std::vector<uint32_t> framebuffer_;
+    int width_{0};
+    int height_{0};
+    int cell_width_;
+    int cell_height_;
+    int origin_x_{0};
+    int origin_y_{0};
+    int clip_left_{0};
+    int clip_right_{0};
+    GlyphSource glyphs_;
+    BlendRect blend_rect_;
+
+    void draw_cell(int x, int y, const Cell& cell, int& advance);
+};
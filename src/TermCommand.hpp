@@ -0,0 +1,128 @@
+#pragma once
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "Cell.hpp"
+
+// What AnsiParser produces and TermBuffer consumes.
+// One CommandBuffer is filled per pty read and reused, so after warming up nothing gets allocated
+enum class CommandType : uint8_t {
+    PRINT,           // a = offset into text, b = amount of codepoints
+    SGR,             // a = index into pens
+    LINEFEED,
+    CARRIAGE_RETURN,
+    SET_CURSOR,      // a = row, b = col (both 1-based)
+    MOVE_CURSOR,     // a = rows, b = cols
+    ERASE_IN_LINE,   // a = mode
+    CLEAR,           // a = 1 to drop the scrollback too
+    INSERT_CHARS,    // a = n
+    DELETE_CHARS,    // a = n
+    DISCARD_LINES,   // a = n, fast-forward
+    PRIVATE_MODE,    // a = mode, b = 1 to set (CSI ? a h), 0 to reset (CSI ? a l)
+    SIXEL_BEGIN,     // a = image id, b = 1 if the background is transparent. The image goes at the cursor
+    SIXEL_DATA,      // a = offset into graphics, b = length. Belongs to the last SIXEL_BEGIN
+    SIXEL_END,       // a = image id, b = height in pixels, as far as known without decoding
+    GRAPHICS,        // a = index into graphics_commands, kitty graphics protocol
+};
+
+// DEC private modes kemul knows about
+constexpr int MODE_BRACKETED_PASTE = 2004; // Pasted text is sent wrapped in ESC[200~ ... ESC[201~
+constexpr int MODE_SYNCHRONIZED_OUTPUT = 2026; // Application is drawing a frame, don't show it until the mode is reset
+
+// One "ESC _ G keys;payload ESC \" of the kitty graphics protocol, keys as the application sent them
+struct GraphicsCommand {
+    char action{'t'};           // a: t transmit, T transmit and put, p put, d delete, q query
+    char medium{'d'};           // t: d base64 in the payload, f file, t temporary file, s shared memory
+    int format{32};             // f: 24 RGB, 32 RGBA, 100 PNG
+    char compression{0};        // o
+    uint32_t id{0};             // i
+    uint32_t number{0};         // I
+    uint32_t placement_id{0};   // p
+    int width{0};               // s, pixels
+    int height{0};              // v
+    size_t size{0};             // S, bytes to read from a file or shared memory, 0 for all of it
+    size_t offset{0};           // O
+    int cols{0};                // c, cells to stretch the image over
+    int rows{0};                // r
+    int quiet{0};               // q: 1 no OK replies, 2 no replies at all
+    bool more{false};           // m: more chunks of the payload follow
+    bool keep_cursor{false};    // C=1
+    char what{'a'};             // d: what to delete, uppercase frees the pixels too
+    std::string payload;        // Base64, a file or shared memory name for t=f/t/s
+
+    // Set up for the grid by the pane
+    uint32_t image{0};          // Pane side id the pixels are kept by, assigned by the parser to what's transmitted
+    uint32_t place{0};          // Image to put at the cursor
+    uint32_t drop{0};           // Image whose placements go
+    bool drop_all{false};
+};
+
+struct TermCommand {
+    CommandType type;
+    int a{0};
+    int b{0};
+};
+
+class CommandBuffer {
+public:
+    std::vector<TermCommand> commands;
+    std::vector<uint32_t> text; // Codepoints of all PRINT runs
+    std::vector<Cell> pens;     // Attributes set by SGR
+    std::optional<std::string> title;
+    std::string graphics; // Image data of SIXEL_DATA, handed to the decoder as is
+    std::vector<GraphicsCommand> graphics_commands;
+
+    void push(CommandType type, int a = 0, int b = 0) {
+        commands.push_back({type, a, b});
+    }
+
+    void print(uint32_t codepoint) {
+        extend_print_run(1);
+        text.push_back(codepoint);
+    }
+    void print(std::string_view ascii) {
+        extend_print_run(static_cast<int>(ascii.size()));
+        text.insert(text.end(), ascii.begin(), ascii.end());
+    }
+
+    void set_pen(const Cell& pen) {
+        if (!commands.empty() && commands.back().type == CommandType::SGR) { // Only the last one of consecutive SGRs matters
+            pens[commands.back().a] = pen;
+            return;
+        }
+        push(CommandType::SGR, static_cast<int>(pens.size()));
+        pens.push_back(pen);
+    }
+
+    void push_graphics(CommandType type, std::string_view data) {
+        push(type, static_cast<int>(graphics.size()), static_cast<int>(data.size()));
+        graphics.append(data);
+    }
+    std::string_view graphics_of(const TermCommand& command) const {
+        return std::string_view{graphics}.substr(command.a, command.b);
+    }
+
+    bool empty() const {
+        return commands.empty() && !title;
+    }
+
+    void clear() { // Keeps capacity
+        commands.clear();
+        text.clear();
+        pens.clear();
+        title.reset();
+        graphics.clear();
+        graphics_commands.clear();
+    }
+
+private:
+    void extend_print_run(int n) {
+        if (!commands.empty() && commands.back().type == CommandType::PRINT) {
+            commands.back().b += n;
+            return;
+        }
+        push(CommandType::PRINT, static_cast<int>(text.size()), n);
+    }
+};
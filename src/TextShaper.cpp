@@ -0,0 +1,107 @@
+#include "TextShaper.hpp"
+#include <hb-ft.h>
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include "Trace.hpp"
+
+TextShaper::TextShaper(const std::string& path, int ptsize, std::pair<int, int> cell_size, int ascent)
+    : cell_width_(cell_size.first), cell_height_(cell_size.second), ascent_(ascent) {
+    if (FT_Init_FreeType(&library_) != 0) {
+        throw std::runtime_error("Could not initialize FreeType");
+    }
+    if (FT_New_Face(library_, path.c_str(), 0, &face_) != 0 || FT_Set_Char_Size(face_, 0, ptsize * 64, 72, 72) != 0) { // 72 dpi like SDL_ttf
+        release();
+        throw std::runtime_error("Could not open " + path + " for shaping");
+    }
+    font_ = hb_ft_font_create_referenced(face_);
+    buffer_ = hb_buffer_create();
+}
+
+TextShaper::~TextShaper() {
+    release();
+}
+
+void TextShaper::release() {
+    if (buffer_) {
+        hb_buffer_destroy(buffer_);
+    }
+    if (font_) {
+        hb_font_destroy(font_);
+    }
+    if (face_) {
+        FT_Done_Face(face_);
+    }
+    if (library_) {
+        FT_Done_FreeType(library_);
+    }
+}
+
+ShapedRun TextShaper::shape(std::u32string_view text) {
+    TRACE_SCOPE("TextShaper::shape");
+    hb_buffer_clear_contents(buffer_);
+    hb_buffer_add_utf32(buffer_, reinterpret_cast<const uint32_t*>(text.data()), static_cast<int>(text.size()), 0, static_cast<int>(text.size()));
+    hb_buffer_guess_segment_properties(buffer_);
+    hb_shape(font_, buffer_, nullptr, 0);
+
+    unsigned int count = 0;
+    const auto* infos = hb_buffer_get_glyph_infos(buffer_, &count);
+    const auto* positions = hb_buffer_get_glyph_positions(buffer_, &count);
+    ShapedRun run;
+    run.plain = count == text.size();
+    run.glyphs.reserve(count);
+    int pen_x = 0; // 26.6
+    for (unsigned int i = 0; i < count; ++i) {
+        auto cell = infos[i].cluster; // Clusters are indices into the UTF-32 text
+        if (infos[i].codepoint == 0) {
+            return ShapedRun{}; // The font doesn't have a glyph, leave the run to the fallback fonts
+        }
+        // Cells are a fixed grid, the glyph keeps only what it is shifted off its cell
+        auto x = (pen_x + positions[i].x_offset) / 64 - static_cast<int>(cell) * cell_width_;
+        auto y = -positions[i].y_offset / 64;
+        pen_x += positions[i].x_advance;
+        run.glyphs.push_back({infos[i].codepoint, static_cast<uint16_t>(cell), static_cast<int16_t>(x), static_cast<int16_t>(y)});
+
+        hb_codepoint_t nominal = 0;
+        if (run.plain && (cell != i || x != 0 || y != 0 || !hb_font_get_nominal_glyph(font_, text[cell], &nominal) || nominal != infos[i].codepoint)) {
+            run.plain = false;
+        }
+    }
+    if (run.plain) {
+        run.glyphs.clear(); // Drawn by codepoint, no need to keep them
+    }
+    return run;
+}
+
+SDL_Surface* TextShaper::render(uint32_t glyph, int& offset_x) const {
+    TRACE_SCOPE("TextShaper::render");
+    if (FT_Load_Glyph(face_, glyph, FT_LOAD_RENDER | FT_LOAD_TARGET_NORMAL) != 0 || face_->glyph->bitmap.pixel_mode != FT_PIXEL_MODE_GRAY) {
+        std::cerr << "Could not render glyph " << glyph << '\n';
+        return nullptr;
+    }
+    const auto& bitmap = face_->glyph->bitmap;
+    int left = face_->glyph->bitmap_left;
+    int top = ascent_ - face_->glyph->bitmap_top;
+    offset_x = std::min(0, left);
+    int width = std::max(cell_width_, left + static_cast<int>(bitmap.width)) - offset_x;
+
+    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, width, cell_height_, 32, SDL_PIXELFORMAT_ARGB8888); // Zeroed
+    if (!surface) {
+        std::cerr << "Could not create glyph surface: " << SDL_GetError() << '\n';
+        return nullptr;
+    }
+    SDL_LockSurface(surface);
+    for (int row = 0; row < static_cast<int>(bitmap.rows); ++row) {
+        int y = top + row;
+        if (y < 0 || y >= cell_height_) {
+            continue;
+        }
+        auto* line = reinterpret_cast<uint32_t*>(static_cast<uint8_t*>(surface->pixels) + y * surface->pitch) + (left - offset_x);
+        const auto* coverage = bitmap.buffer + row * bitmap.pitch;
+        for (int col = 0; col < static_cast<int>(bitmap.width); ++col) {
+            line[col] = static_cast<uint32_t>(coverage[col]) << 24 | 0x00FFFFFFu;
+        }
+    }
+    SDL_UnlockSurface(surface);
+    return surface;
+}
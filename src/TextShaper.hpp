@@ -0,0 +1,36 @@
+#pragma once
+#include <SDL2/SDL_surface.h>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include <hb.h>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include "ShapeCache.hpp"
+
+// What SDL_ttf can't do: shapes runs of text with HarfBuzz, so ligatures and contextual alternates of fonts like Fira Code
+// show up, and renders the resulting glyphs by index with FreeType. Only built with KEMUL_SHAPING
+class TextShaper {
+private:
+    FT_Library library_{nullptr};
+    FT_Face face_{nullptr};
+    hb_font_t* font_{nullptr};
+    hb_buffer_t* buffer_{nullptr}; // Reused for every run
+    int cell_width_;
+    int cell_height_;
+    int ascent_; // Baseline, the same as SDL_ttf puts it so shaped and unshaped glyphs line up
+
+    void release();
+public:
+    // Same size as TTF_OpenFont(path, ptsize). Throws if the font can't be opened
+    TextShaper(const std::string& path, int ptsize, std::pair<int, int> cell_size, int ascent);
+    ~TextShaper();
+    TextShaper(const TextShaper&) = delete;
+    TextShaper& operator=(const TextShaper&) = delete;
+
+    ShapedRun shape(std::u32string_view text);
+    // White on transparent, caller owns it. offset_x is where the surface starts relative to the pen, <= 0 for glyphs
+    // reaching into the cells before (ligatures are drawn over the cells of the whole sequence). nullptr on failure
+    SDL_Surface* render(uint32_t glyph, int& offset_x) const;
+};
@@ -0,0 +1,92 @@
+#include "Trace.hpp"
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> Tracer::enabled_{false};
+
+namespace {
+struct TraceEvent {
+    const char* name;
+    int64_t start_ns;
+    int64_t end_ns;
+};
+
+constexpr size_t events_per_thread = 1 << 20; // 24MB of address space, pages are only touched as events come in
+
+// Written only by its own thread, count is published with release so write() sees complete events
+struct ThreadEvents {
+    uint32_t tid{0};
+    std::unique_ptr<TraceEvent[]> events{new TraceEvent[events_per_thread]};
+    std::atomic<size_t> count{0};
+    std::atomic<size_t> dropped{0};
+};
+
+std::mutex registry_mutex;
+std::vector<std::shared_ptr<ThreadEvents>> registry; // Keeps buffers of finished threads alive until the trace is written
+const auto epoch = std::chrono::steady_clock::now();
+
+ThreadEvents& thread_events() {
+    thread_local std::shared_ptr<ThreadEvents> events = [] { // Registration locks, but only once per thread
+        auto created = std::make_shared<ThreadEvents>();
+        std::lock_guard lock{registry_mutex};
+        created->tid = static_cast<uint32_t>(registry.size() + 1);
+        registry.push_back(created);
+        return created;
+    }();
+    return *events;
+}
+}
+
+void Tracer::enable() {
+    enabled_.store(true, std::memory_order_relaxed);
+}
+
+int64_t Tracer::now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void Tracer::record(const char* name, int64_t start_ns, int64_t end_ns) {
+    auto& thread = thread_events();
+    auto index = thread.count.load(std::memory_order_relaxed);
+    if (index >= events_per_thread) {
+        thread.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    thread.events[index] = {name, start_ns, end_ns};
+    thread.count.store(index + 1, std::memory_order_release);
+}
+
+bool Tracer::write(const std::string& path) {
+    std::ofstream file{path, std::ios::trunc};
+    if (!file.is_open()) {
+        return false;
+    }
+
+    std::vector<std::shared_ptr<ThreadEvents>> threads;
+    {
+        std::lock_guard lock{registry_mutex};
+        threads = registry;
+    }
+
+    size_t dropped = 0;
+    bool first = true;
+    file << std::fixed << std::setprecision(3); // Microseconds, keep the ns
+    file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    for (const auto& thread : threads) {
+        auto count = thread->count.load(std::memory_order_acquire);
+        dropped += thread->dropped.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < count; ++i) {
+            const auto& event = thread->events[i];
+            file << (first ? "" : ",\n")
+                 << "{\"name\": \"" << event.name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << thread->tid
+                 << ", \"ts\": " << event.start_ns / 1000.0 << ", \"dur\": " << (event.end_ns - event.start_ns) / 1000.0 << "}";
+            first = false;
+        }
+    }
+    file << "\n], \"otherData\": {\"dropped_events\": " << dropped << "}}\n";
+    return static_cast<bool>(file);
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Scoped timing events saved as Chrome trace JSON, open the file in ui.perfetto.dev or chrome://tracing.
+// Off until enable() is called, a disabled TRACE_SCOPE costs one relaxed atomic load.
+// Every thread writes into its own buffer, recording never locks
+class Tracer {
+public:
+    static void enable();
+    static bool enabled() {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    // name has to live until the trace is written, pass string literals
+    static void record(const char* name, int64_t start_ns, int64_t end_ns);
+    // Writes everything recorded so far, recording goes on. Returns false if the file can't be written
+    static bool write(const std::string& path);
+    static int64_t now_ns();
+
+private:
+    static std::atomic<bool> enabled_;
+};
+
+class TraceScope {
+public:
+    explicit TraceScope(const char* name) : name_(name), start_ns_(Tracer::enabled() ? Tracer::now_ns() : -1) {}
+    ~TraceScope() {
+        if (start_ns_ >= 0) {
+            Tracer::record(name_, start_ns_, Tracer::now_ns());
+        }
+    }
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* name_;
+    int64_t start_ns_;
+};
+
+#define KEMUL_TRACE_CONCAT_(a, b) a##b
+#define KEMUL_TRACE_CONCAT(a, b) KEMUL_TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) TraceScope KEMUL_TRACE_CONCAT(trace_scope_, __LINE__){name}
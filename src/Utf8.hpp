@@ -0,0 +1,75 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+inline int utf8_length(uint32_t codepoint) {
+    if (codepoint < 0x80) return 1;
+    if (codepoint < 0x800) return 2;
+    if (codepoint < 0x10000 || codepoint > 0x10FFFF) return 3; // Invalid ones become U+FFFD
+    return 4;
+}
+
+// Writes codepoint as UTF-8 into out (at least 4 bytes of room), returns amount of bytes written
+inline int encode_utf8(uint32_t codepoint, char* out) {
+    if (codepoint > 0x10FFFF || (codepoint >= 0xD800 && codepoint <= 0xDFFF)) {
+        codepoint = 0xFFFD; // Replacement character instead of garbage
+    }
+    if (codepoint < 0x80) {
+        out[0] = static_cast<char>(codepoint);
+        return 1;
+    }
+    if (codepoint < 0x800) {
+        out[0] = static_cast<char>(0xC0 | (codepoint >> 6));
+        out[1] = static_cast<char>(0x80 | (codepoint & 0x3F));
+        return 2;
+    }
+    if (codepoint < 0x10000) {
+        out[0] = static_cast<char>(0xE0 | (codepoint >> 12));
+        out[1] = static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+        out[2] = static_cast<char>(0x80 | (codepoint & 0x3F));
+        return 3;
+    }
+    out[0] = static_cast<char>(0xF0 | (codepoint >> 18));
+    out[1] = static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F));
+    out[2] = static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+    out[3] = static_cast<char>(0x80 | (codepoint & 0x3F));
+    return 4;
+}
+
+// Decodes one character starting at text[pos] into codepoint.
+// Returns its length in bytes, 0 if text ends in the middle of it and -1 if the byte at pos can't start a character
+inline int decode_utf8(std::string_view text, size_t pos, uint32_t& codepoint) {
+    auto lead = static_cast<unsigned char>(text[pos]);
+    int length;
+    if (lead < 0x80) {
+        codepoint = lead;
+        return 1;
+    } else if ((lead & 0xE0) == 0xC0) {
+        length = 2;
+        codepoint = lead & 0x1F;
+    } else if ((lead & 0xF0) == 0xE0) {
+        length = 3;
+        codepoint = lead & 0x0F;
+    } else if ((lead & 0xF8) == 0xF0) {
+        length = 4;
+        codepoint = lead & 0x07;
+    } else {
+        return -1;
+    }
+
+    for (int i = 1; i < length; ++i) {
+        if (pos + i >= text.size()) {
+            return 0;
+        }
+        auto byte = static_cast<unsigned char>(text[pos + i]);
+        if ((byte & 0xC0) != 0x80) {
+            return -1;
+        }
+        codepoint = (codepoint << 6) | (byte & 0x3F);
+    }
+    if (utf8_length(codepoint) != length || codepoint > 0x10FFFF) { // Overlong encodings and such
+        return -1;
+    }
+    return length;
+}
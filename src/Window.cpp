@@ -1,5 +1,8 @@
 #include <algorithm>
+#include <chrono>
+#include <cstdio>
 #include <fcntl.h>
+#include <iostream>
 #include <memory>
 #include <pty.h>
 #include <stdexcept>
@@ -22,23 +25,44 @@
 #include "GlyphCache.hpp"
 #include <utf8cpp/utf8.h>
 #include <utf8cpp/utf8/cpp11.h>
+#include "BoxDrawing.hpp"
 #include "Color.hpp"
+#include "Trace.hpp"
 
 
-Window::Window(const std::string& font_path, int font_ptsize, int width, int height) : width_(width), height_(height), font_ptsize_(font_ptsize) {
-    init();
-    load_font(font_path);
+Window::Window(std::future<std::shared_ptr<FontFace>> font, int width, int height, size_t row_cache_bytes, bool software_renderer)
+    : width_(width), height_(height), row_cache_(row_cache_bytes) {
+    bool software = init(software_renderer);
+    {
+        TRACE_SCOPE("Window::wait_font");
+        font_ = font.get();
+    }
+    font_size_ = font_->cell_size();
 
+    // Glyphs are rendered once in the shared face, a window only keeps what it drew in its atlas. Cap it, a full atlas just starts over
+    constexpr int max_atlas_side = 2048;
     auto max_size = get_max_texture_size();
-    glyph_cache_ = std::make_unique<GlyphCache>(renderer_, font_, max_size);
+    glyph_cache_ = std::make_unique<GlyphCache>(renderer_, std::make_pair(std::min(max_size.first, max_atlas_side), std::min(max_size.second, max_atlas_side)));
 
     auto font_size = get_font_size();
-    buffer_ = std::make_unique<TermBuffer>(width, height, font_size.first, font_size.second);
+    if (software) {
+        rasterizer_ = std::make_unique<SoftwareRasterizer>(font_size.first, font_size.second, [this](uint32_t codepoint) {
+            return glyph_cache_->get_or_create_mask(*font_, codepoint);
+        });
+        rasterizer_->set_origin(10, font_size.second / 2);
+    }
 }
 Window::~Window() {
+    panes_.clear(); // Shells get SIGHUP
+    row_cache_.clear(); // Textures go before the renderer
+    image_cache_.clear();
+    for (auto* texture : frames_) {
+        SDL_DestroyTexture(texture);
+    }
+    SDL_DestroyTexture(framebuffer_);
+    glyph_cache_.reset();
     SDL_DestroyWindow(window_);
     SDL_DestroyRenderer(renderer_);
-    TTF_CloseFont(font_);
 }
 
 std::pair<int, int> Window::get_max_texture_size() const {
@@ -47,124 +71,738 @@ std::pair<int, int> Window::get_max_texture_size() const {
     return {info.max_texture_width, info.max_texture_height};
 }
 std::pair<int, int> Window::get_font_size() const {
-    int width, height;
-    TTF_SizeText(font_, " ", &width, &height);
-    return {width, height};
+    return font_size_;
 }
 
-void Window::init() {
+int Window::get_refresh_rate() const {
+    SDL_DisplayMode mode;
+    int display = SDL_GetWindowDisplayIndex(window_);
+    if (display < 0 || SDL_GetCurrentDisplayMode(display, &mode) != 0) {
+        return 0;
+    }
+    return mode.refresh_rate;
+}
+
+bool Window::init(bool software_renderer) {
     window_ = SDL_CreateWindow("Kemul", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, width_, height_, SDL_WINDOW_RESIZABLE | SDL_WINDOW_SHOWN);
     if (!window_) {
         throw std::runtime_error(std::string{"Could not create window: "} + SDL_GetError());
     }
-    renderer_ = SDL_CreateRenderer(window_, -1, SDL_RENDERER_ACCELERATED);
+    if (!software_renderer) {
+        renderer_ = SDL_CreateRenderer(window_, -1, SDL_RENDERER_ACCELERATED);
+        if (renderer_) {
+            return false;
+        }
+        std::cerr << "No accelerated renderer, drawing on the CPU: " << SDL_GetError() << std::endl;
+    }
+    renderer_ = SDL_CreateRenderer(window_, -1, SDL_RENDERER_SOFTWARE);
     if (!renderer_) {
         throw std::runtime_error(std::string{"Could not create renderer: "} + SDL_GetError());
     }
+    return true;
 }
 
-void Window::load_font(const std::string& font_path) {
-    font_ = TTF_OpenFont(font_path.c_str(), font_ptsize_);
-    if (!font_) {
-        throw std::runtime_error(std::string{"Could not load a font: "} + TTF_GetError());
-    }
-}
 void Window::set_should_render(bool value) {
     should_render_ = value;
 }
 
-void Window::draw() {
-    if (!should_render_) {
-        SDL_Delay(16);
-        return;
+void Window::toggle_hud() {
+    show_hud_ = !show_hud_;
+    stats_.reset_histogram();
+    set_should_render(true);
+}
+
+bool Window::needs_render() const {
+    bool hud_refresh = show_hud_ && PerfStats::Clock::now() - last_draw_ >= std::chrono::milliseconds{500}; // Keep rates updating when idle
+    return should_render_ || hud_refresh;
+}
+
+bool Window::draw() {
+    if (!needs_render()) {
+        return false;
     }
+    auto frame_start = PerfStats::Clock::now();
+    TRACE_SCOPE("Window::draw");
+    auto hits_before = glyph_cache_->get_hits();
+    auto misses_before = glyph_cache_->get_misses();
+    size_t cells_drawn = 0;
 
     auto font_size = get_font_size();
     cursor_pos_.x = 10;
     cursor_pos_.y = font_size.second / 2;
+    row_cache_.set_row_size(width_, font_size.second);
+
+    bool software = rasterizer_ && prepare_framebuffer();
+    bool keep_frame = software || prepare_frame_textures(); // Without either everything goes straight to the screen every time
+    bool moved = false;
+    rows_redrawn_ = 0;
+    held_panes_ = false;
+    for (auto& view : panes_) {
+        view.redraw = plan_pane(view, !keep_frame);
+        view.moved = view.redraw && shift_frame_keys(view, view.pane->buffer().get_evicted_lines() + view.scroll_offset, static_cast<int>(view.slot_keys.size()),
+                                                     view.moved_from, view.moved_to, view.moved_kept);
+        moved = moved || view.moved;
+    }
+
+    if (software) {
+        draw_software(moved, cells_drawn);
+    } else {
+        SDL_Texture* frame = keep_frame ? begin_frame(moved) : nullptr;
+        if (!frame) {
+            SDL_SetRenderDrawColor(renderer_, 0, 0, 0, 255);
+            SDL_RenderClear(renderer_);
+        }
+        for (auto& view : panes_) {
+            if (view.redraw) {
+                draw_pane(view, frame != nullptr, cells_drawn);
+            }
+        }
+        if (frame) {
+            SDL_SetRenderTarget(renderer_, nullptr);
+            SDL_RenderCopy(renderer_, frame, nullptr, nullptr);
+        }
+    }
+
+    draw_dividers();
+    draw_cursor();
+    if (show_hud_ && !panes_.empty()) {
+        draw_hud(glyph_cache_->get_hits() - hits_before, glyph_cache_->get_misses() - misses_before);
+    }
+    {
+        TRACE_SCOPE("SDL_RenderPresent");
+        SDL_RenderPresent(renderer_);
+    }
+    should_render_ = held_panes_; // Held panes are looked at again next frame, a stuck update times out
 
+    last_draw_ = PerfStats::Clock::now();
+    stats_.add_frame(last_draw_ - frame_start, cells_drawn);
+    return true;
+}
+
+int Window::pane_slots(const PaneView& view) const {
+    return std::max(0, view.rect.h / get_font_size().second - 1);
+}
+
+bool Window::plan_pane(PaneView& view, bool force) {
+    if (!force && !view.frame_keys.empty() && view.pane->holds_frame(Pane::Clock::now())) {
+        held_panes_ = true; // Its slots keep what they show, drawn once the update is done or times out
+        return false;
+    }
+    bool damaged = view.pane->take_damage();
+    damaged = std::exchange(view.damaged, false) || damaged;
+    if (!damaged && !force && !view.frame_keys.empty()) {
+        return false; // Idle, not even hashed
+    }
+
+    auto& buffer = view.pane->buffer();
+    if (auto row = buffer.take_scroll_request()) {
+        view.scroll_offset = *row;
+    }
+    if (auto title = view.pane->take_title()) {
+        view.title = std::move(*title);
+        if (view.id == focused_pane_) {
+            set_window_title(view.title);
+        }
+    }
+    if (auto evicted = buffer.get_evicted_lines(); evicted != view.seen_evicted_lines) {
+        auto shift = evicted - view.seen_evicted_lines;
+        view.scroll_offset = shift >= view.scroll_offset ? 0 : view.scroll_offset - shift;
+        view.seen_evicted_lines = evicted;
+    }
+
+    int slots = pane_slots(view);
+    auto cursor_y = buffer.get_cursor_pos().second;
+    if (cursor_y > (int)view.scroll_offset + slots - 1 && !view.is_scrolling) {
+        view.scroll_offset += cursor_y - (view.scroll_offset + slots) + 1;
+    }
+
+    // What every row slot of the pane should show now
+    const auto& rows = buffer.get_buffer();
+    view.slot_keys.assign(slots, empty_slot_key);
+    for (int i = 0; i < slots && view.scroll_offset + i < rows.size(); ++i) {
+        view.slot_keys[i] = row_hash(rows[view.scroll_offset + i]);
+    }
+    // Rows under an image also depend on which part of it they show and whether it's decoded yet
+    auto top_line = buffer.get_evicted_lines() + view.scroll_offset;
+    for (const auto& placement : buffer.get_images()) {
+        uint64_t ready = view.pane->image(placement.image) != nullptr;
+        for (int row = 0; row < placement.rows; ++row) {
+            auto slot = static_cast<long long>(placement.line) + row - static_cast<long long>(top_line);
+            if (slot < 0 || slot >= slots || view.slot_keys[slot] == empty_slot_key) {
+                continue;
+            }
+            auto& key = view.slot_keys[slot];
+            key = (key ^ (uint64_t{placement.image} << 32 | static_cast<uint64_t>(row) << 1 | ready)) * 0x9e3779b97f4a7c15ull;
+            key ^= key >> 32;
+        }
+    }
+    return true;
+}
+
+bool Window::prepare_frame_textures() {
+    if (frames_[0] && frames_[1] && frame_size_ == std::make_pair(width_, height_)) {
+        return true;
+    }
+    for (auto*& texture : frames_) {
+        SDL_DestroyTexture(texture);
+        texture = SDL_CreateTexture(renderer_, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, width_, height_);
+    }
+    frame_size_ = {width_, height_};
+    for (auto& view : panes_) {
+        view.frame_keys.clear();
+    }
+    return frames_[0] && frames_[1]; // No target textures, draw straight to the screen every time
+}
+
+SDL_Texture* Window::begin_frame(bool moved) {
+    auto* previous = frames_[current_frame_];
+    if (!moved) {
+        SDL_SetRenderTarget(renderer_, previous); // Only damaged rows get redrawn
+        return previous;
+    }
+    // Start from a clear frame, move over what is still visible: panes that didn't scroll as they are, the kept rows of those that did
+    current_frame_ = 1 - current_frame_;
+    SDL_SetRenderTarget(renderer_, frames_[current_frame_]);
     SDL_SetRenderDrawColor(renderer_, 0, 0, 0, 255);
     SDL_RenderClear(renderer_);
+    auto font_h = get_font_size().second;
+    for (const auto& view : panes_) {
+        const auto& rect = view.rect;
+        if (!view.moved) {
+            SDL_Rect area{rect.x, rect.y, rect.w, rect.h};
+            SDL_RenderCopy(renderer_, previous, &area, &area);
+        } else if (view.moved_kept > 0) {
+            SDL_Rect src{rect.x, rect.y + font_h / 2 + view.moved_from * font_h, rect.w, view.moved_kept * font_h};
+            SDL_Rect dest{rect.x, rect.y + font_h / 2 + view.moved_to * font_h, rect.w, view.moved_kept * font_h};
+            SDL_RenderCopy(renderer_, previous, &src, &dest);
+        }
+    }
+    return frames_[current_frame_];
+}
 
-    const auto& buffer = buffer_->get_buffer();
-    auto* atlas = glyph_cache_->atlas();
-    auto render_limit = get_window_size().second / font_size.second - 1;
-    auto [t_cursor_x, t_cursor_y] = buffer_->get_cursor_pos();
-    if (t_cursor_y > (int)scroll_offset_ + render_limit - 1 && !is_scrolling_) {
-        scroll_offset_ += t_cursor_y - (scroll_offset_ + render_limit) + 1;
+bool Window::shift_frame_keys(PaneView& view, size_t top_line, int slots, int& from, int& to, int& kept) {
+    auto& frame_keys = view.frame_keys;
+    auto shift = frame_keys.empty() ? slots : static_cast<long long>(top_line) - static_cast<long long>(view.frame_top_line); // Rows the content moved up
+    view.frame_top_line = top_line;
+    kept = 0;
+    if (shift == 0 && static_cast<int>(frame_keys.size()) == slots) {
+        return false;
     }
-    for (int i = scroll_offset_; i < std::min((int)scroll_offset_ + render_limit, (int)buffer.size()); ++i) {
-        for (auto cell : buffer[i]) {
-            if (cell.codepoint == 0) cell.codepoint = ' ';
+    std::vector<uint64_t> moved_keys(slots, invalid_slot_key);
+    kept = std::min<long long>(slots, static_cast<long long>(frame_keys.size())) - std::abs(shift);
+    from = shift > 0 ? static_cast<int>(shift) : 0; // First kept slot in the old frame
+    to = shift > 0 ? 0 : static_cast<int>(-shift);
+    if (kept > 0) {
+        std::copy_n(frame_keys.begin() + from, kept, moved_keys.begin() + to);
+    }
+    frame_keys = std::move(moved_keys);
+    return true;
+}
+
+template <typename Draw>
+void Window::for_image_slots(const PaneView& view, bool keep_frame, Draw&& draw) const {
+    auto [font_w, font_h] = get_font_size();
+    const auto& rect = view.rect;
+    int slots = static_cast<int>(view.slot_keys.size());
+    for (const auto& placement : view.pane->buffer().get_images()) {
+        const auto* image = view.pane->image(placement.image);
+        if (!image) {
+            continue; // Still decoding, its rows are blank for now
+        }
+        auto first = static_cast<long long>(placement.line) - static_cast<long long>(view.frame_top_line);
+        SDL_Rect dest{rect.x + cursor_pos_.x + placement.col * font_w, rect.y + cursor_pos_.y + static_cast<int>(first) * font_h, image->width, image->height};
+        if (placement.fit) { // Kitty c= and r=
+            dest.w = placement.cols * font_w;
+            dest.h = placement.rows * font_h;
+        }
+        auto end = std::min<long long>(first + placement.rows, slots);
+        for (auto slot = std::max<long long>(first, 0); slot < end; ++slot) {
+            if (!keep_frame || view.frame_keys[slot] != view.slot_keys[slot]) {
+                draw(static_cast<int>(slot), dest, placement, *image);
+            }
+        }
+    }
+}
 
-            SDL_Rect src = glyph_cache_->get_or_create_glyph_pos(renderer_, font_, cell.codepoint);
-            SDL_Rect glyph_rect{cursor_pos_.x, cursor_pos_.y, src.w, src.h};
+void Window::draw_pane(PaneView& view, bool keep_frame, size_t& cells_drawn) {
+    auto font_h = get_font_size().second;
+    const auto& rows = view.pane->buffer().get_buffer();
+    const auto& rect = view.rect;
+    int text_width = std::clamp(rect.w - cursor_pos_.x, 0, width_); // Row textures are as wide as the window, a pane shows their left part
+    int slots = static_cast<int>(view.slot_keys.size());
+    for (int i = 0; i < slots; ++i) {
+        if (keep_frame && view.frame_keys[i] == view.slot_keys[i]) {
+            continue; // Already in the frame, possibly moved there by the scroll blit
+        }
+        ++rows_redrawn_;
+        SDL_Rect slot_rect{rect.x, rect.y + cursor_pos_.y + i * font_h, rect.w, font_h};
+        SDL_SetRenderDrawColor(renderer_, 0, 0, 0, 255);
+        SDL_RenderFillRect(renderer_, &slot_rect);
+        if (view.slot_keys[i] == empty_slot_key) {
+            continue;
+        }
+        const auto& row = rows[view.scroll_offset + i];
+        if (auto* texture = row_texture(row, view.slot_keys[i], cells_drawn)) {
+            SDL_Rect src{0, 0, text_width, font_h};
+            SDL_Rect row_rect{rect.x + cursor_pos_.x, slot_rect.y, text_width, font_h};
+            SDL_RenderCopy(renderer_, texture, &src, &row_rect);
+        } else { // Cache can't hold even one row
+            cells_drawn += row.size();
+            SDL_RenderSetClipRect(renderer_, &slot_rect); // Don't spill into the pane next to it
+            draw_row(row, rect.x + cursor_pos_.x, slot_rect.y);
+            SDL_RenderSetClipRect(renderer_, nullptr);
+        }
+    }
+    for_image_slots(view, keep_frame, [&](int slot, const SDL_Rect& dest, const ImagePlacement& placement, const DecodedImage& image) {
+        auto* texture = image_cache_.get(renderer_, (static_cast<uint64_t>(view.id) << 32) | placement.image, image);
+        if (!texture) {
+            return;
+        }
+        SDL_Rect slot_rect{rect.x, rect.y + cursor_pos_.y + slot * font_h, rect.w, font_h};
+        SDL_RenderSetClipRect(renderer_, &slot_rect); // Only the part of the slot, the rest of the image is in the frame already
+        SDL_RenderCopy(renderer_, texture, nullptr, &dest);
+    });
+    SDL_RenderSetClipRect(renderer_, nullptr);
+    std::swap(view.frame_keys, view.slot_keys);
+}
 
-            SDL_SetTextureColorMod(atlas, cell.fg_color.r, cell.fg_color.g, cell.fg_color.b);
+bool Window::prepare_framebuffer() {
+    if (framebuffer_ && rasterizer_->width() == width_ && rasterizer_->height() == height_) {
+        return true;
+    }
+    SDL_DestroyTexture(framebuffer_);
+    framebuffer_ = SDL_CreateTexture(renderer_, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, width_, height_);
+    for (auto& view : panes_) {
+        view.frame_keys.clear();
+    }
+    if (!framebuffer_) {
+        std::cerr << "Could not create framebuffer texture, drawing with the renderer: " << SDL_GetError() << std::endl;
+        rasterizer_.reset();
+        return false;
+    }
+    rasterizer_->resize(width_, height_);
+    return true;
+}
 
-            if (cell.bg_color != SDL_Color{0, 0, 0, 255}) { // Default background
-                SDL_SetRenderDrawColor(renderer_, cell.bg_color.r, cell.bg_color.g, cell.bg_color.b, cell.bg_color.a);
-                SDL_Rect glyph_rect{ cursor_pos_.x, cursor_pos_.y, src.w, src.h};
-                SDL_RenderFillRect(renderer_, &glyph_rect);
-                SDL_SetRenderDrawColor(renderer_, 0, 0, 0, 255);
+void Window::draw_software(bool moved, size_t& cells_drawn) {
+    TRACE_SCOPE("Window::draw_software");
+    auto font_h = get_font_size().second;
+    int first_damaged = height_, last_damaged = 0; // Pixel lines
+    for (auto& view : panes_) {
+        if (!view.redraw) {
+            continue;
+        }
+        const auto& rect = view.rect;
+        rasterizer_->set_clip(rect.x, rect.x + rect.w);
+        rasterizer_->set_origin(rect.x + cursor_pos_.x, rect.y + cursor_pos_.y);
+        if (view.moved && view.moved_kept <= 0) {
+            rasterizer_->fill(rect.x, rect.y, rect.w, rect.h, 0xFF000000u); // Nothing of the pane is kept, it may have been somewhere else before
+        }
+        if (view.moved_kept > 0) {
+            rasterizer_->move_rows(view.moved_from, view.moved_to, view.moved_kept);
+        }
+        const auto& rows = view.pane->buffer().get_buffer();
+        int slots = static_cast<int>(view.slot_keys.size());
+        for (int i = 0; i < slots; ++i) {
+            if (view.frame_keys[i] == view.slot_keys[i]) {
+                continue;
             }
-            if (cell.is_underline()) {
-                SDL_SetRenderDrawColor(renderer_, cell.fg_color.r, cell.fg_color.g, cell.fg_color.b, cell.fg_color.a);
-                SDL_RenderDrawLine(renderer_, cursor_pos_.x, cursor_pos_.y + src.h - src.h / 5, cursor_pos_.x + src.w, cursor_pos_.y + src.h - src.h / 5);
+            ++rows_redrawn_;
+            int y = rect.y + cursor_pos_.y + i * font_h;
+            first_damaged = std::min(first_damaged, y);
+            last_damaged = std::max(last_damaged, y + font_h);
+            if (view.slot_keys[i] == empty_slot_key) {
+                rasterizer_->clear_row(i);
+                continue;
             }
-            if (cell.is_bold()) {
-                SDL_SetTextureColorMod(atlas, 255, 255, 255);
+            const auto& row = rows[view.scroll_offset + i];
+            cells_drawn += row.size();
+            rasterizer_->draw_row(i, row);
+        }
+        for_image_slots(view, true, [&](int slot, const SDL_Rect& dest, const ImagePlacement&, const DecodedImage& image) {
+            int slot_y = rect.y + cursor_pos_.y + slot * font_h;
+            rasterizer_->draw_image(dest.x, dest.y, dest.w, dest.h, image.pixels.data(), image.width, image.height, slot_y, slot_y + font_h);
+        });
+        std::swap(view.frame_keys, view.slot_keys);
+    }
+    rasterizer_->set_clip(0, width_);
+
+    // Upload only the changed lines unless rows moved
+    if (moved) {
+        SDL_UpdateTexture(framebuffer_, nullptr, rasterizer_->pixels(), rasterizer_->pitch());
+    } else if (last_damaged > first_damaged) {
+        SDL_Rect rect{0, first_damaged, width_, std::min(last_damaged, height_) - first_damaged};
+        if (rect.h > 0) {
+            SDL_UpdateTexture(framebuffer_, &rect, rasterizer_->pixels() + static_cast<size_t>(rect.y) * width_, rasterizer_->pitch());
+        }
+    }
+    SDL_RenderCopy(renderer_, framebuffer_, nullptr, nullptr);
+}
+
+SDL_Texture* Window::row_texture(const std::vector<Cell>& row, uint64_t key, size_t& cells_drawn) {
+    if (auto* texture = row_cache_.find(key)) {
+        return texture;
+    }
+    auto* texture = row_cache_.create(renderer_, key);
+    if (!texture) {
+        return nullptr;
+    }
+    cells_drawn += row.size();
+    auto* previous_target = SDL_GetRenderTarget(renderer_);
+    SDL_SetRenderTarget(renderer_, texture);
+    SDL_SetRenderDrawColor(renderer_, 0, 0, 0, 255);
+    SDL_RenderClear(renderer_);
+    draw_row(row, 0, 0);
+    SDL_SetRenderTarget(renderer_, previous_target);
+    return texture;
+}
+
+void Window::draw_row(const std::vector<Cell>& row, int x, int y) {
+    constexpr uint16_t style_flags = 0b0111; // Underline, bold, strikethrough, not the wrap mark
+    size_t start = 0;
+    while (start < row.size()) {
+        // Runs of non-blank cells of one style. Spaces end them, so a word is shaped once wherever it shows up.
+        // Box drawing isn't shaped, it doesn't come from the font
+        auto style = row[start].flags & style_flags;
+        auto end = start;
+        while (end < row.size() && row[end].codepoint != 0 && row[end].codepoint != ' ' && !is_box_drawing(row[end].codepoint)
+               && (row[end].flags & style_flags) == style) {
+            ++end;
+        }
+        const ShapedRun* shaped = nullptr;
+        if (end - start >= 2) { // A single cell has nothing to ligate with
+            run_text_.clear();
+            for (auto i = start; i < end; ++i) {
+                run_text_.push_back(row[i].codepoint);
             }
-            if (cell.is_strikethrough()) {
-                SDL_SetRenderDrawColor(renderer_, 255, 255, 255, 255);
-                SDL_RenderDrawLine(renderer_, cursor_pos_.x, cursor_pos_.y + src.h / 2, cursor_pos_.x + src.w, cursor_pos_.y + src.h / 2);
+            shaped = font_->shape(run_text_, style);
+        }
+        if (shaped && !shaped->plain) {
+            draw_shaped_run(&row[start], *shaped, end - start, x, y);
+        } else {
+            for (auto i = start; i < std::max(end, start + 1); ++i) {
+                draw_cell(row[i], x, y);
             }
-
-            SDL_RenderCopy(renderer_, atlas, &src, &glyph_rect);
-            cursor_pos_.x += src.w;
         }
-        cursor_pos_.x = 10;
-        cursor_pos_.y += font_size.second;
+        start = std::max(end, start + 1);
     }
+}
 
-    SDL_Rect cursor_rect{t_cursor_x * font_size.first + font_size.first, (t_cursor_y - (int)scroll_offset_) * font_size.second + font_size.second / 2, font_size.first, font_size.second};
-    SDL_SetRenderDrawColor(renderer_, 255, 255, 255, 255);
-    SDL_RenderFillRect(renderer_, &cursor_rect);
-    SDL_RenderPresent(renderer_);
-    should_render_ = false;
+void Window::draw_cell(Cell cell, int& x, int y) {
+    if (cell.codepoint == 0) cell.codepoint = ' ';
+
+    SDL_Rect src = glyph_cache_->get_or_create_glyph_pos(renderer_, *font_, cell.codepoint);
+    auto* atlas = glyph_cache_->atlas(); // Adding a glyph may have reset the atlas
+    SDL_Rect glyph_rect{x, y, src.w, src.h};
+
+    SDL_SetTextureColorMod(atlas, cell.fg_color.r, cell.fg_color.g, cell.fg_color.b);
+
+    if (cell.bg_color != Color{0, 0, 0, 255}) { // Default background
+        SDL_SetRenderDrawColor(renderer_, cell.bg_color.r, cell.bg_color.g, cell.bg_color.b, cell.bg_color.a);
+        SDL_RenderFillRect(renderer_, &glyph_rect);
+        SDL_SetRenderDrawColor(renderer_, 0, 0, 0, 255);
+    }
+    if (cell.is_underline()) {
+        SDL_SetRenderDrawColor(renderer_, cell.fg_color.r, cell.fg_color.g, cell.fg_color.b, cell.fg_color.a);
+        SDL_RenderDrawLine(renderer_, x, y + src.h - src.h / 5, x + src.w, y + src.h - src.h / 5);
+    }
+    if (cell.is_bold()) {
+        SDL_SetTextureColorMod(atlas, 255, 255, 255);
+    }
+    if (cell.is_strikethrough()) {
+        SDL_SetRenderDrawColor(renderer_, 255, 255, 255, 255);
+        SDL_RenderDrawLine(renderer_, x, y + src.h / 2, x + src.w, y + src.h / 2);
+    }
+
+    SDL_RenderCopy(renderer_, atlas, &src, &glyph_rect);
+    x += src.w;
 }
 
-void Window::scroll(Sint32 dir) {
-    auto cursor_pos = buffer_->get_cursor_pos();
-    if (dir < 0) {
-        if (cursor_pos.second - scroll_offset_ + 1 < height_ / TTF_FontHeight(font_)) {
-            is_scrolling_ = false;
-            return;
+void Window::draw_shaped_run(const Cell* cells, const ShapedRun& run, size_t count, int& x, int y) {
+    auto [cell_w, cell_h] = font_size_;
+    // Backgrounds and lines first, a ligature may reach over several cells
+    for (size_t i = 0; i < count; ++i) {
+        const auto& cell = cells[i];
+        int cell_x = x + static_cast<int>(i) * cell_w;
+        if (cell.bg_color != Color{0, 0, 0, 255}) {
+            SDL_Rect rect{cell_x, y, cell_w, cell_h};
+            SDL_SetRenderDrawColor(renderer_, cell.bg_color.r, cell.bg_color.g, cell.bg_color.b, cell.bg_color.a);
+            SDL_RenderFillRect(renderer_, &rect);
         }
-        scroll_offset_ += scroll_step_;
-    } else if (dir > 0) {
-        if ((int)scroll_offset_ >= scroll_step_) {
-            scroll_offset_ -= scroll_step_;
-            is_scrolling_ = true;
+        if (cell.is_underline()) {
+            SDL_SetRenderDrawColor(renderer_, cell.fg_color.r, cell.fg_color.g, cell.fg_color.b, cell.fg_color.a);
+            SDL_RenderDrawLine(renderer_, cell_x, y + cell_h - cell_h / 5, cell_x + cell_w, y + cell_h - cell_h / 5);
+        }
+        if (cell.is_strikethrough()) {
+            SDL_SetRenderDrawColor(renderer_, 255, 255, 255, 255);
+            SDL_RenderDrawLine(renderer_, cell_x, y + cell_h / 2, cell_x + cell_w, y + cell_h / 2);
         }
     }
-    set_should_render(true);
+    SDL_SetRenderDrawColor(renderer_, 0, 0, 0, 255);
+
+    for (const auto& glyph : run.glyphs) {
+        auto key = glyph.glyph | FontFace::glyph_index_bit;
+        SDL_Rect src = glyph_cache_->get_or_create_glyph_pos(renderer_, *font_, key);
+        auto* atlas = glyph_cache_->atlas(); // Adding a glyph may have reset the atlas
+        const auto& cell = cells[std::min<size_t>(glyph.cell, count - 1)];
+        auto color = cell.is_bold() ? Color{255, 255, 255, 255} : cell.fg_color;
+        SDL_SetTextureColorMod(atlas, color.r, color.g, color.b);
+        SDL_Rect glyph_rect{x + glyph.cell * cell_w + glyph.x_offset + font_->glyph_offset(key), y + glyph.y_offset, src.w, src.h};
+        SDL_RenderCopy(renderer_, atlas, &src, &glyph_rect);
+    }
+    x += static_cast<int>(count) * cell_w;
+}
+
+void Window::draw_text(int x, int y, std::string_view text, Color color) {
+    auto* atlas = glyph_cache_->atlas();
+    SDL_SetTextureColorMod(atlas, color.r, color.g, color.b);
+    for (char c : text) {
+        auto codepoint = static_cast<uint32_t>(static_cast<unsigned char>(c));
+        auto src = glyph_cache_->get_glyph_pos(codepoint).value_or(SDL_Rect{});
+        if (src.w == 0) {
+            src = glyph_cache_->add_glyph(renderer_, *font_, codepoint);
+            atlas = glyph_cache_->atlas(); // Adding may have reset the atlas
+            SDL_SetTextureColorMod(atlas, color.r, color.g, color.b);
+        }
+        SDL_Rect dest{x, y, src.w, src.h};
+        SDL_RenderCopy(renderer_, atlas, &src, &dest);
+        x += src.w;
+    }
 }
 
-void Window::clear_buf(bool remove) {
-    if (remove) {
-        buffer_->clear_all();
-        set_scroll_offset(0);
+void Window::draw_hud(uint64_t frame_hits, uint64_t frame_misses) {
+    constexpr int hud_cols = 44;
+    constexpr int text_lines = 8;
+    constexpr int bar_lines = 3;
+    auto [font_w, font_h] = get_font_size();
+    auto [win_w, win_h] = get_window_size();
+    SDL_Rect box{std::max(0, win_w - (hud_cols + 1) * font_w), font_h / 2, hud_cols * font_w, (text_lines + bar_lines + 2) * font_h};
+
+    SDL_SetRenderDrawBlendMode(renderer_, SDL_BLENDMODE_BLEND);
+    SDL_SetRenderDrawColor(renderer_, 20, 20, 20, 220);
+    SDL_RenderFillRect(renderer_, &box);
+    SDL_SetRenderDrawBlendMode(renderer_, SDL_BLENDMODE_NONE);
+
+    auto glyph_lookups = frame_hits + frame_misses;
+    auto row_lookups = row_cache_.get_hits() + row_cache_.get_misses();
+    char line[text_lines][128];
+    std::snprintf(line[0], sizeof(line[0]), "fps %.0f  frame %.2f ms  worst %.2f ms", stats_.get_fps(), stats_.get_last_frame_ms(), stats_.get_max_frame_ms());
+    std::snprintf(line[1], sizeof(line[1]), "pty %.2f MB/s  parse %.2f ms/frame", stats_.get_bytes_per_second() / (1024 * 1024), stats_.get_last_parse_ms());
+    std::snprintf(line[2], sizeof(line[2]), "cells %zu/frame  panes %zu", stats_.get_cells_drawn(), panes_.size());
+    std::snprintf(line[3], sizeof(line[3]), "glyphs %.1f%% hit  %zu cached  atlas %.1f%%",
+                  glyph_lookups ? 100.0 * frame_hits / glyph_lookups : 100.0, glyph_cache_->glyph_count(), 100.0 * glyph_cache_->atlas_occupancy());
+    const auto& buffer = focused_pane().buffer();
+    std::snprintf(line[4], sizeof(line[4]), "scrollback %zu lines  evicted %zu", buffer.get_scrollback_lines(), buffer.get_evicted_lines());
+    std::snprintf(line[5], sizeof(line[5]), "buffer %.1f MB", buffer.memory_usage() / (1024.0 * 1024.0));
+    std::snprintf(line[7], sizeof(line[7]), "rows %d redrawn  %zu cached %.1f MB  %.1f%% hit", rows_redrawn_, row_cache_.size(), row_cache_.memory_usage() / (1024.0 * 1024.0),
+                  row_lookups ? 100.0 * row_cache_.get_hits() / row_lookups : 100.0);
+    if (latency_) {
+        std::snprintf(line[6], sizeof(line[6]), "key latency p50 %.1f ms  p99 %.1f ms", latency_->percentile(0.5), latency_->percentile(0.99));
     } else {
-        auto [x, y] = get_cursor_pos();
-        buffer_->set_cursor_position(buffer_->get_max_y() + 1, x);
-        set_scroll_offset(buffer_->get_max_y());
+        line[6][0] = '\0';
+    }
+
+    int x = box.x + font_w / 2;
+    int y = box.y + font_h / 2;
+    for (const auto& text : line) {
+        draw_text(x, y, text, Color{220, 220, 220, 255});
+        y += font_h;
+    }
+
+    // Frame time histogram, one bar per bucket with its upper bound under it
+    static constexpr const char* labels[] = {"<2", "<4", "<8", "<17", "<33", "<67", "more"};
+    const auto& histogram = stats_.get_frame_histogram();
+    auto most = std::max<uint32_t>(1, *std::max_element(histogram.begin(), histogram.end()));
+    int bar_width = 5 * font_w;
+    for (size_t i = 0; i < histogram.size(); ++i) {
+        int height = static_cast<int>(static_cast<uint64_t>(histogram[i]) * bar_lines * font_h / most);
+        int bar_x = x + static_cast<int>(i) * (bar_width + font_w);
+        SDL_Rect bar{bar_x, y + bar_lines * font_h - height, bar_width, height};
+        SDL_SetRenderDrawColor(renderer_, i < 4 ? 80 : 220, i < 4 ? 200 : 90, 80, 255); // Red past 16.7 ms
+        SDL_RenderFillRect(renderer_, &bar);
+        draw_text(bar_x, y + bar_lines * font_h, labels[i], Color{160, 160, 160, 255});
+    }
+    SDL_SetRenderDrawColor(renderer_, 0, 0, 0, 255);
+}
+
+Window::PaneView* Window::find_pane(int id) {
+    auto iter = std::find_if(panes_.begin(), panes_.end(), [id](const PaneView& view) { return view.id == id; });
+    return iter == panes_.end() ? nullptr : &*iter;
+}
+
+Pane& Window::open_pane(int pty_fd, PaneLayout::Split direction) {
+    int id = next_pane_id_++;
+    bool first = !layout_;
+    if (first) {
+        layout_.emplace(id);
+    } else {
+        layout_->split(focused_pane_, id, direction);
+    }
+    PaneRect rect{0, 0, width_, height_};
+    for (const auto& [pane_id, pane_rect] : layout_->layout({0, 0, width_, height_}, pane_gap)) {
+        if (pane_id == id) {
+            rect = pane_rect;
+        }
+    }
+
+    std::unique_ptr<Pane> pane;
+    try {
+        pane = std::make_unique<Pane>(rect.w, rect.h, get_font_size(), pty_fd);
+    } catch (...) {
+        if (pty_fd >= 0) {
+            close(pty_fd);
+        }
+        if (first) {
+            layout_.reset();
+        } else {
+            layout_->remove(id);
+        }
+        throw;
+    }
+    pane->buffer().set_scrollback_limit(scrollback_limit_);
+    panes_.push_back(PaneView{id, std::move(pane), rect});
+    focus_pane(panes_.back());
+    layout_panes(); // The one that was split shrinks
+    return *panes_.back().pane;
+}
+
+void Window::close_pane(const Pane& pane) {
+    auto iter = std::find_if(panes_.begin(), panes_.end(), [&pane](const PaneView& view) { return view.pane.get() == &pane; });
+    if (iter == panes_.end()) {
+        return;
+    }
+    int id = iter->id;
+    int next = layout_->remove(id);
+    panes_.erase(iter);
+    if (panes_.empty()) {
+        layout_.reset();
+        focused_pane_ = -1;
+        return;
+    }
+    if (focused_pane_ == id) {
+        focus_pane(*find_pane(next));
+    }
+    layout_panes();
+}
+
+void Window::layout_panes() {
+    if (!layout_) {
+        return;
+    }
+    auto font_size = get_font_size();
+    for (const auto& [id, rect] : layout_->layout({0, 0, width_, height_}, pane_gap)) {
+        auto* view = find_pane(id);
+        if (!view || view->rect == rect) {
+            continue;
+        }
+        view->rect = rect;
+        view->pane->resize(rect.w, rect.h, font_size);
+        view->frame_keys.clear(); // What the frame has there belongs to the old layout
+        view->damaged = true;
     }
     set_should_render(true);
 }
 
-std::pair<int, int> Window::get_cursor_pos() const {
-    return buffer_->get_cursor_pos();
+void Window::focus_pane(PaneView& view) {
+    if (focused_pane_ == view.id) {
+        return;
+    }
+    if (auto* previous = find_pane(focused_pane_)) {
+        previous->pane->buffer().remove_selection(); // Selection follows the focus
+        previous->damaged = true;
+    }
+    reset_selection();
+    focused_pane_ = view.id;
+    view.damaged = true;
+    if (!view.title.empty()) {
+        set_window_title(view.title);
+    }
+    set_should_render(true); // The cursor moves
+}
+
+Pane& Window::focused_pane() {
+    return *find_pane(focused_pane_)->pane;
+}
+
+void Window::focus_next_pane() {
+    if (!layout_) {
+        return;
+    }
+    auto order = layout_->layout({0, 0, width_, height_}, pane_gap); // Left to right, top to bottom
+    auto iter = std::find_if(order.begin(), order.end(), [this](const auto& entry) { return entry.first == focused_pane_; });
+    auto next = iter == order.end() || std::next(iter) == order.end() ? order.begin() : std::next(iter);
+    if (auto* view = find_pane(next->first)) {
+        focus_pane(*view);
+    }
+}
+
+void Window::focus_pane_at(int x, int y) {
+    for (auto& view : panes_) {
+        if (view.rect.contains(x, y)) {
+            focus_pane(view);
+            return;
+        }
+    }
+}
+
+void Window::preload_glyphs(uint32_t first, uint32_t last) {
+    TRACE_SCOPE("Window::preload_glyphs");
+    if (rasterizer_) {
+        return; // The software renderer uses the masks of the face directly
+    }
+    for (auto codepoint = first; codepoint <= last; ++codepoint) {
+        glyph_cache_->get_or_create_glyph_pos(renderer_, *font_, codepoint);
+    }
+}
+
+void Window::draw_cursor() {
+    auto* view = find_pane(focused_pane_);
+    if (!view) {
+        return;
+    }
+    auto [font_w, font_h] = get_font_size();
+    auto [cursor_x, cursor_y] = view->pane->buffer().get_cursor_pos();
+    SDL_Rect cursor_rect{view->rect.x + cursor_x * font_w + font_w, view->rect.y + (cursor_y - (int)view->scroll_offset) * font_h + font_h / 2, font_w, font_h};
+    SDL_Rect pane_rect{view->rect.x, view->rect.y, view->rect.w, view->rect.h};
+    SDL_Rect visible;
+    if (!SDL_IntersectRect(&cursor_rect, &pane_rect, &visible)) {
+        return; // Scrolled away
+    }
+    SDL_SetRenderDrawColor(renderer_, 255, 255, 255, 255);
+    SDL_RenderFillRect(renderer_, &visible);
+}
+
+void Window::draw_dividers() {
+    if (panes_.size() < 2) {
+        return;
+    }
+    SDL_SetRenderDrawColor(renderer_, 80, 80, 80, 255);
+    for (const auto& divider : layout_->dividers({0, 0, width_, height_}, pane_gap)) {
+        SDL_Rect rect{divider.x, divider.y, divider.w, divider.h};
+        SDL_RenderFillRect(renderer_, &rect);
+    }
+}
+
+void Window::scroll(Sint32 dir) {
+    auto* view = find_pane(focused_pane_);
+    if (!view) {
+        return;
+    }
+    auto cursor_pos = view->pane->buffer().get_cursor_pos();
+    if (dir < 0) {
+        if (cursor_pos.second - view->scroll_offset + 1 < view->rect.h / font_->height()) {
+            view->is_scrolling = false;
+            return;
+        }
+        view->scroll_offset += scroll_step_;
+    } else if (dir > 0) {
+        if ((int)view->scroll_offset >= scroll_step_) {
+            view->scroll_offset -= scroll_step_;
+            view->is_scrolling = true;
+        }
+    }
+    view->damaged = true;
+    set_should_render(true);
 }
 
 void Window::on_selection(int x, int y) {
@@ -192,59 +830,81 @@ void Window::reset_selection() {
 }
 
 void Window::set_selection(int start_x, int start_y, int end_x, int end_y) {
-    buffer_->set_selection(start_x, start_y, end_x, end_y, get_scroll_offset());
+    auto* view = find_pane(focused_pane_);
+    if (!view) {
+        return;
+    }
+    const auto& rect = view->rect; // The buffer counts cells from the corner of the pane
+    view->pane->buffer().set_selection(start_x - rect.x, start_y - rect.y, end_x - rect.x, end_y - rect.y, view->scroll_offset);
+    view->damaged = true;
     set_should_render(true);
 }
 
 void Window::remove_selection() {
-    buffer_->remove_selection();
+    auto* view = find_pane(focused_pane_);
+    if (!view) {
+        return;
+    }
+    view->pane->buffer().remove_selection();
+    view->damaged = true;
     set_should_render(true);
 }
 
-void Window::erase_at_end() {
-    buffer_->erase_last_symbol();
+void Window::set_image_cache_limit(size_t bytes) {
+    image_cache_.set_budget(bytes);
 }
 
-void Window::set_cursor(int row, int col) {
-    buffer_->set_cursor_position(row, col);
-}
-
-void Window::move_cursor(int row, int col) {
-    buffer_->move_cursor_pos_relative(row, col);
+void Window::set_scrollback_limit(size_t lines) {
+    scrollback_limit_ = lines;
+    for (auto& view : panes_) {
+        view.pane->buffer().set_scrollback_limit(lines);
+    }
 }
 
-void Window::add_cells(std::vector<Cell>&& cells) {
-    buffer_->add_cells(std::move(cells));
+bool Window::is_bracketed_paste() const {
+    auto iter = std::find_if(panes_.begin(), panes_.end(), [this](const PaneView& view) { return view.id == focused_pane_; });
+    return iter != panes_.end() && iter->pane->buffer().is_bracketed_paste();
 }
 
-void Window::reset_cursor(bool x_dir, bool y_dir) {
-    buffer_->reset_cursor(x_dir, y_dir);
+std::string Window::get_selected_text() const {
+    auto iter = std::find_if(panes_.begin(), panes_.end(), [this](const PaneView& view) { return view.id == focused_pane_; });
+    return iter == panes_.end() ? std::string{} : iter->pane->buffer().get_selected_text();
 }
 
-void Window::erase_in_line(int mode) {
-    buffer_->erase_in_line(mode);
+void Window::write_selected_text(const SelectionExporter::Sink& sink) const {
+    auto iter = std::find_if(panes_.begin(), panes_.end(), [this](const PaneView& view) { return view.id == focused_pane_; });
+    if (iter != panes_.end()) {
+        iter->pane->buffer().write_selected_text(sink);
+    }
 }
 
-void Window::insert_chars(int n) {
-    buffer_->insert_chars(n);
+void Window::resize() {
+    SDL_GetWindowSize(window_, &width_, &height_);
+    layout_panes();
 }
 
-void Window::delete_chars(int n) {
-    buffer_->delete_chars(n);
+void Window::resize_to_grid(int cols, int rows) {
+    auto [cell_width, cell_height] = get_font_size();
+    // TermBuffer::resize grows one column past the width it's given and leaves a row of spare pixels
+    int old_cols = panes_.empty() ? cols : panes_.front().pane->buffer().get_screen_size().first;
+    SDL_SetWindowSize(window_, (cols > old_cols ? cols - 1 : cols) * cell_width, (rows + 1) * cell_height);
+    resize();
 }
 
-std::string Window::get_selected_text() const {
-    return buffer_->get_selected_text();
+void Window::on_render_targets_reset() {
+    row_cache_.clear();
+    for (auto& view : panes_) {
+        view.frame_keys.clear(); // Frame textures are garbage now
+    }
+    SDL_DestroyTexture(framebuffer_); // Lost too on a device reset
+    framebuffer_ = nullptr;
+    image_cache_.clear();
+    glyph_cache_->invalidate(renderer_);
+    set_should_render(true);
 }
 
-void Window::resize() {
-    auto dim = get_window_size();
-    height_ = dim.second;
-    width_ = dim.first;
-
-    auto font_size = get_font_size();
-    buffer_->resize(dim, font_size);
-    set_should_render(true);
+uint32_t Window::get_window_id() const {
+    return SDL_GetWindowID(window_);
 }
 
 void Window::set_window_title(const std::string& win_title) {
@@ -1,6 +1,10 @@
 #pragma once
 #include <cstdint>
+#include <future>
 #include <memory>
+#include <optional>
+#include <string>
+#include <vector>
 #include <sys/types.h>
 #include <SDL2/SDL_error.h>
 #include <SDL2/SDL_events.h>
@@ -16,7 +20,16 @@
 #include <SDL2/SDL_ttf.h>
 #include <utility>
 #include "Buffer.hpp"
+#include "FontFace.hpp"
 #include "GlyphCache.hpp"
+#include "ImageCache.hpp"
+#include "Pane.hpp"
+#include "PaneLayout.hpp"
+#include "RowCache.hpp"
+#include "SoftwareRasterizer.hpp"
+#include "PerfStats.hpp"
+#include "LatencyTracker.hpp"
+#include <string_view>
 #include <unicode/uchar.h>
 
 // echo -e "\033[48;5;2m Test Backgroundsdasd \033[0m"
@@ -39,11 +52,10 @@ struct CursorPos {
 
 class Window {
 private:
-    int width_; int height_;
-    int font_ptsize_;
+    int width_; int height_; // Updated by resize()
+    std::pair<int, int> font_size_{0, 0}; // Of a cell
     // Helper stuff
-    uint scroll_offset_{0};
-    CursorPos cursor_pos_;
+    CursorPos cursor_pos_; // Of the text in a pane, relative to its corner
     uint curs_char_idx_;
 
     // Selection stuff
@@ -56,9 +68,14 @@ private:
     int8_t scroll_step_{2};
 
     bool is_running_{true};
-    bool is_scrolling_{false};
     bool should_render_{true};
 
+    // Performance HUD
+    bool show_hud_{false};
+    PerfStats stats_;
+    PerfStats::Clock::time_point last_draw_{};
+    const LatencyTracker* latency_{nullptr}; // Shown in the HUD if set
+
     // Smth else like glyph cache
 
 
@@ -67,37 +84,98 @@ private:
     SDL_Renderer* renderer_{nullptr};
 
 
-    std::unique_ptr<TermBuffer> buffer_;
+    // Panes, each with its own pty, parser and grid. All of them are drawn in one pass into one frame with the glyph and row caches shared
+    struct PaneView {
+        int id{0};
+        std::unique_ptr<Pane> pane{};
+        PaneRect rect{}; // In the window
+        std::string title{}; // Last one the application set, shown while the pane has focus
+        uint scroll_offset{0};
+        size_t seen_evicted_lines{0}; // Scrollback eviction shifts rows up, scroll_offset has to follow
+        bool is_scrolling{false};
+        bool damaged{true}; // Scrolled, selected or moved since the last frame. Otherwise only new output makes the pane redraw
+
+        // Where the pane is in the frame textures
+        std::vector<uint64_t> frame_keys{}; // row_hash of what each slot of the current frame shows
+        size_t frame_top_line{0}; // Absolute line (evicted lines included) in the first slot
+        std::vector<uint64_t> slot_keys{}; // What the slots should show now, only valid for panes redrawn this frame
+        bool redraw{false}; // Has to be looked at this frame
+        bool moved{false}; // Content shifted in the frame, see shift_frame_keys
+        int moved_from{0}, moved_to{0}, moved_kept{0};
+    };
+    std::vector<PaneView> panes_;
+    std::optional<PaneLayout> layout_; // Empty until the first pane is opened
+    int focused_pane_{-1}; // Id
+    int next_pane_id_{0};
+    size_t scrollback_limit_{10000};
+    static constexpr int pane_gap = 2; // Pixels between panes, a separator is drawn there
+
     std::unique_ptr<GlyphCache> glyph_cache_;
+    RowCache row_cache_;
+    ImageCache image_cache_{128 * 1024 * 1024}; // Keyed by pane id and image id
+    std::shared_ptr<FontFace> font_; // Shared with other windows of the process
+    std::u32string run_text_; // Of the run being shaped
+
+    // Last frame, kept so scrolling is a blit plus the newly exposed rows. Two textures since a texture can't be copied onto itself
+    static constexpr uint64_t empty_slot_key = 0; // Slot below the last row
+    static constexpr uint64_t invalid_slot_key = ~0ull; // Slot with nothing usable in the frame texture
+    SDL_Texture* frames_[2]{nullptr, nullptr};
+    int current_frame_{0};
+    std::pair<int, int> frame_size_{0, 0};
+    int rows_redrawn_{0};
+    bool held_panes_{false}; // Some pane was left as it was this frame, in the middle of a synchronized update
+
+    // Software rendering: rows are rasterized on the CPU into one framebuffer, uploaded to a streaming texture
+    std::unique_ptr<SoftwareRasterizer> rasterizer_; // nullptr when drawing on the GPU
+    SDL_Texture* framebuffer_{nullptr};
 
 public:
-    TTF_Font* font_{nullptr}; // temp
-    explicit Window(const std::string& font_path, int font_ptsize, int width, int height);
+    // The font may still be loading on another thread, it's only waited for once the SDL window and renderer are up
+    explicit Window(std::future<std::shared_ptr<FontFace>> font, int width, int height, size_t row_cache_bytes = 64 * 1024 * 1024, bool software_renderer = false);
     ~Window();
 
     // void draw(const TermBuffer& term_buffer);
-    void draw();
+    bool draw(); // Returns false if there was nothing new to present
+    bool needs_render() const;
     void set_should_render(bool value);
+    void toggle_hud();
+    PerfStats& stats() {
+        return stats_;
+    }
+    void set_latency_tracker(const LatencyTracker* latency) {
+        latency_ = latency;
+    }
 
     std::pair<int, int> get_max_texture_size() const;
     std::pair<int, int> get_font_size() const;
+    int get_refresh_rate() const; // Of the display the window is on, 0 if unknown
 
     // void scroll(Sint32 dir, std::pair<int, int> cursor_pos, int max_y);
-    void scroll(Sint32 dir);
+    void scroll(Sint32 dir); // Of the focused pane
     void resize();
+    void resize_to_grid(int cols, int rows); // Window size that gives a single pane that grid, for replays
 
     void set_window_title(const std::string& win_title);
-    void set_scroll_offset(int n) {
-        scroll_offset_ = n;
+    uint32_t get_window_id() const; // SDL window id, to route events when a process has several windows
+    void on_render_targets_reset(); // Contents of target textures are gone, the caches have to be rebuilt
+
+    // Panes. The first one fills the window, later ones take half of the focused pane and get focus
+    // Takes over pty_fd (see Pane::spawn_shell), -1 for a pane without a shell
+    Pane& open_pane(int pty_fd, PaneLayout::Split direction = PaneLayout::Split::SideBySide);
+    void close_pane(const Pane& pane); // Its sibling takes the space
+    size_t pane_count() const {
+        return panes_.size();
     }
-    int get_scroll_offset() const {
-        return scroll_offset_;
+    Pane& get_pane(size_t index) {
+        return *panes_[index].pane;
     }
+    Pane& focused_pane();
+    void focus_next_pane();
+    void focus_pane_at(int x, int y); // Pane under the mouse
+    void preload_glyphs(uint32_t first, uint32_t last); // Into the atlas before anything is drawn, e.g. while the shell starts
 
-    const std::pair<int, int> get_window_size() {
-        int w, h;
-        SDL_GetWindowSize(window_, &w, &h);
-        return {w, h};
+    const std::pair<int, int> get_window_size() const {
+        return {width_, height_};
     }
 
     // Selection tracking
@@ -105,21 +183,42 @@ public:
     void on_remove_selection();
     void reset_selection();
 
-    // Buffer stuff
-    void clear_buf(bool remove = false);
+    // Buffer stuff, of the focused pane
     void set_selection(int start_x, int start_y, int end_x, int end_y);
     void remove_selection();
-    void erase_at_end();
-    void set_cursor(int row, int col);
-    void move_cursor(int row, int col);
-    void reset_cursor(bool x_dir, bool y_dir);
-    std::pair<int, int> get_cursor_pos() const;
-    void add_cells(std::vector<Cell>&& cells);
-    void erase_in_line(int mode);
-    void insert_chars(int n);
-    void delete_chars(int n);
+    void set_scrollback_limit(size_t lines); // For all panes
+    void set_image_cache_limit(size_t bytes);
+    bool is_bracketed_paste() const;
     std::string get_selected_text() const;
+    void write_selected_text(const SelectionExporter::Sink& sink) const;
 private:
-    void load_font(const std::string& font_path);
-    void init();
+    bool init(bool software_renderer); // Returns true if rendering is done on the CPU, also when there is no accelerated renderer
+
+    PaneView* find_pane(int id);
+    void focus_pane(PaneView& view);
+    void layout_panes(); // Gives every pane its area, resizing those that changed
+    // Works out what the slots of a pane should show into slot_keys. Returns false if it's idle, nothing is hashed then
+    bool plan_pane(PaneView& view, bool force);
+    int pane_slots(const PaneView& view) const;
+
+    bool prepare_frame_textures(); // false if target textures aren't available, then everything is drawn to the screen
+    // Sets the render target to a frame texture that already shows whatever of the last frame is still valid, frame_keys tell what
+    SDL_Texture* begin_frame(bool moved);
+    // Moves the frame keys of a pane along with the content for a new top line. Returns false if nothing moved,
+    // otherwise kept slots starting at from in the old frame are now at to, and everything else is invalid
+    bool shift_frame_keys(PaneView& view, size_t top_line, int slots, int& from, int& to, int& kept);
+    void draw_pane(PaneView& view, bool keep_frame, size_t& cells_drawn); // Rows that changed, or all of them without a kept frame
+    // Calls draw(slot, dest, placement, image) with the pixel rect of the image for every slot redrawn this frame that an image of the pane covers
+    template <typename Draw>
+    void for_image_slots(const PaneView& view, bool keep_frame, Draw&& draw) const;
+    bool prepare_framebuffer(); // false if the framebuffer isn't usable, the renderer draws then
+    void draw_software(bool moved, size_t& cells_drawn);
+    SDL_Texture* row_texture(const std::vector<Cell>& row, uint64_t key, size_t& cells_drawn); // From the row cache, rendered on a miss
+    void draw_row(const std::vector<Cell>& row, int x, int y);
+    void draw_cell(Cell cell, int& x, int y);
+    void draw_shaped_run(const Cell* cells, const ShapedRun& run, size_t count, int& x, int y); // Shaped glyphs over count cells
+    void draw_cursor();
+    void draw_dividers();
+    void draw_hud(uint64_t frame_hits, uint64_t frame_misses);
+    void draw_text(int x, int y, std::string_view text, Color color); // ASCII only, doesn't count in glyph stats
 };
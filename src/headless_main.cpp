@@ -0,0 +1,101 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "Headless.hpp"
+#include "SessionRecording.hpp"
+#include "Trace.hpp"
+
+// kemul_headless: runs the emulation core over a byte stream and prints the resulting screen.
+// Usage: kemul_headless [--cols N] [--rows N] [--snapshot] [--scrollback] [--no-fast-forward] [--replay] [--trace FILE] [file]
+// With --replay the input is a recording made with proj --record, fed with its original read boundaries
+int main(int argc, char** argv) {
+    int cols = 80;
+    int rows = 24;
+    bool snapshot = false;
+    bool with_scrollback = false;
+    bool fast_forward = true;
+    bool replay = false;
+    const char* input_path = nullptr;
+    const char* trace_path = nullptr;
+
+    for (auto i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--cols") == 0 && i + 1 < argc) {
+            cols = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--rows") == 0 && i + 1 < argc) {
+            rows = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--snapshot") == 0) {
+            snapshot = true;
+        } else if (std::strcmp(argv[i], "--scrollback") == 0) {
+            with_scrollback = true;
+        } else if (std::strcmp(argv[i], "--no-fast-forward") == 0) {
+            fast_forward = false;
+        } else if (std::strcmp(argv[i], "--replay") == 0) {
+            replay = true;
+        } else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            trace_path = argv[++i];
+            Tracer::enable();
+        } else if (argv[i][0] != '-') {
+            input_path = argv[i];
+        } else {
+            std::cerr << "Unknown option " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+
+    HeadlessTerminal terminal{cols, rows};
+    terminal.set_fast_forward(fast_forward);
+
+    if (replay) {
+        if (!input_path) {
+            std::cerr << "--replay needs a file" << std::endl;
+            return 1;
+        }
+        try {
+            SessionReader reader{input_path};
+            if (reader.cols() > 0 && reader.rows() > 0) {
+                terminal.resize(reader.cols(), reader.rows()); // The size it was recorded at wins over --cols and --rows
+            }
+            RecordedChunk chunk;
+            while (reader.next(chunk)) {
+                if (chunk.is_resize) {
+                    terminal.resize(chunk.cols, chunk.rows);
+                } else {
+                    terminal.feed(chunk.bytes);
+                }
+            }
+        } catch (const std::exception& ex) {
+            std::cerr << ex.what() << std::endl;
+            return 1;
+        }
+    }
+
+    std::ifstream file;
+    if (input_path && !replay) {
+        file.open(input_path, std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "Could not open " << input_path << std::endl;
+            return 1;
+        }
+    }
+    std::istream& input = input_path ? file : std::cin;
+
+    std::vector<char> buf(4 * 1024 * 1024); // Big chunks give fast-forward something to skip
+    while (!replay && (input.read(buf.data(), buf.size()) || input.gcount() > 0)) {
+        terminal.feed(std::string_view{buf.data(), static_cast<size_t>(input.gcount())});
+    }
+
+    if (snapshot) {
+        terminal.write_snapshot(std::cout);
+    } else {
+        std::cout << terminal.dump_text(with_scrollback);
+    }
+    if (trace_path && !Tracer::write(trace_path)) {
+        std::cerr << "Could not write trace to " << trace_path << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -13,6 +13,7 @@
 #include <SDL2/SDL_ttf.h>
 #include <cstdlib>
 #include <filesystem>
+#include <iostream>
 #include <string>
 #include <sys/poll.h>
 #include <sys/types.h>
@@ -24,15 +25,60 @@
 #include <utf8cpp/utf8/checked.h>
 #include <utf8cpp/utf8/cpp11.h>
 #include "Application.hpp"
+#include "Server.hpp"
+#include "Trace.hpp"
 #include <unistd.h>
 
 int main(int argc, char** argv) {
+    LaunchOptions options; // Takes the launch time first thing
     auto appdata_path = std::filesystem::path(std::getenv("HOME")) / ".local/share/kemul";
     if (!std::filesystem::exists(appdata_path)) {
         std::filesystem::create_directory(appdata_path);
     }
 
-    Application app{"FiraCode-Regular.ttf"};
+    bool server = false;
+    bool new_window = false;
+    for (auto i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--record" && i + 1 < argc) {
+            options.record_path = argv[++i];
+        } else if (arg == "--replay" && i + 1 < argc) {
+            options.replay_path = argv[++i];
+        } else if (arg == "--realtime") {
+            options.replay_realtime = true;
+        } else if (arg == "--trace" && i + 1 < argc) {
+            options.trace_path = argv[++i];
+        } else if (arg == "--server") {
+            server = true;
+        } else if (arg == "--new-window") {
+            new_window = true;
+        } else if (arg == "--bench-startup") {
+            options.bench_startup = true;
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--record FILE] [--replay FILE [--realtime]] [--trace FILE] [--bench-startup] [--server | --new-window]" << std::endl;
+            return 1;
+        }
+    }
+
+    if (new_window && Server::request_window()) {
+        return 0; // The server opened it. Without a server this process becomes a normal terminal
+    }
+    if (server) {
+        if (!options.trace_path.empty()) {
+            Tracer::enable();
+        }
+        {
+            Server server_instance;
+            server_instance.run();
+        }
+        if (!options.trace_path.empty()) {
+            Tracer::write(options.trace_path);
+        }
+        SDL_Quit();
+        return 0;
+    }
+
+    Application app{options};
     app.run();
     SDL_Quit(); // Can't move it inside Application
     return 0;
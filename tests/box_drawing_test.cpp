@@ -0,0 +1,51 @@
+#include <gtest/gtest.h>
+#include "../src/BoxDrawing.hpp"
+
+namespace {
+uint8_t at(const GlyphMask& mask, int x, int y) {
+    return mask.alpha[static_cast<size_t>(y) * mask.width + x];
+}
+}
+
+TEST(BoxDrawingTest, OnlyBoxAndBlockCodepoints) {
+    ASSERT_FALSE(box_glyph('-', 10, 20));
+    ASSERT_FALSE(box_glyph(0x24FF, 10, 20));
+    ASSERT_FALSE(box_glyph(0x25A0, 10, 20));
+    for (uint32_t codepoint = 0x2500; codepoint <= 0x259F; ++codepoint) {
+        auto mask = box_glyph(codepoint, 10, 20);
+        ASSERT_TRUE(mask) << std::hex << codepoint;
+        ASSERT_EQ(mask->width, 10);
+        ASSERT_EQ(mask->height, 20);
+    }
+}
+
+TEST(BoxDrawingTest, LinesJoinNeighbourCells) {
+    auto horizontal = *box_glyph(0x2500, 9, 17); // ─
+    auto corner = *box_glyph(0x2510, 9, 17); // ┐
+    auto vertical = *box_glyph(0x2502, 9, 17); // │
+    for (int y = 0; y < 17; ++y) {
+        // The line runs from edge to edge and meets the arm of the corner on the same pixel rows
+        ASSERT_EQ(at(horizontal, 0, y), at(horizontal, 8, y));
+        ASSERT_EQ(at(horizontal, 8, y), at(corner, 0, y));
+    }
+    for (int x = 0; x < 9; ++x) {
+        ASSERT_EQ(at(vertical, x, 0), at(vertical, x, 16));
+        ASSERT_EQ(at(corner, x, 16), at(vertical, x, 0)); // The corner goes on down into the line below
+    }
+    ASSERT_EQ(at(corner, 8, 0), 0);
+}
+
+TEST(BoxDrawingTest, BlocksFillTheirPart) {
+    auto full = *box_glyph(0x2588, 8, 16);
+    for (auto alpha : full.alpha) {
+        ASSERT_EQ(alpha, 255);
+    }
+    auto lower_half = *box_glyph(0x2584, 8, 16);
+    ASSERT_EQ(at(lower_half, 0, 7), 0);
+    ASSERT_EQ(at(lower_half, 7, 8), 255);
+    auto quadrants = *box_glyph(0x259A, 8, 16); // ▚ upper left and lower right
+    ASSERT_EQ(at(quadrants, 0, 0), 255);
+    ASSERT_EQ(at(quadrants, 7, 0), 0);
+    ASSERT_EQ(at(quadrants, 0, 15), 0);
+    ASSERT_EQ(at(quadrants, 7, 15), 255);
+}
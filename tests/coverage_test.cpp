@@ -0,0 +1,46 @@
+#include <gtest/gtest.h>
+#include "../src/FontCoverage.hpp"
+#include <filesystem>
+#include <fstream>
+
+TEST(CoverageTest, SetsAndTestsBits) {
+    FontCoverage coverage;
+    coverage.set('A');
+    coverage.set(0x1F600);
+    coverage.set(0x10FFFF);
+    coverage.set(0x110000); // Past Unicode, ignored
+    ASSERT_TRUE(coverage.test('A'));
+    ASSERT_TRUE(coverage.test(0x1F600));
+    ASSERT_TRUE(coverage.test(0x10FFFF));
+    ASSERT_FALSE(coverage.test('B'));
+    ASSERT_FALSE(coverage.test(0x110000));
+    ASSERT_EQ(coverage.count(), 3);
+}
+
+TEST(CoverageTest, BuildsOnceThenLoadsFromCache) {
+    auto dir = std::filesystem::temp_directory_path() / "kemul_coverage_test";
+    std::filesystem::remove_all(dir);
+    auto font = std::filesystem::temp_directory_path() / "kemul_coverage_test.ttf";
+    std::ofstream{font} << "not really a font";
+
+    int probes = 0;
+    auto has_glyph = [&](uint32_t codepoint) {
+        ++probes;
+        return codepoint >= 0x20 && codepoint < 0x7F;
+    };
+    auto built = FontCoverage::load_or_build(dir, font, has_glyph);
+    ASSERT_GT(probes, 0);
+    ASSERT_EQ(built.count(), 0x7F - 0x20);
+
+    probes = 0;
+    auto cached = FontCoverage::load_or_build(dir, font, has_glyph);
+    ASSERT_EQ(probes, 0);
+    ASSERT_TRUE(cached.test('~'));
+    ASSERT_FALSE(cached.test(0x7F));
+    ASSERT_EQ(cached.count(), built.count());
+
+    std::ofstream{font, std::ios::app} << " that changed";
+    ASSERT_FALSE(FontCoverage::load(FontCoverage::cache_path(dir, font), font)); // Stale once the font is different
+    std::filesystem::remove_all(dir);
+    std::filesystem::remove(font);
+}
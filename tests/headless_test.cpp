@@ -0,0 +1,36 @@
+#include <gtest/gtest.h>
+#include "../src/Headless.hpp"
+#include <sstream>
+
+TEST(HeadlessTest, DumpsScreenAsText) {
+    HeadlessTerminal terminal{20, 3};
+    terminal.feed("one\r\ntwo  \r\n\033[31mthree");
+    ASSERT_EQ(terminal.dump_text(), "one\ntwo\nthree\n");
+}
+
+TEST(HeadlessTest, ScreenFollowsCursor) {
+    HeadlessTerminal terminal{20, 2};
+    terminal.feed("1\n2\n3\n4");
+    ASSERT_EQ(terminal.dump_text(), "3\n4\n");
+    ASSERT_EQ(terminal.dump_text(true), "1\n2\n3\n4\n");
+}
+
+TEST(HeadlessTest, SnapshotHasHeaderAndAllCells) {
+    HeadlessTerminal terminal{10, 4};
+    terminal.feed("\033]0;title\a");
+    std::ostringstream out;
+    terminal.write_snapshot(out);
+    ASSERT_EQ(out.str().substr(0, 4), "KSNP");
+    ASSERT_EQ(out.str().size(), 24 + 10 * 4 * 14);
+    ASSERT_EQ(terminal.title(), "title");
+}
+
+TEST(HeadlessTest, ResizesToGrid) {
+    HeadlessTerminal terminal{20, 5};
+    terminal.resize(40, 10);
+    ASSERT_EQ(terminal.buffer().get_screen_size(), std::make_pair(40, 10));
+    terminal.feed(std::string(35, 'x'));
+    ASSERT_TRUE(terminal.dump_text().starts_with(std::string(35, 'x') + "\n")); // One row, no wrap
+    terminal.resize(30, 4);
+    ASSERT_EQ(terminal.buffer().get_screen_size(), std::make_pair(30, 4));
+}
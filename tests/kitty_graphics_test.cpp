@@ -0,0 +1,203 @@
+#include <gtest/gtest.h>
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <poll.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../src/ANSIParser.hpp"
+#include "../src/KittyGraphics.hpp"
+#include "../src/Pane.hpp"
+
+namespace {
+// 2x2 RGBA: red, green / blue, half transparent white
+const std::string rgba_pixels{"\xFF\x00\x00\xFF\x00\xFF\x00\xFF\x00\x00\xFF\xFF\xFF\xFF\xFF\x80", 16};
+
+std::string base64(std::string_view bytes) {
+    constexpr std::string_view alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    for (size_t i = 0; i < bytes.size(); i += 3) {
+        uint32_t bits = static_cast<uint8_t>(bytes[i]) << 16;
+        bits |= i + 1 < bytes.size() ? static_cast<uint8_t>(bytes[i + 1]) << 8 : 0;
+        bits |= i + 2 < bytes.size() ? static_cast<uint8_t>(bytes[i + 2]) : 0;
+        out += alphabet[bits >> 18];
+        out += alphabet[(bits >> 12) & 63];
+        out += i + 1 < bytes.size() ? alphabet[(bits >> 6) & 63] : '=';
+        out += i + 2 < bytes.size() ? alphabet[bits & 63] : '=';
+    }
+    return out;
+}
+
+std::string apc(std::string_view keys, std::string_view payload = {}) {
+    return "\033_G" + std::string{keys} + ";" + std::string{payload} + "\033\\";
+}
+
+// Pane with the application end of a socket pair in place of the pty, replies can be read from it
+struct PaneWithApp {
+    int app_fd{-1};
+    std::unique_ptr<Pane> pane;
+
+    PaneWithApp() {
+        int fds[2];
+        socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds);
+        app_fd = fds[1];
+        pane = std::make_unique<Pane>(810, 200, std::make_pair(10, 5), fds[0]);
+    }
+    ~PaneWithApp() {
+        close(app_fd);
+    }
+    void send(std::string_view bytes) {
+        pane->append_output(bytes);
+        pane->process_output();
+    }
+    std::string replies() {
+        char data[4096];
+        auto size = read(app_fd, data, sizeof(data));
+        return size > 0 ? std::string(data, size) : std::string{};
+    }
+    const DecodedImage* wait_image(uint32_t image) {
+        for (int i = 0; i < 100 && !pane->image(image); ++i) {
+            pollfd ready{pane->images_fd(), POLLIN, 0};
+            poll(&ready, 1, 50);
+            pane->on_images_ready();
+            pane->process_output();
+        }
+        return pane->image(image);
+    }
+};
+}
+
+TEST(KittyGraphicsTest, ParsesKeysAndPayloadCutAnywhere) {
+    std::string text = "a" + apc("a=T,f=24,s=3,v=2,i=42,c=4,C=1", "AAAA") + "b";
+    AnsiParser parser;
+    CommandBuffer commands;
+    size_t offset = 0;
+    for (size_t end = 1; end <= text.size(); ++end) {
+        offset += parser.parse(std::string_view{text}.substr(offset, end - offset), commands);
+    }
+    ASSERT_EQ(offset, text.size());
+    ASSERT_EQ(commands.graphics_commands.size(), 1);
+    const auto& command = commands.graphics_commands[0];
+    ASSERT_EQ(command.action, 'T');
+    ASSERT_EQ(command.format, 24);
+    ASSERT_EQ(command.width, 3);
+    ASSERT_EQ(command.height, 2);
+    ASSERT_EQ(command.id, 42);
+    ASSERT_EQ(command.cols, 4);
+    ASSERT_TRUE(command.keep_cursor);
+    ASSERT_EQ(command.payload, "AAAA");
+    ASSERT_NE(command.image, 0);
+    ASSERT_EQ(commands.text.size(), 2); // Only a and b are text
+}
+
+TEST(KittyGraphicsTest, DecodesBase64AndConvertsPixels) {
+    std::string bytes;
+    ASSERT_TRUE(base64_decode(base64(rgba_pixels), bytes));
+    ASSERT_EQ(bytes, rgba_pixels);
+    ASSERT_FALSE(base64_decode("ab$d", bytes));
+
+    auto image = convert_pixels(rgba_pixels, 32, 2, 2);
+    ASSERT_EQ(image.pixels[0], 0xFFFF0000u);
+    ASSERT_EQ(image.pixels[3], 0x80FFFFFFu);
+    auto rgb = convert_pixels(std::string{"\x01\x02\x03", 3}, 24, 1, 1);
+    ASSERT_EQ(rgb.pixels[0], 0xFF010203u);
+}
+
+TEST(KittyGraphicsTest, SharedMemoryIsReadNotSentThroughThePty) {
+    PaneWithApp app;
+    std::string name = "/kemul-test-" + std::to_string(getpid());
+    int fd = shm_open(name.c_str(), O_CREAT | O_RDWR | O_EXCL, 0600);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(write(fd, rgba_pixels.data(), rgba_pixels.size()), static_cast<ssize_t>(rgba_pixels.size()));
+    close(fd);
+
+    app.send(apc("a=T,t=s,f=32,s=2,v=2,i=7", base64(name)) + "x");
+    ASSERT_EQ(app.replies(), "\033_Gi=7;OK\033\\");
+    ASSERT_LT(shm_open(name.c_str(), O_RDONLY, 0), 0); // Unlinked once opened
+    ASSERT_EQ(app.pane->buffer().get_images().size(), 1);
+    auto placement = app.pane->buffer().get_images()[0];
+    ASSERT_EQ(placement.rows, 1);
+    ASSERT_EQ(placement.cols, 1);
+    ASSERT_EQ(app.pane->buffer().get_buffer()[0][1].codepoint, 'x'); // Right after the image
+
+    const auto* image = app.wait_image(placement.image);
+    ASSERT_NE(image, nullptr);
+    ASSERT_EQ(image->pixels[2], 0xFF0000FFu);
+
+    // Deleting the placement keeps the image for later, uppercase frees it
+    app.send(apc("a=d,d=i,i=7"));
+    ASSERT_TRUE(app.pane->buffer().get_images().empty());
+    ASSERT_NE(app.pane->image(placement.image), nullptr);
+    app.send(apc("a=p,i=7,c=2,r=2"));
+    ASSERT_EQ(app.replies(), "\033_Gi=7;OK\033\\");
+    ASSERT_TRUE(app.pane->buffer().get_images()[0].fit);
+    ASSERT_EQ(app.pane->buffer().get_images()[0].rows, 2);
+    app.send(apc("a=d,d=I,i=7"));
+    ASSERT_TRUE(app.pane->buffer().get_images().empty());
+    ASSERT_EQ(app.pane->image(placement.image), nullptr);
+    app.send(apc("a=p,i=7"));
+    ASSERT_TRUE(app.replies().starts_with("\033_Gi=7;ENOENT:"));
+}
+
+TEST(KittyGraphicsTest, ChunkedDirectAndTemporaryFiles) {
+    PaneWithApp app;
+    auto payload = base64(rgba_pixels);
+    app.send(apc("a=t,f=32,s=2,v=2,i=3,m=1", payload.substr(0, 12)) + apc("m=0", payload.substr(12)));
+    ASSERT_EQ(app.replies(), "\033_Gi=3;OK\033\\");
+    ASSERT_TRUE(app.pane->buffer().get_images().empty()); // a=t only stores it
+
+    char path[] = "/tmp/tty-graphics-protocol-XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(write(fd, rgba_pixels.data(), rgba_pixels.size()), static_cast<ssize_t>(rgba_pixels.size()));
+    close(fd);
+    app.send(apc("a=T,t=t,f=32,s=2,v=2,I=5,q=1", base64(path)));
+    ASSERT_EQ(app.replies(), ""); // q=1, no OK
+    ASSERT_NE(access(path, F_OK), 0);
+    ASSERT_EQ(app.pane->buffer().get_images().size(), 1);
+    ASSERT_NE(app.wait_image(app.pane->buffer().get_images()[0].image), nullptr);
+
+    app.send(apc("a=t,t=f,f=32,s=2,v=2,i=9", base64("/nonexistent/image")));
+    ASSERT_TRUE(app.replies().starts_with("\033_Gi=9;ENOENT:"));
+    app.send(apc("a=t,f=32,s=4,v=4,i=9", payload));
+    ASSERT_TRUE(app.replies().starts_with("\033_Gi=9;ENODATA:"));
+}
+
+TEST(KittyGraphicsTest, RefusesWhatIsNotAFileOrNotOursToDelete) {
+    PaneWithApp app;
+    std::string fifo = "/tmp/kemul-test-fifo-" + std::to_string(getpid());
+    ASSERT_EQ(mkfifo(fifo.c_str(), 0600), 0);
+    app.send(apc("a=t,t=f,f=32,s=2,v=2,i=1", base64(fifo))); // Would block forever if opened for reading
+    ASSERT_TRUE(app.replies().starts_with("\033_Gi=1;EINVAL:"));
+    unlink(fifo.c_str());
+
+    app.send(apc("a=t,t=f,f=32,s=2,v=2,i=2", base64("/tmp/../proc/self/environ")));
+    ASSERT_TRUE(app.replies().starts_with("\033_Gi=2;EPERM:"));
+
+    std::string dir = "/tmp/tty-graphics-protocol-" + std::to_string(getpid());
+    ASSERT_EQ(mkdir(dir.c_str(), 0700), 0);
+    std::string file = dir + "/image";
+    int fd = open(file.c_str(), O_CREAT | O_WRONLY, 0600);
+    ASSERT_EQ(write(fd, rgba_pixels.data(), rgba_pixels.size()), static_cast<ssize_t>(rgba_pixels.size()));
+    close(fd);
+    app.send(apc("a=t,t=t,f=32,s=2,v=2,i=3", base64(file))); // Marker in the directory, not the name
+    ASSERT_TRUE(app.replies().starts_with("\033_Gi=3;EPERM:"));
+    ASSERT_EQ(access(file.c_str(), F_OK), 0);
+    unlink(file.c_str());
+    rmdir(dir.c_str());
+}
+
+TEST(KittyGraphicsTest, FileTruncatedBeforeReadFailsCleanly) {
+    char path[] = "/tmp/kemul-test-XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_EQ(write(fd, rgba_pixels.data(), rgba_pixels.size()), static_cast<ssize_t>(rgba_pixels.size()));
+    PixelData pixels{open(path, O_RDONLY), 0, rgba_pixels.size()};
+    ASSERT_EQ(ftruncate(fd, 4), 0);
+    ASSERT_FALSE(pixels.read());
+    ASSERT_TRUE(pixels.bytes().empty());
+    close(fd);
+    unlink(path);
+}
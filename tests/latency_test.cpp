@@ -0,0 +1,40 @@
+#include <gtest/gtest.h>
+#include "../src/LatencyTracker.hpp"
+
+using namespace std::chrono_literals;
+
+TEST(LatencyTest, MeasuresInputToPresentAfterEcho) {
+    LatencyTracker latency;
+    LatencyTracker::Clock::time_point start{};
+    latency.on_input(start);
+    latency.on_input(start + 1ms); // Typed before the echo, covered by the first input
+    ASSERT_TRUE(latency.waiting_for_echo(start + 1ms));
+    latency.on_present(start + 2ms); // Unrelated frame, no echo yet
+    ASSERT_EQ(latency.get_samples(), 0u);
+
+    latency.on_output(start + 3ms);
+    ASSERT_TRUE(latency.echo_ready());
+    ASSERT_FALSE(latency.waiting_for_echo(start + 3ms));
+    latency.on_present(start + 5ms);
+    ASSERT_EQ(latency.get_samples(), 1u);
+    ASSERT_DOUBLE_EQ(latency.percentile(0.5), 5.0);
+    ASSERT_EQ(latency.get_histogram()[3], 1u); // 4..8 ms
+    ASSERT_FALSE(latency.echo_ready());
+}
+
+TEST(LatencyTest, EchoWaitFollowsEchoDelay) {
+    LatencyTracker latency;
+    LatencyTracker::Clock::time_point start{};
+    for (int i = 0; i < 20; ++i) {
+        auto input = start + i * 100ms;
+        latency.on_input(input);
+        latency.on_output(input + 1ms);
+        latency.on_present(input + 2ms);
+    }
+    ASSERT_EQ(latency.echo_wait(), 2ms);
+
+    latency.on_input(start + 10s); // Never answered, dropped after a while
+    latency.on_present(start + 12s);
+    latency.on_output(start + 12s);
+    ASSERT_FALSE(latency.echo_ready());
+}
@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+#include <poll.h>
+#include <string>
+#include "../src/Pane.hpp"
+#include "../src/PaneLayout.hpp"
+
+namespace {
+std::string row_text(const TermBuffer& buffer, int row) {
+    std::string text;
+    for (const auto& cell : buffer.get_buffer()[row]) {
+        text += cell.codepoint ? static_cast<char>(cell.codepoint) : ' ';
+    }
+    return text;
+}
+}
+
+TEST(PaneLayoutTest, SplitsAndTilesTheArea) {
+    PaneLayout layout{0};
+    layout.split(0, 1, PaneLayout::Split::SideBySide);
+    layout.split(1, 2, PaneLayout::Split::Stacked);
+    ASSERT_EQ(layout.size(), 3u);
+
+    auto panes = layout.layout({0, 0, 101, 51}, 1);
+    ASSERT_EQ(panes.size(), 3u);
+    ASSERT_EQ(panes[0].first, 0);
+    ASSERT_EQ(panes[0].second, (PaneRect{0, 0, 50, 51}));
+    ASSERT_EQ(panes[1].first, 1);
+    ASSERT_EQ(panes[1].second, (PaneRect{51, 0, 50, 25}));
+    ASSERT_EQ(panes[2].first, 2);
+    ASSERT_EQ(panes[2].second, (PaneRect{51, 26, 50, 25}));
+
+    auto dividers = layout.dividers({0, 0, 101, 51}, 1);
+    ASSERT_EQ(dividers.size(), 2u);
+    ASSERT_EQ(dividers[0], (PaneRect{50, 0, 1, 51}));
+    ASSERT_EQ(dividers[1], (PaneRect{51, 25, 50, 1}));
+    ASSERT_THROW(layout.split(7, 8, PaneLayout::Split::Stacked), std::runtime_error);
+}
+
+TEST(PaneLayoutTest, SiblingTakesOverRemovedPane) {
+    PaneLayout layout{0};
+    layout.split(0, 1, PaneLayout::Split::SideBySide);
+    layout.split(1, 2, PaneLayout::Split::Stacked);
+
+    ASSERT_EQ(layout.remove(0), 1); // The stacked pair gets the whole width
+    auto panes = layout.layout({0, 0, 100, 51}, 1);
+    ASSERT_EQ(panes.size(), 2u);
+    ASSERT_EQ(panes[0].second, (PaneRect{0, 0, 100, 25}));
+    ASSERT_EQ(panes[1].second, (PaneRect{0, 26, 100, 25}));
+
+    ASSERT_EQ(layout.remove(2), 1);
+    ASSERT_EQ(layout.layout({0, 0, 100, 51}, 1)[0].second, (PaneRect{0, 0, 100, 51}));
+    ASSERT_EQ(layout.remove(1), -1); // The last one stays
+    ASSERT_EQ(layout.size(), 1u);
+}
+
+TEST(PaneTest, ParsesOnlyWhenThereIsOutput) {
+    Pane pane{11, 5, {1, 1}};
+    ASSERT_TRUE(pane.take_damage()); // New panes are drawn once
+    ASSERT_FALSE(pane.has_output());
+    pane.process_output();
+    ASSERT_FALSE(pane.take_damage()); // Nothing came, nothing to redraw
+
+    pane.append_output("hello\r\n\033]0;title\007wor");
+    ASSERT_TRUE(pane.has_output());
+    pane.process_output();
+    ASSERT_FALSE(pane.has_output());
+    ASSERT_TRUE(pane.take_damage());
+    ASSERT_EQ(row_text(pane.buffer(), 0).substr(0, 5), "hello");
+    ASSERT_EQ(row_text(pane.buffer(), 1).substr(0, 3), "wor");
+    ASSERT_EQ(pane.take_title(), "title");
+    ASSERT_FALSE(pane.take_title());
+}
+
+TEST(PaneTest, StopsOnBudgetWithBacklog) {
+    Pane pane{81, 25, {1, 1}};
+    std::string flood;
+    for (int i = 0; i < 60000; ++i) {
+        flood += "line " + std::to_string(i) + "\r\n";
+    }
+    ASSERT_EQ(pane.append_output(flood), flood.size());
+    pane.process_output(Pane::Clock::duration::zero()); // One slice, then the budget is gone
+    ASSERT_TRUE(pane.has_backlog());
+    while (pane.has_output()) {
+        pane.process_output();
+    }
+    ASSERT_FALSE(pane.has_backlog());
+    auto [cursor_x, cursor_y] = pane.buffer().get_cursor_pos();
+    ASSERT_EQ(cursor_x, 0);
+    ASSERT_EQ(row_text(pane.buffer(), cursor_y - 1).substr(0, 10), "line 59999");
+}
+
+TEST(PaneTest, StopsPollingPtyWhileRingIsFull) {
+    Pane pane{81, 25, {1, 1}};
+    ASSERT_TRUE(pane.pty_events() & POLLIN);
+    std::string flood(1 << 20, 'x');
+    while (pane.append_output(flood) != 0) {
+    }
+    ASSERT_FALSE(pane.pty_events() & POLLIN); // Readable pty would wake poll() over and over
+    pane.process_output();
+    ASSERT_TRUE(pane.pty_events() & POLLIN);
+}
+
+TEST(PaneTest, HoldsFrameDuringSynchronizedUpdateUntilTimeout) {
+    using namespace std::chrono_literals;
+    Pane pane{81, 25, {1, 1}};
+    pane.append_output("\033[?2026ha");
+    pane.process_output();
+    auto start = Pane::Clock::now();
+    ASSERT_TRUE(pane.holds_frame(start));
+    pane.append_output("b"); // Still the same update
+    pane.process_output();
+    ASSERT_TRUE(pane.holds_frame(start + 100ms));
+    ASSERT_FALSE(pane.holds_frame(start + 200ms)); // Application took too long, show what is there
+    pane.append_output("\033[?2026l");
+    pane.process_output();
+    ASSERT_FALSE(pane.holds_frame(Pane::Clock::now()));
+}
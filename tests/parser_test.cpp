@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+#include "../src/ANSIParser.hpp"
+#include "../src/Buffer.hpp"
+#include <string>
+
+class ParserTest : public testing::Test {
+protected:
+
+    AnsiParser parser;
+    CommandBuffer commands;
+    TermBuffer buffer{900, 600, 20, 10};
+
+    void feed(const std::string& text) {
+        auto consumed = parser.parse(text, commands);
+        ASSERT_EQ(consumed, text.size());
+        buffer.apply(commands);
+        commands.clear();
+    }
+};
+
+TEST_F(ParserTest, PrintableTextIsOneRun) {
+    parser.parse("hello", commands);
+    ASSERT_EQ(commands.commands.size(), 1);
+    ASSERT_EQ(commands.commands[0].type, CommandType::PRINT);
+    ASSERT_EQ(commands.commands[0].b, 5);
+}
+
+TEST_F(ParserTest, SgrAppliesToPrintedCells) {
+    feed("a\033[1;31mb");
+    const auto& row = buffer.get_buffer()[0];
+    ASSERT_FALSE(row[0].is_bold());
+    ASSERT_TRUE(row[1].is_bold());
+    ASSERT_EQ(row[1].fg_color.r, 255);
+}
+
+TEST_F(ParserTest, CutSequenceIsLeftForNextChunk) {
+    auto consumed = parser.parse("ab\033[3", commands);
+    ASSERT_EQ(consumed, 2);
+    buffer.apply(commands);
+    commands.clear();
+
+    feed("\033[3Dc");
+    ASSERT_EQ(buffer.get_buffer()[0][0].codepoint, 'c');
+}
+
+TEST_F(ParserTest, FastForwardSkipsEvictedLines) {
+    buffer.set_scrollback_limit(10);
+    std::string flood;
+    for (auto i = 0; i < 1000; ++i) {
+        flood += "line " + std::to_string(i) + "\n";
+    }
+    parser.parse(flood, commands, buffer.get_max_lines());
+    ASSERT_EQ(commands.commands[0].type, CommandType::DISCARD_LINES);
+    buffer.apply(commands);
+    commands.clear();
+
+    ASSERT_EQ(buffer.get_evicted_lines() + buffer.get_cursor_pos().second, 1000);
+    const auto& rows = buffer.get_buffer();
+    auto last_line = rows[buffer.get_cursor_pos().second - 1];
+    ASSERT_EQ(last_line[5].codepoint, '9');
+    ASSERT_EQ(last_line[7].codepoint, '9');
+}
+
+TEST_F(ParserTest, FastForwardPlannedOverSlices) {
+    buffer.set_scrollback_limit(10);
+    std::string flood;
+    for (auto i = 0; i < 1000; ++i) {
+        flood += "line " + std::to_string(i) + "\n";
+    }
+    // No slice has more lines than the buffer keeps, all of them together do
+    parser.fast_forward(parser.plan_fast_forward(flood, buffer.get_max_lines()));
+    size_t offset = 0;
+    size_t discarded = 0;
+    while (offset < flood.size()) {
+        offset += parser.parse(std::string_view{flood}.substr(offset, 200), commands);
+        for (const auto& command : commands.commands) {
+            discarded += command.type == CommandType::DISCARD_LINES ? command.a : 0;
+        }
+        buffer.apply(commands);
+        commands.clear();
+    }
+    ASSERT_EQ(discarded, 1000 - buffer.get_max_lines());
+    ASSERT_EQ(buffer.get_evicted_lines() + buffer.get_cursor_pos().second, 1000);
+    auto last_line = buffer.get_buffer()[buffer.get_cursor_pos().second - 1];
+    ASSERT_EQ(last_line[7].codepoint, '9');
+}
+
+TEST_F(ParserTest, OverlongCSIIsDropped) {
+    std::string csi = "\033[" + std::string(8192, '1');
+    auto consumed = parser.parse(csi, commands);
+    ASSERT_EQ(consumed, csi.size()); // Not waiting for a final byte forever
+    feed("m" + std::string{"ab"});
+    ASSERT_EQ(buffer.get_buffer()[0][1].codepoint, 'a'); // The stray m is text
+}
+
+TEST_F(ParserTest, SynchronizedUpdateStopsAtFrameEnd) {
+    std::string text = "\033[?2026ha\033[?2026lb";
+    auto consumed = parser.parse(text, commands);
+    ASSERT_TRUE(parser.stopped_at_frame_end());
+    ASSERT_EQ(consumed, text.size() - 1);
+    buffer.apply(commands);
+    commands.clear();
+    ASSERT_FALSE(buffer.is_synchronized_output());
+
+    feed("\033[?2026h" + text.substr(consumed));
+    ASSERT_FALSE(parser.stopped_at_frame_end());
+    ASSERT_TRUE(buffer.is_synchronized_output());
+    ASSERT_EQ(buffer.get_buffer()[0][1].codepoint, 'b');
+}
+
+TEST_F(ParserTest, BracketedPasteMode) {
+    ASSERT_FALSE(buffer.is_bracketed_paste());
+    feed("\033[?2004h");
+    ASSERT_TRUE(buffer.is_bracketed_paste());
+    feed("\033[?2004l");
+    ASSERT_FALSE(buffer.is_bracketed_paste());
+}
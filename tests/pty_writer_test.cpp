@@ -0,0 +1,87 @@
+#include <gtest/gtest.h>
+#include <csignal>
+#include <fcntl.h>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include "../src/PtyWriter.hpp"
+
+namespace {
+// Non-blocking pipe with a small buffer, stands in for a pty whose child isn't reading
+struct Pipe {
+    int fds[2];
+    Pipe() {
+        if (pipe(fds) != 0) {
+            throw std::runtime_error("pipe failed");
+        }
+        fcntl(fds[1], F_SETPIPE_SZ, 4096);
+        fcntl(fds[0], F_SETFL, O_NONBLOCK);
+        fcntl(fds[1], F_SETFL, O_NONBLOCK);
+    }
+    ~Pipe() {
+        close(fds[0]);
+        close(fds[1]);
+    }
+    std::string drain() {
+        std::string out;
+        char buf[4096];
+        ssize_t size;
+        while ((size = read(fds[0], buf, sizeof(buf))) > 0) {
+            out.append(buf, size);
+        }
+        return out;
+    }
+};
+}
+
+TEST(PtyWriterTest, HugePasteIsWrittenInPiecesWithoutLoss) {
+    Pipe pipe;
+    PtyWriter writer{16 * 1024};
+    std::string text;
+    for (int i = 0; i < 200'000; ++i) {
+        text += static_cast<char>('a' + i % 26);
+    }
+    writer.push_paste(text, false);
+    writer.push("x"); // Typed during the paste, goes after it
+
+    std::string received;
+    int flushes = 0;
+    while (writer.pending()) {
+        ASSERT_TRUE(writer.flush(pipe.fds[1])); // Never blocks even though the pipe is full
+        received += pipe.drain();
+        ++flushes;
+    }
+    received += pipe.drain();
+    ASSERT_EQ(received, text + "x");
+    ASSERT_GT(flushes, 10);
+}
+
+TEST(PtyWriterTest, BracketedPaste) {
+    Pipe pipe;
+    PtyWriter writer;
+    writer.push_paste("ls\033[201~rm -rf ~\n", true);
+    ASSERT_TRUE(writer.flush(pipe.fds[1]));
+    ASSERT_FALSE(writer.pending());
+    ASSERT_EQ(pipe.drain(), "\033[200~lsrm -rf ~\n\033[201~");
+
+    writer.push_paste("\033[20\033[201~1~rm -rf x\n", true); // Stripping the inner marker makes another one
+    ASSERT_TRUE(writer.flush(pipe.fds[1]));
+    ASSERT_EQ(pipe.drain(), "\033[200~rm -rf x\n\033[201~");
+
+    writer.push_paste("plain", false);
+    ASSERT_TRUE(writer.flush(pipe.fds[1]));
+    ASSERT_EQ(pipe.drain(), "plain");
+}
+
+TEST(PtyWriterTest, WriteErrorDropsQueue) {
+    Pipe pipe;
+    PtyWriter writer;
+    close(pipe.fds[0]);
+    pipe.fds[0] = open("/dev/null", O_RDONLY); // Keep the destructor happy
+    auto previous = signal(SIGPIPE, SIG_IGN); // Put back before any assert can return, other tests may want it
+    writer.push("lost");
+    bool flushed = writer.flush(pipe.fds[1]);
+    signal(SIGPIPE, previous);
+    ASSERT_FALSE(flushed);
+    ASSERT_FALSE(writer.pending());
+}
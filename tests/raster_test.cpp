@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+#include <unordered_map>
+#include "../src/SoftwareRasterizer.hpp"
+
+namespace {
+constexpr int cell_w = 8;
+constexpr int cell_h = 16;
+
+// Every glyph is a horizontal alpha ramp, so all blend weights get exercised
+struct RampGlyphs {
+    std::unordered_map<uint32_t, GlyphMask> masks;
+
+    const GlyphMask* operator()(uint32_t codepoint) {
+        if (codepoint == 'X') {
+            return nullptr; // Can't be rendered
+        }
+        auto& mask = masks[codepoint];
+        if (mask.alpha.empty()) {
+            mask = GlyphMask{cell_w, cell_h, std::vector<uint8_t>(cell_w * cell_h)};
+            for (int i = 0; i < cell_w * cell_h; ++i) {
+                mask.alpha[i] = static_cast<uint8_t>((i * 13 + codepoint * 7) % 256);
+            }
+            mask.alpha[0] = 0;
+            mask.alpha[1] = 255;
+        }
+        return &mask;
+    }
+};
+
+uint32_t pixel(const SoftwareRasterizer& raster, int x, int y) {
+    return raster.pixels()[y * raster.width() + x];
+}
+
+std::vector<Cell> colored_row(int cols) {
+    std::vector<Cell> row;
+    for (int i = 0; i < cols; ++i) {
+        Cell cell{static_cast<uint32_t>('a' + i % 26)};
+        cell.fg_color = Color{static_cast<uint8_t>(i * 40), 200, static_cast<uint8_t>(255 - i), 255};
+        cell.bg_color = Color{10, static_cast<uint8_t>(i * 3), 30, 255};
+        row.push_back(cell);
+    }
+    return row;
+}
+}
+
+TEST(RasterTest, SimdMatchesScalar) {
+    RampGlyphs glyphs;
+    SoftwareRasterizer scalar{cell_w, cell_h, std::ref(glyphs)};
+    SoftwareRasterizer simd{cell_w, cell_h, std::ref(glyphs)};
+    scalar.set_use_simd(false);
+    ASSERT_FALSE(scalar.uses_simd());
+    ASSERT_EQ(simd.uses_simd(), SoftwareRasterizer::has_avx2());
+
+    for (auto* raster : {&scalar, &simd}) {
+        raster->resize(37 * cell_w + 3, 4 * cell_h); // Last cell is cut off at the edge
+        raster->draw_row(0, colored_row(37));
+        raster->draw_row(2, colored_row(11));
+    }
+    ASSERT_EQ(std::vector<uint32_t>(scalar.pixels(), scalar.pixels() + scalar.width() * scalar.height()),
+              std::vector<uint32_t>(simd.pixels(), simd.pixels() + simd.width() * simd.height()));
+}
+
+TEST(RasterTest, BlendsGlyphOverBackground) {
+    RampGlyphs glyphs;
+    SoftwareRasterizer raster{cell_w, cell_h, std::ref(glyphs)};
+    raster.resize(4 * cell_w, 2 * cell_h);
+
+    Cell cell{'a'};
+    cell.fg_color = Color{255, 0, 0, 255};
+    cell.bg_color = Color{0, 0, 255, 255};
+    Cell bold = cell;
+    bold.set_bold();
+    Cell underlined = cell;
+    underlined.set_underline();
+    raster.draw_row(0, {cell, bold, underlined, Cell{'X'}});
+
+    ASSERT_EQ(pixel(raster, 0, 0), 0xFF0000FFu); // Alpha 0 is the background
+    ASSERT_EQ(pixel(raster, 1, 0), 0xFFFF0000u); // Alpha 255 is the foreground
+    ASSERT_EQ(pixel(raster, cell_w + 1, 0), 0xFFFFFFFFu); // Bold is drawn white
+
+    auto a = glyphs('a')->alpha[2];
+    uint32_t red = (255 * a + 127) / 255;
+    uint32_t blue = (255 * (255 - a) + 127) / 255;
+    ASSERT_EQ(pixel(raster, 2, 0), 0xFF000000u | (red << 16) | blue);
+
+    int underline_y = cell_h - cell_h / 5;
+    for (int x = 2 * cell_w; x < 3 * cell_w; ++x) {
+        ASSERT_EQ(pixel(raster, x, underline_y), 0xFFFF0000u);
+    }
+    ASSERT_EQ(pixel(raster, 3 * cell_w + 4, 4), 0xFF000000u); // No glyph, default background
+}
+
+TEST(RasterTest, MovesAndClearsRows) {
+    RampGlyphs glyphs;
+    SoftwareRasterizer raster{cell_w, cell_h, std::ref(glyphs)};
+    raster.resize(2 * cell_w, 4 * cell_h + 2);
+    raster.set_origin(0, 2);
+    auto row = colored_row(2);
+    raster.draw_row(1, row);
+    auto drawn = pixel(raster, 1, 2 + cell_h);
+
+    raster.move_rows(1, 0, 1);
+    ASSERT_EQ(pixel(raster, 1, 2), drawn);
+    raster.clear_row(1);
+    ASSERT_EQ(pixel(raster, 1, 2 + cell_h), 0xFF000000u);
+    ASSERT_EQ(pixel(raster, 1, 0), 0xFF000000u); // Above the first slot is left alone
+}
+
+TEST(RasterTest, ClipKeepsPanesApart) {
+    RampGlyphs glyphs;
+    SoftwareRasterizer raster{cell_w, cell_h, std::ref(glyphs)};
+    raster.resize(8 * cell_w, 4 * cell_h);
+    raster.set_clip(4 * cell_w, 8 * cell_w); // Right pane
+    raster.set_origin(4 * cell_w, 0);
+    raster.draw_row(0, colored_row(20)); // Wider than the pane
+    raster.move_rows(0, 2, 1);
+    raster.set_clip(0, 4 * cell_w);
+    raster.set_origin(0, 0);
+    raster.clear_row(1);
+
+    for (int y = 0; y < 4 * cell_h; ++y) {
+        for (int x = 0; x < 4 * cell_w; ++x) {
+            ASSERT_EQ(pixel(raster, x, y), 0xFF000000u) << x << "," << y; // Left pane untouched
+        }
+    }
+    for (int y = 0; y < cell_h; ++y) {
+        for (int x = 4 * cell_w; x < 8 * cell_w; ++x) {
+            ASSERT_EQ(pixel(raster, x, y + 2 * cell_h), pixel(raster, x, y));
+        }
+    }
+}
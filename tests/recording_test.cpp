@@ -0,0 +1,56 @@
+#include <gtest/gtest.h>
+#include "../src/SessionRecording.hpp"
+#include <filesystem>
+
+TEST(RecordingTest, ReplaysChunksInOrder) {
+    auto path = std::filesystem::temp_directory_path() / "kemul_recording_test.krec";
+    {
+        SessionRecorder recorder{path, 80, 24};
+        recorder.record("first");
+        recorder.record_resize(80, 24); // Same size, not recorded
+        recorder.record(std::string_view{"\0\033[m", 4});
+        recorder.record_resize(120, 40);
+    }
+
+    SessionReader reader{path};
+    ASSERT_EQ(reader.cols(), 80);
+    ASSERT_EQ(reader.rows(), 24);
+    RecordedChunk chunk;
+    ASSERT_TRUE(reader.next(chunk));
+    ASSERT_EQ(chunk.bytes, "first");
+    auto first_timestamp = chunk.timestamp_ns;
+    ASSERT_TRUE(reader.next(chunk));
+    ASSERT_EQ(chunk.bytes, std::string("\0\033[m", 4));
+    ASSERT_GE(chunk.timestamp_ns, first_timestamp);
+    ASSERT_FALSE(chunk.is_resize);
+    ASSERT_TRUE(reader.next(chunk));
+    ASSERT_TRUE(chunk.is_resize);
+    ASSERT_EQ(chunk.cols, 120);
+    ASSERT_EQ(chunk.rows, 40);
+    ASSERT_FALSE(reader.next(chunk));
+    std::filesystem::remove(path);
+}
+
+TEST(RecordingTest, RejectsOtherFiles) {
+    auto path = std::filesystem::temp_directory_path() / "kemul_recording_test.txt";
+    std::ofstream{path} << "not a recording";
+    ASSERT_THROW(SessionReader{path}, std::runtime_error);
+    std::filesystem::remove(path);
+}
+
+TEST(RecordingTest, ReadsVersionOneWithoutGridSize) {
+    auto path = std::filesystem::temp_directory_path() / "kemul_recording_test_v1.krec";
+    {
+        std::ofstream file{path, std::ios::binary};
+        file.write("KREC\1\0\0\0", 8);
+        file.write("\5\0\0\0\0\0\0\0\2\0\0\0hi", 14); // 5 ns, 2 bytes
+    }
+    SessionReader reader{path};
+    ASSERT_EQ(reader.cols(), 0);
+    RecordedChunk chunk;
+    ASSERT_TRUE(reader.next(chunk));
+    ASSERT_EQ(chunk.timestamp_ns, 5);
+    ASSERT_EQ(chunk.bytes, "hi");
+    ASSERT_FALSE(reader.next(chunk));
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,46 @@
+#include <gtest/gtest.h>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <unistd.h>
+#include "../src/RingBuffer.hpp"
+
+TEST(RingBufferTest, ContiguousAcrossWrap) {
+    RingBuffer ring{4096};
+    ASSERT_EQ(ring.capacity() % 4096, 0);
+    std::string filler(ring.capacity() - 10, 'x');
+    ASSERT_EQ(ring.append(filler), filler.size());
+    ring.consume(filler.size() - 3); // Three bytes left right before the end
+
+    ASSERT_EQ(ring.append("abcdefghij-0123456789"), 21u);
+    auto data = ring.readable();
+    ASSERT_EQ(data, "xxxabcdefghij-0123456789"); // Wrapped, but still one view
+    ring.consume(data.size());
+    ASSERT_TRUE(ring.empty());
+    ASSERT_EQ(ring.writable().size(), ring.capacity());
+}
+
+TEST(RingBufferTest, StopsWhenFull) {
+    RingBuffer ring{1};
+    std::string data(ring.capacity() + 100, 'y');
+    ASSERT_EQ(ring.append(data), ring.capacity());
+    ASSERT_EQ(ring.free_space(), 0u);
+    ASSERT_EQ(ring.append("z"), 0u);
+}
+
+TEST(RingBufferTest, ReadsFromFd) {
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    RingBuffer ring{4096};
+    std::string filler(ring.capacity() - 5, '.');
+    ring.append(filler);
+    ring.consume(filler.size());
+
+    ASSERT_EQ(write(fds[1], "hello world", 11), 11);
+    ASSERT_EQ(ring.read_from(fds[0]), 11);
+    ASSERT_EQ(ring.readable(), "hello world");
+    ASSERT_LT(ring.read_from(fds[0]), 0); // Nothing left, EAGAIN
+    close(fds[0]);
+    close(fds[1]);
+}
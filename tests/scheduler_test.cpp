@@ -0,0 +1,43 @@
+#include <gtest/gtest.h>
+#include "../src/FrameScheduler.hpp"
+
+using namespace std::chrono_literals;
+
+static double interval_ms(const FrameScheduler& scheduler) {
+    return std::chrono::duration<double, std::milli>(scheduler.frame_interval()).count();
+}
+
+TEST(SchedulerTest, FrameIntervalFollowsRefreshAndMaxFps) {
+    FrameScheduler scheduler;
+    scheduler.set_refresh_rate(144);
+    ASSERT_NEAR(interval_ms(scheduler), 6.944, 0.01);
+    scheduler.set_max_fps(60);
+    ASSERT_NEAR(interval_ms(scheduler), 16.667, 0.01);
+    scheduler.set_refresh_rate(0); // Unknown display is treated as 60 Hz
+    scheduler.set_max_fps(0);
+    ASSERT_NEAR(interval_ms(scheduler), 16.667, 0.01);
+}
+
+TEST(SchedulerTest, PresentsOncePerFrameUnlessEchoIsReady) {
+    FrameScheduler scheduler;
+    scheduler.set_refresh_rate(60);
+    LatencyTracker latency;
+    LatencyTracker::Clock::time_point start{1s};
+
+    scheduler.on_present(start);
+    ASSERT_FALSE(scheduler.should_present(true, latency, start + 5ms));
+    ASSERT_EQ(scheduler.wait_ms(true, false, latency, start + 5ms), 4); // Keys are picked up meanwhile
+    ASSERT_EQ(scheduler.wait_ms(false, false, latency, start + 5ms), 4);
+    scheduler.set_input_focus(false);
+    ASSERT_EQ(scheduler.wait_ms(true, false, latency, start + 5ms), 12); // Sleeps until the frame is due
+    ASSERT_EQ(scheduler.wait_ms(false, false, latency, start + 5ms), 17);
+    scheduler.set_input_focus(true);
+    ASSERT_EQ(scheduler.wait_ms(true, true, latency, start + 5ms), 0); // Backlog is parsed without sleeping
+    ASSERT_TRUE(scheduler.should_present(true, latency, start + 17ms));
+    ASSERT_FALSE(scheduler.should_present(false, latency, start + 17ms));
+
+    latency.on_input(start + 1ms);
+    latency.on_output(start + 2ms);
+    ASSERT_TRUE(scheduler.should_present(true, latency, start + 2ms));
+    ASSERT_EQ(scheduler.wait_ms(true, false, latency, start + 2ms), 0);
+}
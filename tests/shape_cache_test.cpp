@@ -0,0 +1,36 @@
+#include <gtest/gtest.h>
+#include "../src/ShapeCache.hpp"
+
+namespace {
+ShapedRun ligature(uint32_t glyph) {
+    return ShapedRun{false, {{glyph, 0, 0, 0}, {glyph + 1, 1, 0, 0}}};
+}
+}
+
+TEST(ShapeCacheTest, KeysOnTextAndStyle) {
+    ShapeCache cache;
+    ASSERT_EQ(cache.find(U"=>", 0), nullptr);
+    cache.insert(U"=>", 0, ligature(10));
+
+    auto* run = cache.find(U"=>", 0);
+    ASSERT_NE(run, nullptr);
+    ASSERT_FALSE(run->plain);
+    ASSERT_EQ(run->glyphs[0].glyph, 10);
+    ASSERT_EQ(cache.find(U"=>", 2), nullptr); // Bold is another run
+    ASSERT_EQ(cache.find(U"=", 0), nullptr);
+    ASSERT_EQ(cache.get_hits(), 1);
+    ASSERT_EQ(cache.get_misses(), 3);
+}
+
+TEST(ShapeCacheTest, DropsLeastRecentlyUsed) {
+    ShapeCache cache{2};
+    cache.insert(U"->", 0, ligature(1));
+    cache.insert(U"!=", 0, ligature(3));
+    ASSERT_NE(cache.find(U"->", 0), nullptr); // "!=" is the oldest now
+    cache.insert(U"==", 0, ligature(5));
+
+    ASSERT_EQ(cache.size(), 2);
+    ASSERT_EQ(cache.find(U"!=", 0), nullptr);
+    ASSERT_NE(cache.find(U"->", 0), nullptr);
+    ASSERT_NE(cache.find(U"==", 0), nullptr);
+}
@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+#include <poll.h>
+#include <string>
+#include "../src/ANSIParser.hpp"
+#include "../src/Buffer.hpp"
+#include "../src/Pane.hpp"
+#include "../src/Sixel.hpp"
+
+namespace {
+// 4x12 image: a red band, then a green one with only its top pixel row set
+const std::string sixel_data = "\"1;1;4;12#1;2;100;0;0#2;2;0;100;0#1!4~-#2!4@";
+
+uint32_t pixel(const DecodedImage& image, int x, int y) {
+    return image.pixels[static_cast<size_t>(y) * image.width + x];
+}
+}
+
+TEST(SixelTest, DecodesColorsRepeatsAndBands) {
+    SixelDecoder decoder;
+    decoder.feed(sixel_data);
+    auto image = decoder.finish();
+    ASSERT_EQ(image.width, 4);
+    ASSERT_EQ(image.height, 12);
+    ASSERT_EQ(pixel(image, 0, 0), 0xFFFF0000u);
+    ASSERT_EQ(pixel(image, 3, 5), 0xFFFF0000u);
+    ASSERT_EQ(pixel(image, 3, 6), 0xFF00FF00u);
+    ASSERT_EQ(pixel(image, 3, 7), 0xFF000000u); // Background
+}
+
+TEST(SixelTest, DecodesDataCutAnywhere) {
+    SixelDecoder decoder{true};
+    for (char c : sixel_data) {
+        decoder.feed(std::string_view{&c, 1});
+    }
+    auto image = decoder.finish();
+    ASSERT_EQ(pixel(image, 2, 6), 0xFF00FF00u);
+    ASSERT_EQ(pixel(image, 2, 7), 0u); // Transparent background
+}
+
+TEST(SixelTest, ParserStreamsDcsAndReservesRows) {
+    AnsiParser parser;
+    CommandBuffer commands;
+    TermBuffer buffer{810, 200, 10, 5}; // 5 pixel rows per cell, the image takes 3
+    std::string text = "ab\033Pq" + sixel_data + "\033\\cd";
+    auto half = text.size() / 2;
+    ASSERT_EQ(parser.parse(text.substr(0, half), commands), half); // Data is passed on as it comes
+    ASSERT_EQ(parser.parse(text.substr(half), commands), text.size() - half);
+    buffer.apply(commands);
+
+    std::string data;
+    for (const auto& command : commands.commands) {
+        if (command.type == CommandType::SIXEL_DATA) {
+            data += commands.graphics_of(command);
+        }
+    }
+    ASSERT_EQ(data, sixel_data);
+    ASSERT_EQ(buffer.get_images().size(), 1);
+    auto placement = buffer.get_images()[0];
+    ASSERT_EQ(placement.line, 0);
+    ASSERT_EQ(placement.col, 2);
+    ASSERT_EQ(placement.rows, 3);
+    ASSERT_EQ(buffer.get_buffer()[3][0].codepoint, 'c'); // Text goes on below the image
+}
+
+TEST(SixelTest, OtherDcsIsSwallowed) {
+    AnsiParser parser;
+    CommandBuffer commands;
+    TermBuffer buffer{810, 200, 10, 5};
+    std::string text = "a\033P$qm\033\\b";
+    ASSERT_EQ(parser.parse(text, commands), text.size());
+    buffer.apply(commands);
+    ASSERT_EQ(buffer.get_buffer()[0][0].codepoint, 'a');
+    ASSERT_EQ(buffer.get_buffer()[0][1].codepoint, 'b');
+    ASSERT_TRUE(buffer.get_images().empty());
+}
+
+TEST(SixelTest, PaneDecodesOffThreadAndDropsWithScrollback) {
+    Pane pane{810, 200, {10, 5}};
+    pane.buffer().set_scrollback_limit(0);
+    pane.append_output("\033Pq" + sixel_data + "\033\\");
+    pane.process_output();
+    ASSERT_EQ(pane.buffer().get_images().size(), 1);
+    auto id = pane.buffer().get_images()[0].image;
+
+    ASSERT_GE(pane.images_fd(), 0);
+    pollfd ready{pane.images_fd(), POLLIN, 0};
+    ASSERT_EQ(poll(&ready, 1, 5000), 1);
+    pane.on_images_ready();
+    ASSERT_TRUE(pane.has_output());
+    pane.process_output();
+    ASSERT_TRUE(pane.take_damage());
+    ASSERT_NE(pane.image(id), nullptr);
+    ASSERT_EQ(pane.image(id)->height, 12);
+
+    pane.append_output(std::string(200, '\n'));
+    pane.process_output();
+    ASSERT_TRUE(pane.buffer().get_images().empty());
+    ASSERT_EQ(pane.image(id), nullptr);
+}
@@ -34,4 +34,66 @@ TEST_F(BufferTest, TestNewLine) {
     auto cursor_pos = buffer.get_cursor_pos();
     ASSERT_EQ(cursor_pos.first, 0);
     ASSERT_EQ(cursor_pos.second, 1);
-}
\ No newline at end of file
+}
+TEST_F(BufferTest, SelectedTextTrimsTrailingBlanks) {
+    buffer.add_cells({Cell{'a'}, Cell{'b'}, Cell{'\n'}, Cell{'c'}, Cell{'d'}});
+    auto width = buffer.get_buffer()[0].size();
+    buffer.set_selection(0, 0, (width - 1) * 20, 10, 0); // Cell size is 20x10
+    ASSERT_EQ(buffer.get_selected_text(), "ab\ncd");
+}
+
+TEST_F(BufferTest, SelectedTextJoinsWrappedLines) {
+    auto width = buffer.get_buffer()[0].size();
+    std::vector<Cell> cells(width + 2, Cell{'x'});
+    buffer.add_cells(std::move(cells));
+    buffer.set_selection(0, 0, (width - 1) * 20, 10, 0);
+    ASSERT_EQ(buffer.get_selected_text(), std::string(width + 2, 'x'));
+
+    std::string streamed;
+    buffer.write_selected_text([&streamed](std::string_view chunk) { streamed += chunk; });
+    ASSERT_EQ(streamed, buffer.get_selected_text());
+}
+
+TEST_F(BufferTest, ScrollbackLimitEvictsOldLines) {
+    buffer.set_scrollback_limit(100);
+    for (auto i = 0; i < 1000; ++i) {
+        buffer.add_cells({Cell{'y'}, Cell{'\n'}});
+    }
+    ASSERT_LE(buffer.get_buffer().size(), buffer.get_max_lines() + 64);
+    ASSERT_EQ(buffer.get_evicted_lines() + buffer.get_cursor_pos().second, 1000);
+}
+
+TEST_F(BufferTest, DiscardLinesResetsGrid) {
+    buffer.add_cells({Cell{'y'}, Cell{'\n'}, Cell{'y'}});
+    buffer.discard_lines(10);
+    ASSERT_EQ(buffer.get_cursor_pos(), std::make_pair(0, 0));
+    ASSERT_EQ(buffer.get_evicted_lines(), 11);
+    ASSERT_EQ(buffer.get_buffer()[0][0].codepoint, 0);
+}
+
+TEST_F(BufferTest, MemoryUsageFollowsScrollback) {
+    auto empty_usage = buffer.memory_usage();
+    ASSERT_GE(empty_usage, buffer.get_buffer().size() * buffer.get_buffer()[0].size() * sizeof(Cell));
+    for (auto i = 0; i < 200; ++i) {
+        buffer.add_cells({Cell{'y'}, Cell{'\n'}});
+    }
+    ASSERT_EQ(buffer.get_scrollback_lines(), static_cast<size_t>(buffer.get_screen_top()));
+    ASSERT_GT(buffer.get_scrollback_lines(), 0u);
+    ASSERT_GT(buffer.memory_usage(), empty_usage);
+}
+
+TEST(RowHashTest, FollowsHowTheRowLooks) {
+    std::vector<Cell> row(10, Cell{'a'});
+    auto copy = row;
+    ASSERT_EQ(row_hash(row), row_hash(copy));
+
+    copy[3].fg_color = {255, 0, 0, 255};
+    ASSERT_NE(row_hash(row), row_hash(copy));
+    copy = row;
+    copy[9].set_wrapline();
+    ASSERT_EQ(row_hash(row), row_hash(copy));
+
+    std::vector<Cell> holes(10, Cell{0});
+    std::vector<Cell> blanks(10, Cell{' '});
+    ASSERT_EQ(row_hash(holes), row_hash(blanks));
+}
@@ -0,0 +1,20 @@
+#include <gtest/gtest.h>
+#include "../src/Trace.hpp"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+TEST(TraceTest, WritesScopesAsChromeTrace) {
+    Tracer::enable();
+    {
+        TRACE_SCOPE("trace_test_scope");
+    }
+    auto path = std::filesystem::temp_directory_path() / "kemul_trace_test.json";
+    ASSERT_TRUE(Tracer::write(path));
+
+    std::ifstream file{path};
+    std::stringstream contents;
+    contents << file.rdbuf();
+    ASSERT_NE(contents.str().find("\"name\": \"trace_test_scope\", \"ph\": \"X\""), std::string::npos);
+    std::filesystem::remove(path);
+}